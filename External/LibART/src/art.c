@@ -20,24 +20,42 @@
 #define SET_LEAF(x) ((void*)((uintptr_t)x | 1))
 #define LEAF_RAW(x) ((art_leaf*)((void*)((uintptr_t)x & ~1)))
 
+/**
+ * Allocates zeroed memory through the hook of the tree (if any)
+ */
+static void* art_calloc(art_tree *t, size_t size) {
+    if (!t->alloc)
+        return calloc(1, size);
+    void *ptr = t->alloc(t->alloc_data, size);
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+static void art_free(art_tree *t, void *ptr) {
+    if (!t->alloc)
+        free(ptr);
+    else if (t->free)
+        t->free(t->alloc_data, ptr);
+}
+
 /**
  * Allocates a node of the given type,
  * initializes to zero and sets the type.
  */
-static art_node* alloc_node(uint8_t type) {
+static art_node* alloc_node(art_tree *t, uint8_t type) {
     art_node* n;
     switch (type) {
         case NODE4:
-            n = (art_node*)calloc(1, sizeof(art_node4));
+            n = (art_node*)art_calloc(t, sizeof(art_node4));
             break;
         case NODE16:
-            n = (art_node*)calloc(1, sizeof(art_node16));
+            n = (art_node*)art_calloc(t, sizeof(art_node16));
             break;
         case NODE48:
-            n = (art_node*)calloc(1, sizeof(art_node48));
+            n = (art_node*)art_calloc(t, sizeof(art_node48));
             break;
         case NODE256:
-            n = (art_node*)calloc(1, sizeof(art_node256));
+            n = (art_node*)art_calloc(t, sizeof(art_node256));
             break;
         default:
             abort();
@@ -51,19 +69,30 @@ static art_node* alloc_node(uint8_t type) {
  * @return 0 on success.
  */
 int art_tree_init(art_tree *t) {
+    return art_tree_init_alloc(t, NULL, NULL, NULL);
+}
+
+/**
+ * Initializes an ART tree allocating through the hook
+ * @return 0 on success.
+ */
+int art_tree_init_alloc(art_tree *t, art_alloc_fn alloc, art_free_fn release, void *data) {
     t->root = NULL;
     t->size = 0;
+    t->alloc = alloc;
+    t->free = release;
+    t->alloc_data = data;
     return 0;
 }
 
 // Recursively destroys the tree
-static void destroy_node(art_node *n) {
+static void destroy_node(art_tree *t, art_node *n) {
     // Break if null
     if (!n) return;
 
     // Special case leafs
     if (IS_LEAF(n)) {
-        free(LEAF_RAW(n));
+        art_free(t, LEAF_RAW(n));
         return;
     }
 
@@ -79,14 +108,14 @@ static void destroy_node(art_node *n) {
         case NODE4:
             p.p1 = (art_node4*)n;
             for (i=0;i<n->num_children;i++) {
-                destroy_node(p.p1->children[i]);
+                destroy_node(t, p.p1->children[i]);
             }
             break;
 
         case NODE16:
             p.p2 = (art_node16*)n;
             for (i=0;i<n->num_children;i++) {
-                destroy_node(p.p2->children[i]);
+                destroy_node(t, p.p2->children[i]);
             }
             break;
 
@@ -95,7 +124,7 @@ static void destroy_node(art_node *n) {
             for (i=0;i<256;i++) {
                 idx = ((art_node48*)n)->keys[i]; 
                 if (!idx) continue; 
-                destroy_node(p.p3->children[idx-1]);
+                destroy_node(t, p.p3->children[idx-1]);
             }
             break;
 
@@ -103,7 +132,7 @@ static void destroy_node(art_node *n) {
             p.p4 = (art_node256*)n;
             for (i=0;i<256;i++) {
                 if (p.p4->children[i])
-                    destroy_node(p.p4->children[i]);
+                    destroy_node(t, p.p4->children[i]);
             }
             break;
 
@@ -112,7 +141,7 @@ static void destroy_node(art_node *n) {
     }
 
     // Free ourself on the way up
-    free(n);
+    art_free(t, n);
 }
 
 /**
@@ -120,7 +149,10 @@ static void destroy_node(art_node *n) {
  * @return 0 on success.
  */
 int art_tree_destroy(art_tree *t) {
-    destroy_node(t->root);
+    // Memory of the hook is released by its owner
+    if (t->alloc && !t->free)
+        return 0;
+    destroy_node(t, t->root);
     return 0;
 }
 
@@ -356,8 +388,8 @@ art_leaf* art_maximum(art_tree *t) {
     return maximum((art_node*)t->root);
 }
 
-static art_leaf* make_leaf(const unsigned char *key, int key_len, void *value) {
-    art_leaf *l = (art_leaf*)calloc(1, sizeof(art_leaf)+key_len);
+static art_leaf* make_leaf(art_tree *t, const unsigned char *key, int key_len, void *value) {
+    art_leaf *l = (art_leaf*)art_calloc(t, sizeof(art_leaf)+key_len);
     l->value = value;
     l->key_len = key_len;
     memcpy(l->key, key, key_len);
@@ -380,13 +412,14 @@ static void copy_header(art_node *dest, art_node *src) {
     memcpy(dest->partial, src->partial, min(MAX_PREFIX_LEN, src->partial_len));
 }
 
-static void add_child256(art_node256 *n, art_node **ref, unsigned char c, void *child) {
+static void add_child256(art_tree *t, art_node256 *n, art_node **ref, unsigned char c, void *child) {
+    (void)t;
     (void)ref;
     n->n.num_children++;
     n->children[c] = (art_node*)child;
 }
 
-static void add_child48(art_node48 *n, art_node **ref, unsigned char c, void *child) {
+static void add_child48(art_tree *t, art_node48 *n, art_node **ref, unsigned char c, void *child) {
     if (n->n.num_children < 48) {
         int pos = 0;
         while (n->children[pos]) pos++;
@@ -394,7 +427,7 @@ static void add_child48(art_node48 *n, art_node **ref, unsigned char c, void *ch
         n->keys[c] = pos + 1;
         n->n.num_children++;
     } else {
-        art_node256 *new_node = (art_node256*)alloc_node(NODE256);
+        art_node256 *new_node = (art_node256*)alloc_node(t, NODE256);
         for (int i=0;i<256;i++) {
             if (n->keys[i]) {
                 new_node->children[i] = n->children[n->keys[i] - 1];
@@ -402,12 +435,12 @@ static void add_child48(art_node48 *n, art_node **ref, unsigned char c, void *ch
         }
         copy_header((art_node*)new_node, (art_node*)n);
         *ref = (art_node*)new_node;
-        free(n);
-        add_child256(new_node, ref, c, child);
+        art_free(t, n);
+        add_child256(t, new_node, ref, c, child);
     }
 }
 
-static void add_child16(art_node16 *n, art_node **ref, unsigned char c, void *child) {
+static void add_child16(art_tree *t, art_node16 *n, art_node **ref, unsigned char c, void *child) {
     if (n->n.num_children < 16) {
         unsigned mask = (1 << n->n.num_children) - 1;
         
@@ -416,8 +449,9 @@ static void add_child16(art_node16 *n, art_node **ref, unsigned char c, void *ch
             __m128i cmp;
 
             // Compare the key to all 16 stored keys
-            cmp = _mm_cmplt_epi8(_mm_set1_epi8(c),
-                    _mm_loadu_si128((__m128i*)n->keys));
+            // Flip the sign bits, the comparison is signed but keys are ordered unsigned
+            cmp = _mm_cmplt_epi8(_mm_set1_epi8(c ^ 0x80),
+                    _mm_xor_si128(_mm_loadu_si128((__m128i*)n->keys), _mm_set1_epi8((char)0x80)));
 
             // Use a mask to ignore children that don't exist
             unsigned bitfield = _mm_movemask_epi8(cmp) & mask;
@@ -426,8 +460,9 @@ static void add_child16(art_node16 *n, art_node **ref, unsigned char c, void *ch
             __m128i cmp;
 
             // Compare the key to all 16 stored keys
-            cmp = _mm_cmplt_epi8(_mm_set1_epi8(c),
-                    _mm_loadu_si128((__m128i*)n->keys));
+            // Flip the sign bits, the comparison is signed but keys are ordered unsigned
+            cmp = _mm_cmplt_epi8(_mm_set1_epi8(c ^ 0x80),
+                    _mm_xor_si128(_mm_loadu_si128((__m128i*)n->keys), _mm_set1_epi8((char)0x80)));
 
             // Use a mask to ignore children that don't exist
             unsigned bitfield = _mm_movemask_epi8(cmp) & mask;
@@ -460,7 +495,7 @@ static void add_child16(art_node16 *n, art_node **ref, unsigned char c, void *ch
         n->n.num_children++;
 
     } else {
-        art_node48 *new_node = (art_node48*)alloc_node(NODE48);
+        art_node48 *new_node = (art_node48*)alloc_node(t, NODE48);
 
         // Copy the child pointers and populate the key map
         memcpy(new_node->children, n->children,
@@ -470,12 +505,12 @@ static void add_child16(art_node16 *n, art_node **ref, unsigned char c, void *ch
         }
         copy_header((art_node*)new_node, (art_node*)n);
         *ref = (art_node*)new_node;
-        free(n);
-        add_child48(new_node, ref, c, child);
+        art_free(t, n);
+        add_child48(t, new_node, ref, c, child);
     }
 }
 
-static void add_child4(art_node4 *n, art_node **ref, unsigned char c, void *child) {
+static void add_child4(art_tree *t, art_node4 *n, art_node **ref, unsigned char c, void *child) {
     if (n->n.num_children < 4) {
         int idx;
         for (idx=0; idx < n->n.num_children; idx++) {
@@ -493,7 +528,7 @@ static void add_child4(art_node4 *n, art_node **ref, unsigned char c, void *chil
         n->n.num_children++;
 
     } else {
-        art_node16 *new_node = (art_node16*)alloc_node(NODE16);
+        art_node16 *new_node = (art_node16*)alloc_node(t, NODE16);
 
         // Copy the child pointers and the key map
         memcpy(new_node->children, n->children,
@@ -502,21 +537,21 @@ static void add_child4(art_node4 *n, art_node **ref, unsigned char c, void *chil
                 sizeof(unsigned char)*n->n.num_children);
         copy_header((art_node*)new_node, (art_node*)n);
         *ref = (art_node*)new_node;
-        free(n);
-        add_child16(new_node, ref, c, child);
+        art_free(t, n);
+        add_child16(t, new_node, ref, c, child);
     }
 }
 
-static void add_child(art_node *n, art_node **ref, unsigned char c, void *child) {
+static void add_child(art_tree *t, art_node *n, art_node **ref, unsigned char c, void *child) {
     switch (n->type) {
         case NODE4:
-            return add_child4((art_node4*)n, ref, c, child);
+            return add_child4(t, (art_node4*)n, ref, c, child);
         case NODE16:
-            return add_child16((art_node16*)n, ref, c, child);
+            return add_child16(t, (art_node16*)n, ref, c, child);
         case NODE48:
-            return add_child48((art_node48*)n, ref, c, child);
+            return add_child48(t, (art_node48*)n, ref, c, child);
         case NODE256:
-            return add_child256((art_node256*)n, ref, c, child);
+            return add_child256(t, (art_node256*)n, ref, c, child);
         default:
             abort();
     }
@@ -546,10 +581,10 @@ static int prefix_mismatch(const art_node *n, const unsigned char *key, int key_
     return idx;
 }
 
-static void* recursive_insert(art_node *n, art_node **ref, const unsigned char *key, int key_len, void *value, int depth, int *old, int replace) {
+static void* recursive_insert(art_tree *t, art_node *n, art_node **ref, const unsigned char *key, int key_len, void *value, int depth, int *old, int replace) {
     // If we are at a NULL node, inject a leaf
     if (!n) {
-        *ref = (art_node*)SET_LEAF(make_leaf(key, key_len, value));
+        *ref = (art_node*)SET_LEAF(make_leaf(t, key, key_len, value));
         return NULL;
     }
 
@@ -566,10 +601,10 @@ static void* recursive_insert(art_node *n, art_node **ref, const unsigned char *
         }
 
         // New value, we must split the leaf into a node4
-        art_node4 *new_node = (art_node4*)alloc_node(NODE4);
+        art_node4 *new_node = (art_node4*)alloc_node(t, NODE4);
 
         // Create a new leaf
-        art_leaf *l2 = make_leaf(key, key_len, value);
+        art_leaf *l2 = make_leaf(t, key, key_len, value);
 
         // Determine longest prefix
         int longest_prefix = longest_common_prefix(l, l2, depth);
@@ -577,8 +612,8 @@ static void* recursive_insert(art_node *n, art_node **ref, const unsigned char *
         memcpy(new_node->n.partial, key+depth, min(MAX_PREFIX_LEN, longest_prefix));
         // Add the leafs to the new node4
         *ref = (art_node*)new_node;
-        add_child4(new_node, ref, l->key[depth+longest_prefix], SET_LEAF(l));
-        add_child4(new_node, ref, l2->key[depth+longest_prefix], SET_LEAF(l2));
+        add_child4(t, new_node, ref, l->key[depth+longest_prefix], SET_LEAF(l));
+        add_child4(t, new_node, ref, l2->key[depth+longest_prefix], SET_LEAF(l2));
         return NULL;
     }
 
@@ -592,28 +627,28 @@ static void* recursive_insert(art_node *n, art_node **ref, const unsigned char *
         }
 
         // Create a new node
-        art_node4 *new_node = (art_node4*)alloc_node(NODE4);
+        art_node4 *new_node = (art_node4*)alloc_node(t, NODE4);
         *ref = (art_node*)new_node;
         new_node->n.partial_len = prefix_diff;
         memcpy(new_node->n.partial, n->partial, min(MAX_PREFIX_LEN, prefix_diff));
 
         // Adjust the prefix of the old node
         if (n->partial_len <= MAX_PREFIX_LEN) {
-            add_child4(new_node, ref, n->partial[prefix_diff], n);
+            add_child4(t, new_node, ref, n->partial[prefix_diff], n);
             n->partial_len -= (prefix_diff+1);
             memmove(n->partial, n->partial+prefix_diff+1,
                     min(MAX_PREFIX_LEN, n->partial_len));
         } else {
             n->partial_len -= (prefix_diff+1);
             art_leaf *l = minimum(n);
-            add_child4(new_node, ref, l->key[depth+prefix_diff], n);
+            add_child4(t, new_node, ref, l->key[depth+prefix_diff], n);
             memcpy(n->partial, l->key+depth+prefix_diff+1,
                     min(MAX_PREFIX_LEN, n->partial_len));
         }
 
         // Insert the new leaf
-        art_leaf *l = make_leaf(key, key_len, value);
-        add_child4(new_node, ref, key[depth+prefix_diff], SET_LEAF(l));
+        art_leaf *l = make_leaf(t, key, key_len, value);
+        add_child4(t, new_node, ref, key[depth+prefix_diff], SET_LEAF(l));
         return NULL;
     }
 
@@ -622,12 +657,12 @@ RECURSE_SEARCH:;
     // Find a child to recurse to
     art_node **child = find_child(n, key[depth]);
     if (child) {
-        return recursive_insert(*child, child, key, key_len, value, depth+1, old, replace);
+        return recursive_insert(t, *child, child, key, key_len, value, depth+1, old, replace);
     }
 
     // No child, node goes within us
-    art_leaf *l = make_leaf(key, key_len, value);
-    add_child(n, ref, key[depth], SET_LEAF(l));
+    art_leaf *l = make_leaf(t, key, key_len, value);
+    add_child(t, n, ref, key[depth], SET_LEAF(l));
     return NULL;
 }
 
@@ -642,7 +677,7 @@ RECURSE_SEARCH:;
  */
 void* art_insert(art_tree *t, const unsigned char *key, int key_len, void *value) {
     int old_val = 0;
-    void *old = recursive_insert(t->root, &t->root, key, key_len, value, 0, &old_val, 1);
+    void *old = recursive_insert(t, t->root, &t->root, key, key_len, value, 0, &old_val, 1);
     if (!old_val) t->size++;
     return old;
 }
@@ -658,19 +693,19 @@ void* art_insert(art_tree *t, const unsigned char *key, int key_len, void *value
  */
 void* art_insert_no_replace(art_tree *t, const unsigned char *key, int key_len, void *value) {
     int old_val = 0;
-    void *old = recursive_insert(t->root, &t->root, key, key_len, value, 0, &old_val, 0);
+    void *old = recursive_insert(t, t->root, &t->root, key, key_len, value, 0, &old_val, 0);
     if (!old_val) t->size++;
     return old;
 }
 
-static void remove_child256(art_node256 *n, art_node **ref, unsigned char c) {
+static void remove_child256(art_tree *t, art_node256 *n, art_node **ref, unsigned char c) {
     n->children[c] = NULL;
     n->n.num_children--;
 
     // Resize to a node48 on underflow, not immediately to prevent
     // trashing if we sit on the 48/49 boundary
     if (n->n.num_children == 37) {
-        art_node48 *new_node = (art_node48*)alloc_node(NODE48);
+        art_node48 *new_node = (art_node48*)alloc_node(t, NODE48);
         *ref = (art_node*)new_node;
         copy_header((art_node*)new_node, (art_node*)n);
 
@@ -682,18 +717,18 @@ static void remove_child256(art_node256 *n, art_node **ref, unsigned char c) {
                 pos++;
             }
         }
-        free(n);
+        art_free(t, n);
     }
 }
 
-static void remove_child48(art_node48 *n, art_node **ref, unsigned char c) {
+static void remove_child48(art_tree *t, art_node48 *n, art_node **ref, unsigned char c) {
     int pos = n->keys[c];
     n->keys[c] = 0;
     n->children[pos-1] = NULL;
     n->n.num_children--;
 
     if (n->n.num_children == 12) {
-        art_node16 *new_node = (art_node16*)alloc_node(NODE16);
+        art_node16 *new_node = (art_node16*)alloc_node(t, NODE16);
         *ref = (art_node*)new_node;
         copy_header((art_node*)new_node, (art_node*)n);
 
@@ -706,27 +741,27 @@ static void remove_child48(art_node48 *n, art_node **ref, unsigned char c) {
                 child++;
             }
         }
-        free(n);
+        art_free(t, n);
     }
 }
 
-static void remove_child16(art_node16 *n, art_node **ref, art_node **l) {
+static void remove_child16(art_tree *t, art_node16 *n, art_node **ref, art_node **l) {
     int pos = l - n->children;
     memmove(n->keys+pos, n->keys+pos+1, n->n.num_children - 1 - pos);
     memmove(n->children+pos, n->children+pos+1, (n->n.num_children - 1 - pos)*sizeof(void*));
     n->n.num_children--;
 
     if (n->n.num_children == 3) {
-        art_node4 *new_node = (art_node4*)alloc_node(NODE4);
+        art_node4 *new_node = (art_node4*)alloc_node(t, NODE4);
         *ref = (art_node*)new_node;
         copy_header((art_node*)new_node, (art_node*)n);
         memcpy(new_node->keys, n->keys, 4);
         memcpy(new_node->children, n->children, 4*sizeof(void*));
-        free(n);
+        art_free(t, n);
     }
 }
 
-static void remove_child4(art_node4 *n, art_node **ref, art_node **l) {
+static void remove_child4(art_tree *t, art_node4 *n, art_node **ref, art_node **l) {
     int pos = l - n->children;
     memmove(n->keys+pos, n->keys+pos+1, n->n.num_children - 1 - pos);
     memmove(n->children+pos, n->children+pos+1, (n->n.num_children - 1 - pos)*sizeof(void*));
@@ -753,26 +788,26 @@ static void remove_child4(art_node4 *n, art_node **ref, art_node **l) {
             child->partial_len += n->n.partial_len + 1;
         }
         *ref = child;
-        free(n);
+        art_free(t, n);
     }
 }
 
-static void remove_child(art_node *n, art_node **ref, unsigned char c, art_node **l) {
+static void remove_child(art_tree *t, art_node *n, art_node **ref, unsigned char c, art_node **l) {
     switch (n->type) {
         case NODE4:
-            return remove_child4((art_node4*)n, ref, l);
+            return remove_child4(t, (art_node4*)n, ref, l);
         case NODE16:
-            return remove_child16((art_node16*)n, ref, l);
+            return remove_child16(t, (art_node16*)n, ref, l);
         case NODE48:
-            return remove_child48((art_node48*)n, ref, c);
+            return remove_child48(t, (art_node48*)n, ref, c);
         case NODE256:
-            return remove_child256((art_node256*)n, ref, c);
+            return remove_child256(t, (art_node256*)n, ref, c);
         default:
             abort();
     }
 }
 
-static art_leaf* recursive_delete(art_node *n, art_node **ref, const unsigned char *key, int key_len, int depth) {
+static art_leaf* recursive_delete(art_tree *t, art_node *n, art_node **ref, const unsigned char *key, int key_len, int depth) {
     // Search terminated
     if (!n) return NULL;
 
@@ -803,14 +838,14 @@ static art_leaf* recursive_delete(art_node *n, art_node **ref, const unsigned ch
     if (IS_LEAF(*child)) {
         art_leaf *l = LEAF_RAW(*child);
         if (!leaf_matches(l, key, key_len, depth)) {
-            remove_child(n, ref, key[depth], child);
+            remove_child(t, n, ref, key[depth], child);
             return l;
         }
         return NULL;
 
     // Recurse
     } else {
-        return recursive_delete(*child, child, key, key_len, depth+1);
+        return recursive_delete(t, *child, child, key, key_len, depth+1);
     }
 }
 
@@ -823,11 +858,11 @@ static art_leaf* recursive_delete(art_node *n, art_node **ref, const unsigned ch
  * the value pointer is returned.
  */
 void* art_delete(art_tree *t, const unsigned char *key, int key_len) {
-    art_leaf *l = recursive_delete(t->root, &t->root, key, key_len, 0);
+    art_leaf *l = recursive_delete(t, t->root, &t->root, key, key_len, 0);
     if (l) {
         t->size--;
         void *old = l->value;
-        free(l);
+        art_free(t, l);
         return old;
     }
     return NULL;
@@ -973,3 +1008,104 @@ int art_iter_prefix(art_tree *t, const unsigned char *key, int key_len, art_call
     }
     return 0;
 }
+
+/**
+ * Compares a leaf key against a bound
+ * @return <0, 0 or >0 like memcmp.
+ */
+static int leaf_compare(const art_leaf *n, const unsigned char *key, int key_len) {
+    int len = ((int)n->key_len < key_len) ? (int)n->key_len : key_len;
+    int res = memcmp(n->key, key, len);
+    if (res) return res;
+    return (int)n->key_len - key_len;
+}
+
+static int recursive_iter_from(art_node *n, const unsigned char *key, int key_len, int depth, art_callback cb, void *data) {
+    // Handle base cases
+    if (!n) return 0;
+    if (IS_LEAF(n)) {
+        art_leaf *l = LEAF_RAW(n);
+        if (leaf_compare(l, key, key_len) < 0) return 0;
+        return cb(data, (const unsigned char*)l->key, l->key_len, l->value);
+    }
+
+    // The stored prefix may be truncated, use the minimum leaf for the full one
+    if (n->partial_len) {
+        art_leaf *l = minimum(n);
+        for (uint32_t i=0; i < n->partial_len; i++) {
+            // Every key in the subtree extends the bound
+            if (depth + (int)i >= key_len)
+                return recursive_iter(n, cb, data);
+            unsigned char c = l->key[depth + i];
+            if (c < key[depth + i]) return 0;
+            if (c > key[depth + i]) return recursive_iter(n, cb, data);
+        }
+        depth = depth + n->partial_len;
+    }
+    if (depth >= key_len)
+        return recursive_iter(n, cb, data);
+
+    // Skip children below the bound, descend into the one on it and take the rest
+    unsigned char c = key[depth];
+    int idx, res;
+    art_node *child;
+    switch (n->type) {
+        case NODE4:
+        case NODE16: {
+            unsigned char *keys = (n->type == NODE4) ? ((art_node4*)n)->keys : ((art_node16*)n)->keys;
+            art_node **children = (n->type == NODE4) ? ((art_node4*)n)->children : ((art_node16*)n)->children;
+            for (int i=0; i < n->num_children; i++) {
+                if (keys[i] < c) continue;
+                res = (keys[i] == c) ?
+                    recursive_iter_from(children[i], key, key_len, depth + 1, cb, data) :
+                    recursive_iter(children[i], cb, data);
+                if (res) return res;
+            }
+            break;
+        }
+
+        case NODE48:
+            for (int i=c; i < 256; i++) {
+                idx = ((art_node48*)n)->keys[i];
+                if (!idx) continue;
+
+                child = ((art_node48*)n)->children[idx-1];
+                res = (i == c) ?
+                    recursive_iter_from(child, key, key_len, depth + 1, cb, data) :
+                    recursive_iter(child, cb, data);
+                if (res) return res;
+            }
+            break;
+
+        case NODE256:
+            for (int i=c; i < 256; i++) {
+                child = ((art_node256*)n)->children[i];
+                if (!child) continue;
+                res = (i == c) ?
+                    recursive_iter_from(child, key, key_len, depth + 1, cb, data) :
+                    recursive_iter(child, cb, data);
+                if (res) return res;
+            }
+            break;
+
+        default:
+            abort();
+    }
+    return 0;
+}
+
+/**
+ * Iterates through the entries pairs in the map,
+ * invoking a callback for each key greater or equal to a given key.
+ * The call back gets a key, value for each and returns an integer stop value.
+ * If the callback returns non-zero, then the iteration stops.
+ * @arg t The tree to iterate over
+ * @arg key The lower bound of keys to read
+ * @arg key_len The length of the lower bound
+ * @arg cb The callback function to invoke
+ * @arg data Opaque handle passed to the callback
+ * @return 0 on success, or the return of the callback.
+ */
+int art_iter_from(art_tree *t, const unsigned char *key, int key_len, art_callback cb, void *data) {
+    return recursive_iter_from(t->root, key, key_len, 0, cb, data);
+}
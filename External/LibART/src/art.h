@@ -26,6 +26,14 @@ extern "C" {
 
 typedef int(*art_callback)(void *data, const unsigned char *key, uint32_t key_len, void *value);
 
+/**
+ * Allocator hook for the nodes and leaves of a tree.
+ * The memory returned does not have to be zeroed,
+ * it has to be aligned for pointers.
+ */
+typedef void*(*art_alloc_fn)(void *data, uint64_t size);
+typedef void(*art_free_fn)(void *data, void *ptr);
+
 /**
  * This struct is included as part
  * of all the various node sizes
@@ -89,6 +97,9 @@ typedef struct {
 typedef struct {
     art_node *root;
     uint64_t size;
+    art_alloc_fn alloc;
+    art_free_fn free;
+    void *alloc_data;
 } art_tree;
 
 /**
@@ -97,6 +108,16 @@ typedef struct {
  */
 int art_tree_init(art_tree *t);
 
+/**
+ * Initializes an ART tree allocating through the hook
+ * @arg alloc allocates the nodes and leaves
+ * @arg release releases them, NULL if the memory is
+ * released all at once by the owner of the allocator
+ * @arg data opaque handle passed to the hook
+ * @return 0 on success.
+ */
+int art_tree_init_alloc(art_tree *t, art_alloc_fn alloc, art_free_fn release, void *data);
+
 /**
  * DEPRECATED
  * Initializes an ART tree
@@ -208,6 +229,20 @@ int art_iter(art_tree *t, art_callback cb, void *data);
  */
 int art_iter_prefix(art_tree *t, const unsigned char *prefix, int prefix_len, art_callback cb, void *data);
 
+/**
+ * Iterates through the entries pairs in the map,
+ * invoking a callback for each key greater or equal to a given key.
+ * The call back gets a key, value for each and returns an integer stop value.
+ * If the callback returns non-zero, then the iteration stops.
+ * @arg t The tree to iterate over
+ * @arg key The lower bound of keys to read
+ * @arg key_len The length of the lower bound
+ * @arg cb The callback function to invoke
+ * @arg data Opaque handle passed to the callback
+ * @return 0 on success, or the return of the callback.
+ */
+int art_iter_from(art_tree *t, const unsigned char *key, int key_len, art_callback cb, void *data);
+
 #ifdef __cplusplus
 }
 #endif
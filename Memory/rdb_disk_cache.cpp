@@ -0,0 +1,315 @@
+#include <rdb_disk_cache.hpp>
+
+namespace rdb
+{
+    std::size_t DiskCache::volume() const noexcept
+    {
+        return _volume;
+    }
+    std::size_t DiskCache::max_volume() const noexcept
+    {
+        return _max_volume;
+    }
+    std::size_t DiskCache::hits() const noexcept
+    {
+        return _hits;
+    }
+    std::size_t DiskCache::misses() const noexcept
+    {
+        return _misses;
+    }
+
+    DiskCache::block DiskCache::find(const key& key) noexcept
+    {
+        auto result = _find(key);
+        if (result == nullptr)
+            _misses++;
+        else
+            _hits++;
+        return result;
+    }
+    void DiskCache::insert(const key& key, block data) noexcept
+    {
+        if (data == nullptr || data->size() > _max_volume)
+            return;
+        _insert(key, std::move(data));
+    }
+    void DiskCache::erase(schema_type schema, std::size_t flush) noexcept
+    {
+        _erase(schema, flush);
+    }
+    void DiskCache::erase(schema_type schema) noexcept
+    {
+        _erase(schema, std::nullopt);
+    }
+
+    bool DiskCache::_matches(const key& key, schema_type schema, std::optional<std::size_t> flush) noexcept
+    {
+        return
+            std::get<0>(key) == schema &&
+            (!flush.has_value() || std::get<1>(key) == flush.value());
+    }
+
+    DiskCache::ptr DiskCache::make(Config::Cache::Type type, std::size_t volume) noexcept
+    {
+        switch (type)
+        {
+        case Config::Cache::Type::LRU: return std::make_unique<dc::LeastRecentlyUsed>(volume);
+        case Config::Cache::Type::LFU: return std::make_unique<dc::LeastFrequentlyUsed>(volume);
+        default: return std::make_unique<dc::AdaptiveLayeredCache>(volume);
+        }
+    }
+
+    namespace dc
+    {
+        void LeastFrequentlyUsed::_touch(Entry& entry) noexcept
+        {
+            const auto key = *entry.position;
+            const auto bucket = _frequencies.find(entry.frequency);
+            bucket->second.erase(entry.position);
+            if (bucket->second.empty())
+                _frequencies.erase(bucket);
+
+            auto& next = _frequencies[++entry.frequency];
+            next.push_front(key);
+            entry.position = next.begin();
+        }
+        void LeastFrequentlyUsed::_evict(std::size_t required) noexcept
+        {
+            while (!_frequencies.empty() && _volume + required > _max_volume)
+            {
+                const auto bucket = _frequencies.begin();
+                const auto key = bucket->second.back();
+                bucket->second.pop_back();
+                if (bucket->second.empty())
+                    _frequencies.erase(bucket);
+
+                const auto f = _index.find(key);
+                _volume -= f->second.data->size();
+                _index.erase(f);
+            }
+        }
+        DiskCache::block LeastFrequentlyUsed::_find(const key& key) noexcept
+        {
+            const auto f = _index.find(key);
+            if (f == _index.end())
+                return nullptr;
+            _touch(f->second);
+            return f->second.data;
+        }
+        void LeastFrequentlyUsed::_insert(const key& key, block data) noexcept
+        {
+            if (const auto f = _index.find(key); f != _index.end())
+            {
+                _volume -= f->second.data->size();
+                _volume += data->size();
+                f->second.data = std::move(data);
+                _touch(f->second);
+                _evict(0);
+                return;
+            }
+
+            _evict(data->size());
+            _volume += data->size();
+
+            auto& bucket = _frequencies[1];
+            bucket.push_front(key);
+            _index[key] = Entry{
+                .data = std::move(data),
+                .frequency = 1,
+                .position = bucket.begin()
+            };
+        }
+        void LeastFrequentlyUsed::_erase(schema_type schema, std::optional<std::size_t> flush) noexcept
+        {
+            for (auto it = _index.begin(); it != _index.end();)
+            {
+                if (_matches(it->first, schema, flush))
+                {
+                    const auto bucket = _frequencies.find(it->second.frequency);
+                    bucket->second.erase(it->second.position);
+                    if (bucket->second.empty())
+                        _frequencies.erase(bucket);
+                    _volume -= it->second.data->size();
+                    _index.erase(it++);
+                }
+                else
+                    ++it;
+            }
+        }
+        void LeastFrequentlyUsed::clear() noexcept
+        {
+            _index.clear();
+            _frequencies.clear();
+            _volume = 0;
+        }
+
+        void LeastRecentlyUsed::_evict(std::size_t required) noexcept
+        {
+            while (!_blocks.empty() && _volume + required > _max_volume)
+                _volume -= _blocks.pop().second->size();
+        }
+        DiskCache::block LeastRecentlyUsed::_find(const key& key) noexcept
+        {
+            if (const auto f = _blocks.find(key); f != nullptr)
+            {
+                _blocks.touch(key);
+                return *f;
+            }
+            return nullptr;
+        }
+        void LeastRecentlyUsed::_insert(const key& key, block data) noexcept
+        {
+            if (const auto prev = _blocks.erase(key); prev.has_value())
+                _volume -= prev.value()->size();
+            _evict(data->size());
+            _volume += data->size();
+            _blocks.push(key, std::move(data));
+        }
+        void LeastRecentlyUsed::_erase(schema_type schema, std::optional<std::size_t> flush) noexcept
+        {
+            _blocks.erase_if([&](const auto& it) {
+                if (!_matches(it.first, schema, flush))
+                    return false;
+                _volume -= it.second->size();
+                return true;
+            });
+        }
+        void LeastRecentlyUsed::clear() noexcept
+        {
+            _blocks.clear();
+            _volume = 0;
+        }
+
+        void AdaptiveLayeredCache::_evict(std::size_t required, bool frequent_ghost) noexcept
+        {
+            while (_volume + required > _max_volume &&
+                   (!_recent.empty() || !_frequent.empty()))
+            {
+                // Evict from the recent layer while it is above its target
+                if (!_recent.empty() &&
+                    (_frequent.empty() ||
+                     _recent_volume > _target ||
+                     (frequent_ghost && _recent_volume == _target)))
+                {
+                    auto [ key, data ] = _recent.pop();
+                    const auto size = data->size();
+                    _volume -= size;
+                    _recent_volume -= size;
+                    _recent_ghost.push(key, size);
+                    _recent_ghost_volume += size;
+                }
+                else
+                {
+                    auto [ key, data ] = _frequent.pop();
+                    const auto size = data->size();
+                    _volume -= size;
+                    _frequent_ghost.push(key, size);
+                    _frequent_ghost_volume += size;
+                }
+            }
+        }
+        void AdaptiveLayeredCache::_trim_ghosts() noexcept
+        {
+            while (_recent_ghost_volume > _max_volume)
+                _recent_ghost_volume -= _recent_ghost.pop().second;
+            while (_frequent_ghost_volume > _max_volume)
+                _frequent_ghost_volume -= _frequent_ghost.pop().second;
+        }
+        DiskCache::block AdaptiveLayeredCache::_find(const key& key) noexcept
+        {
+            // Second hit promotes the block to the frequent layer
+            if (auto data = _recent.erase(key); data.has_value())
+            {
+                _recent_volume -= data.value()->size();
+                _frequent.push(key, data.value());
+                return std::move(data.value());
+            }
+            if (const auto f = _frequent.find(key); f != nullptr)
+            {
+                _frequent.touch(key);
+                return *f;
+            }
+            return nullptr;
+        }
+        void AdaptiveLayeredCache::_insert(const key& key, block data) noexcept
+        {
+            const auto size = data->size();
+
+            if (const auto prev = _recent.erase(key); prev.has_value())
+            {
+                _volume -= prev.value()->size();
+                _recent_volume -= prev.value()->size();
+            }
+            else if (const auto prev = _frequent.erase(key); prev.has_value())
+            {
+                _volume -= prev.value()->size();
+            }
+
+            if (const auto ghost = _recent_ghost.erase(key); ghost.has_value())
+            {
+                // Evicted from the recent layer too early, give it more room
+                _recent_ghost_volume -= ghost.value();
+                _target = std::min(_max_volume, _target + size);
+                _evict(size, false);
+                _frequent.push(key, std::move(data));
+            }
+            else if (const auto ghost = _frequent_ghost.erase(key); ghost.has_value())
+            {
+                // Evicted from the frequent layer too early, shrink the recent layer
+                _frequent_ghost_volume -= ghost.value();
+                _target -= std::min(_target, size);
+                _evict(size, true);
+                _frequent.push(key, std::move(data));
+            }
+            else
+            {
+                _evict(size, false);
+                _recent.push(key, std::move(data));
+                _recent_volume += size;
+            }
+            _volume += size;
+            _trim_ghosts();
+        }
+        void AdaptiveLayeredCache::_erase(schema_type schema, std::optional<std::size_t> flush) noexcept
+        {
+            _recent.erase_if([&](const auto& it) {
+                if (!_matches(it.first, schema, flush))
+                    return false;
+                _volume -= it.second->size();
+                _recent_volume -= it.second->size();
+                return true;
+            });
+            _frequent.erase_if([&](const auto& it) {
+                if (!_matches(it.first, schema, flush))
+                    return false;
+                _volume -= it.second->size();
+                return true;
+            });
+            _recent_ghost.erase_if([&](const auto& it) {
+                if (!_matches(it.first, schema, flush))
+                    return false;
+                _recent_ghost_volume -= it.second;
+                return true;
+            });
+            _frequent_ghost.erase_if([&](const auto& it) {
+                if (!_matches(it.first, schema, flush))
+                    return false;
+                _frequent_ghost_volume -= it.second;
+                return true;
+            });
+        }
+        void AdaptiveLayeredCache::clear() noexcept
+        {
+            _recent.clear();
+            _frequent.clear();
+            _recent_ghost.clear();
+            _frequent_ghost.clear();
+            _volume = 0;
+            _recent_volume = 0;
+            _recent_ghost_volume = 0;
+            _frequent_ghost_volume = 0;
+            _target = 0;
+        }
+    }
+}
@@ -1,30 +1,214 @@
 #ifndef RDB_DISK_CACHE_HPP
 #define RDB_DISK_CACHE_HPP
 
+#include <rdb_root_config.hpp>
+#include <rdb_containers.hpp>
+#include <rdb_keytype.hpp>
+#include <optional>
+#include <memory>
+#include <list>
+#include <map>
+
 namespace rdb
 {
     // Base class for a <literal> cache implementation
     // It will be accessed by the MemoryCache during queries
     // To speed up frequently accessed disk keys
+    //
+    // The cache stores decompressed blocks keyed by the schema and flush they belong to and their absolute offset
+    // It is owned by a core and shared by the memory caches of its schemas, it is therefore not synchronized
     class DiskCache
     {
+    public:
+        using ptr = std::unique_ptr<DiskCache>;
+        // Schema | flush id | absolute block offset
+        using key = std::tuple<schema_type, std::size_t, std::size_t>;
+        using block = std::shared_ptr<const ct::vector<unsigned char>>;
     private:
+        std::size_t _hits{ 0 };
+        std::size_t _misses{ 0 };
+    protected:
+        std::size_t _volume{ 0 };
+        std::size_t _max_volume{ 0 };
+
+        // Whether the key belongs to the schema (and to the flush if one is given)
+        static bool _matches(const key& key, schema_type schema, std::optional<std::size_t> flush) noexcept;
+
+        virtual block _find(const key& key) noexcept = 0;
+        virtual void _insert(const key& key, block data) noexcept = 0;
+        virtual void _erase(schema_type schema, std::optional<std::size_t> flush) noexcept = 0;
     public:
+        explicit DiskCache(std::size_t volume) noexcept
+            : _max_volume(volume) {}
+        DiskCache(const DiskCache&) = delete;
+        DiskCache(DiskCache&&) = delete;
+        virtual ~DiskCache() = default;
+
+        std::size_t volume() const noexcept;
+        std::size_t max_volume() const noexcept;
+        std::size_t hits() const noexcept;
+        std::size_t misses() const noexcept;
+
+        block find(const key& key) noexcept;
+        void insert(const key& key, block data) noexcept;
+
+        // Drops every block belonging to a flush (after it was replaced)
+        void erase(schema_type schema, std::size_t flush) noexcept;
+        // Drops every block belonging to a schema (after its memory cache was unloaded)
+        void erase(schema_type schema) noexcept;
+        virtual void clear() noexcept = 0;
+
+        static ptr make(Config::Cache::Type type, std::size_t volume) noexcept;
+
+        DiskCache& operator=(const DiskCache&) = delete;
+        DiskCache& operator=(DiskCache&&) = delete;
     };
 
     namespace dc
     {
+        namespace impl
+        {
+            // Keys ordered by recency, most recent first
+            template<typename Value>
+            class RecencyList
+            {
+            public:
+                using entry = std::pair<DiskCache::key, Value>;
+            private:
+                std::list<entry> _list{};
+                ct::hash_map<DiskCache::key, typename std::list<entry>::iterator> _index{};
+            public:
+                bool empty() const noexcept
+                {
+                    return _list.empty();
+                }
+                std::size_t size() const noexcept
+                {
+                    return _list.size();
+                }
+
+                Value* find(const DiskCache::key& key) noexcept
+                {
+                    if (const auto f = _index.find(key); f != _index.end())
+                        return &f->second->second;
+                    return nullptr;
+                }
+                void touch(const DiskCache::key& key) noexcept
+                {
+                    if (const auto f = _index.find(key); f != _index.end())
+                        _list.splice(_list.begin(), _list, f->second);
+                }
+                void push(const DiskCache::key& key, Value value) noexcept
+                {
+                    _list.emplace_front(key, std::move(value));
+                    _index[key] = _list.begin();
+                }
+                entry pop() noexcept
+                {
+                    auto value = std::move(_list.back());
+                    _index.erase(value.first);
+                    _list.pop_back();
+                    return value;
+                }
+                std::optional<Value> erase(const DiskCache::key& key) noexcept
+                {
+                    if (const auto f = _index.find(key); f != _index.end())
+                    {
+                        auto value = std::move(f->second->second);
+                        _list.erase(f->second);
+                        _index.erase(f);
+                        return value;
+                    }
+                    return std::nullopt;
+                }
+                template<typename Func>
+                void erase_if(Func&& pred) noexcept
+                {
+                    for (auto it = _list.begin(); it != _list.end();)
+                    {
+                        if (pred(*it))
+                        {
+                            _index.erase(it->first);
+                            it = _list.erase(it);
+                        }
+                        else
+                            ++it;
+                    }
+                }
+                void clear() noexcept
+                {
+                    _list.clear();
+                    _index.clear();
+                }
+            };
+        }
+
         class LeastFrequentlyUsed : public DiskCache
         {
+        private:
+            struct Entry
+            {
+                block data{};
+                std::size_t frequency{ 0 };
+                std::list<key>::iterator position{};
+            };
+
+            ct::hash_map<key, Entry> _index{};
+            // Frequency -> keys ordered by recency (evicted from the back of the least frequent bucket)
+            std::map<std::size_t, std::list<key>> _frequencies{};
 
+            void _touch(Entry& entry) noexcept;
+            void _evict(std::size_t required) noexcept;
+        protected:
+            virtual block _find(const key& key) noexcept override;
+            virtual void _insert(const key& key, block data) noexcept override;
+            virtual void _erase(schema_type schema, std::optional<std::size_t> flush) noexcept override;
+        public:
+            using DiskCache::DiskCache;
+
+            virtual void clear() noexcept override;
         };
         class LeastRecentlyUsed : public DiskCache
         {
+        private:
+            impl::RecencyList<block> _blocks{};
+
+            void _evict(std::size_t required) noexcept;
+        protected:
+            virtual block _find(const key& key) noexcept override;
+            virtual void _insert(const key& key, block data) noexcept override;
+            virtual void _erase(schema_type schema, std::optional<std::size_t> flush) noexcept override;
+        public:
+            using DiskCache::DiskCache;
 
+            virtual void clear() noexcept override;
         };
+        // Two layers, one for blocks seen once and one for blocks seen repeatedly
+        // The share of the volume given to each layer adapts to hits on recently evicted keys (ghosts)
         class AdaptiveLayeredCache : public DiskCache
         {
+        private:
+            impl::RecencyList<block> _recent{};
+            impl::RecencyList<block> _frequent{};
+            impl::RecencyList<std::size_t> _recent_ghost{};
+            impl::RecencyList<std::size_t> _frequent_ghost{};
+
+            std::size_t _recent_volume{ 0 };
+            std::size_t _recent_ghost_volume{ 0 };
+            std::size_t _frequent_ghost_volume{ 0 };
+            // Target volume of the recent layer
+            std::size_t _target{ 0 };
+
+            void _evict(std::size_t required, bool frequent_ghost) noexcept;
+            void _trim_ghosts() noexcept;
+        protected:
+            virtual block _find(const key& key) noexcept override;
+            virtual void _insert(const key& key, block data) noexcept override;
+            virtual void _erase(schema_type schema, std::optional<std::size_t> flush) noexcept override;
+        public:
+            using DiskCache::DiskCache;
 
+            virtual void clear() noexcept override;
         };
     }
 }
@@ -1,88 +1,489 @@
 #include <rdb_log.hpp>
+#include <rdb_dbg.hpp>
 #include <rdb_locale.hpp>
 #include <rdb_reflect.hpp>
 #include <format>
+#include <cstring>
+#include <numeric>
+#include <Snappy/snappy.h>
+#include <XXHash/xxhash.hpp>
 
 namespace rdb
 {
-    void Log::_replay_shard(std::filesystem::path path,
-                            const std::function<void(WriteType, key_type, View, View)>& callback) noexcept
+    LogShardWorker::LogShardWorker() noexcept
     {
-        RuntimeSchemaReflection::RTSI& schema = RuntimeSchemaReflection::info(_schema);
+        _worker = std::jthread([this]() { _worker_impl(); });
+    }
+    LogShardWorker::~LogShardWorker()
+    {
+        {
+            std::lock_guard lock(_mtx);
+            _shutdown = true;
+        }
+        _cv.notify_all();
+    }
 
-        _current = _path/std::format("s{}", _shard++);
-        _smap.open(_current.c_str());
-        _smap.map(path);
-        _smap.hint(Mapper::Access::Sequential);
-        _shard_offset = 0;
+    void LogShardWorker::_worker_impl() noexcept
+    {
+        std::unique_lock lock(_mtx);
+        while (true)
+        {
+            _cv.wait(lock, [this]() { return _shutdown || _pending; });
+            if (_shutdown)
+                break;
+            _pending = false;
 
-        while (_shard_offset < _smap.size())
+            for (bool progress = true; progress && !_shutdown;)
+            {
+                progress = false;
+                for (std::size_t i = 0; i < _pools.size() && !_shutdown; i++)
+                {
+                    _active = _pools[i];
+                    lock.unlock();
+                    progress |= _active->_prepare_next();
+                    lock.lock();
+                    _active = nullptr;
+                    // Wakes up detaching pools
+                    _cv.notify_all();
+                }
+            }
+        }
+    }
+    void LogShardWorker::attach(LogShardPool* pool) noexcept
+    {
+        {
+            std::lock_guard lock(_mtx);
+            _pools.push_back(pool);
+            _pending = true;
+        }
+        _cv.notify_all();
+    }
+    void LogShardWorker::detach(LogShardPool* pool) noexcept
+    {
+        std::unique_lock lock(_mtx);
+        std::erase(_pools, pool);
+        // The pools after it moved, the current pass may skip one of them
+        _pending = true;
+        _cv.wait(lock, [&]() { return _active != pool; });
+    }
+    void LogShardWorker::notify() noexcept
+    {
         {
-            auto& off = _shard_offset;
-            auto& shard = _smap;
+            std::lock_guard lock(_mtx);
+            _pending = true;
+        }
+        _cv.notify_all();
+    }
 
-            WriteType type = WriteType(shard.memory()[off++]);
-            key_type key = 0x00;
-            View data = nullptr;
-            View sort = nullptr;
+    LogShardPool::LogShardPool(std::filesystem::path path, std::size_t shard_size, std::size_t capacity, LogShardWorker::ptr worker) noexcept :
+        _path(std::move(path)),
+        _shard_size(shard_size),
+        _capacity(capacity),
+        _shared_worker(std::move(worker))
+    {
+        // Shards left behind by a previous run are zeroed again, their state is unknown
+        if (!std::filesystem::exists(_path))
+            std::filesystem::create_directory(_path);
+        for (decltype(auto) it : std::filesystem::directory_iterator(_path))
+        {
+            const auto name = _name_impl('r');
+            std::filesystem::rename(it.path(), name);
+            _retired.push_back(name);
+        }
+        if (_shared_worker != nullptr)
+            _shared_worker->attach(this);
+        else
+            _worker = std::jthread([this]() { _worker_impl(); });
+    }
+    LogShardPool::~LogShardPool()
+    {
+        if (_shared_worker != nullptr)
+        {
+            _shared_worker->detach(this);
+            return;
+        }
+        {
+            std::lock_guard lock(_mtx);
+            _shutdown = true;
+        }
+        _cv.notify_all();
+    }
 
-            if (type == WriteType::Reserved)
+    std::filesystem::path LogShardPool::_name_impl(char prefix) noexcept
+    {
+        return _path/std::format("{}{}", prefix, _next++);
+    }
+    bool LogShardPool::_needed() const noexcept
+    {
+        return !_retired.empty() || _ready.size() + _preparing < _capacity;
+    }
+    void LogShardPool::_prepare_impl(const std::filesystem::path& path) noexcept
+    {
+        // Writing the zeros through the mapping allocates every block ahead of the log
+        Mapper map;
+        map.open(path, _shard_size);
+        map.map(_shard_size);
+        std::memset(map.memory().data(), 0, map.size());
+        map.flush();
+        map.close();
+    }
+    bool LogShardPool::_prepare_next() noexcept
+    {
+        std::unique_lock lock(_mtx);
+        if (!_needed())
+            return false;
+
+        std::filesystem::path path;
+        if (!_retired.empty())
+        {
+            path = std::move(_retired.front());
+            _retired.pop_front();
+        }
+        else
+            path = _name_impl('r');
+
+        ++_preparing;
+        lock.unlock();
+        _prepare_impl(path);
+        lock.lock();
+        --_preparing;
+
+        const auto name = _name_impl('p');
+        std::filesystem::rename(path, name);
+        _ready.push_back(name);
+        return true;
+    }
+    void LogShardPool::_notify() noexcept
+    {
+        if (_shared_worker != nullptr)
+            _shared_worker->notify();
+        else
+            _cv.notify_one();
+    }
+    void LogShardPool::_worker_impl() noexcept
+    {
+        std::unique_lock lock(_mtx);
+        while (true)
+        {
+            _cv.wait(lock, [this]() { return _shutdown || _needed(); });
+            if (_shutdown)
                 break;
 
-            if (type == WriteType::CreatePartition)
+            lock.unlock();
+            _prepare_next();
+            lock.lock();
+        }
+    }
+
+    bool LogShardPool::acquire(const std::filesystem::path& to) noexcept
+    {
+        std::unique_lock lock(_mtx);
+        if (_ready.empty())
+            return false;
+        const auto path = std::move(_ready.front());
+        _ready.pop_front();
+        std::filesystem::rename(path, to);
+        lock.unlock();
+        _notify();
+        return true;
+    }
+    bool LogShardPool::retire(const std::filesystem::path& shard) noexcept
+    {
+        std::unique_lock lock(_mtx);
+        if (_ready.size() + _retired.size() + _preparing >= _capacity)
+            return false;
+        const auto name = _name_impl('r');
+        std::filesystem::rename(shard, name);
+        _retired.push_back(name);
+        lock.unlock();
+        _notify();
+        return true;
+    }
+
+    LogTailRegistry::Attachment::Attachment(ptr registry) noexcept :
+        _registry(std::move(registry))
+    {
+        std::lock_guard lock(_registry->_mtx);
+        ++_registry->_tails;
+    }
+    LogTailRegistry::Attachment::~Attachment()
+    {
+        std::lock_guard lock(_registry->_mtx);
+        --_registry->_tails;
+    }
+    std::unique_ptr<LogTailRegistry::Attachment> LogTailRegistry::attach(ptr registry) noexcept
+    {
+        if (registry == nullptr)
+            return nullptr;
+        return std::make_unique<Attachment>(std::move(registry));
+    }
+    std::size_t LogTailRegistry::tails() noexcept
+    {
+        std::lock_guard lock(_mtx);
+        return _tails;
+    }
+
+    std::size_t Log::_decode_record(schema_type schema_id, std::span<const unsigned char> memory, std::size_t off, record& result) noexcept
+    {
+        RuntimeSchemaReflection::RTSI& schema = RuntimeSchemaReflection::info(schema_id);
+
+        const auto begin = off;
+        auto& [ type, key, sort, data ] = result;
+        type = WriteType(memory[off++]);
+        key = 0x00;
+        sort = nullptr;
+        data = nullptr;
+
+        if (type == WriteType::CreatePartition)
+        {
+            const auto size = schema.partition_size(&memory[off]);
+            key = schema.hash_partition(&memory[off]);
+            data = View::view(memory.subspan(off, size));
+            off += size;
+        }
+        else
+        {
+            key = byte::sread<key_type>(memory, off);
+
+            // If true we have a sorting key to parse
+            const auto keys = schema.skeys();
+            if (keys && type != WriteType::Table)
             {
-                key = schema.hash_partition(&shard.memory()[off]);
-                off += schema.partition_size(&shard.memory()[off]);
+                std::size_t size = 0;
+                for (std::size_t i = 0; i < keys; i++)
+                {
+                    RuntimeInterfaceReflection::RTII& info = schema.reflect_skey(i);
+                    size += info.storage(&memory[off + size]);
+                }
+                sort = View::view(memory.subspan(off, size));
+                off += size;
             }
-            else
+
+            // If true we have data to parse
+            if (type != WriteType::Remov &&
+                    type != WriteType::Reset)
             {
-                key = byte::sread<key_type>(shard.memory(), off);
+                const auto length = byte::sread<std::uint32_t>(memory, off);
+                data = View::view(memory.subspan(off, length));
+                off += length;
+            }
+        }
+        return off - begin;
+    }
+    Log::FrameStatus Log::decode(schema_type schema, std::span<const unsigned char> memory, std::size_t& off, record& result, buffer_store& buffers) noexcept
+    {
+        if (off >= memory.size())
+            return FrameStatus::End;
 
-                // If true we have a sorting key to parse
-                const auto keys = schema.skeys();
-                if (keys && type != WriteType::Table)
-                {
-                    std::size_t size = 0;
-                    for (std::size_t i = 0; i < keys; i++)
+        const auto marker = memory[off];
+        if (marker == static_cast<unsigned char>(WriteType::Reserved))
+            return FrameStatus::End;
+        std::atomic_thread_fence(std::memory_order::acquire);
+
+        // Records written before frames were introduced
+        if (marker <= static_cast<unsigned char>(WriteType::CreatePartition))
+        {
+            off += _decode_record(schema, memory, off, result);
+            return FrameStatus::Ok;
+        }
+        if (marker != frame_version || off + frame_header_size > memory.size())
+            return FrameStatus::Corrupted;
+
+        std::size_t hoff = off + 1;
+        const auto flags = byte::sread<std::uint8_t>(memory, hoff);
+        const auto raw = byte::sread<std::uint32_t>(memory, hoff);
+        const auto stored = byte::sread<std::uint32_t>(memory, hoff);
+        const auto checksum = byte::sread<std::uint64_t>(memory, hoff);
+        if (hoff + stored > memory.size())
+            return FrameStatus::Corrupted;
+
+        const auto payload = memory.subspan(hoff, stored);
+        if (xxh::xxhash3<64>(payload.data(), payload.size()) != checksum)
+            return FrameStatus::Corrupted;
+
+        if (flags & FrameFlags::Compressed)
+        {
+            // Decompressed records are kept with the buffers (deque elements do not move)
+            auto& buffer = buffers.emplace_back(raw);
+            if (!snappy::RawUncompress(
+                    reinterpret_cast<const char*>(payload.data()), payload.size(),
+                    reinterpret_cast<char*>(buffer.data())
+                ))
+                return FrameStatus::Corrupted;
+            _decode_record(schema, buffer, 0, result);
+        }
+        else
+            _decode_record(schema, payload, 0, result);
+        off = hoff + stored;
+        return FrameStatus::Ok;
+    }
+    std::size_t Log::_decode_shard(const std::filesystem::path& path, Mapper& shard, ct::vector<record>& records, buffer_store& buffers) const noexcept
+    {
+        shard.map(path);
+        shard.hint(Mapper::Access::Hot);
+
+        const auto memory = std::span<const unsigned char>(shard.memory());
+        std::size_t off = 0;
+        while (true)
+        {
+            record result;
+            const auto status = decode(_schema, memory, off, result, buffers);
+            if (status == FrameStatus::End)
+                return ~0ull;
+            if (status == FrameStatus::Corrupted)
+                return off;
+            records.push_back(std::move(result));
+        }
+    }
+    void Log::_replay_shards(const std::vector<std::size_t>& shards, const replay_callback& callback, const progress_callback& progress) noexcept
+    {
+        // Shards are decoded ahead by workers while the decoded ones are applied in order
+        struct Decoded
+        {
+            Mapper shard{};
+            ct::vector<record> records{};
+            buffer_store buffers{};
+            std::size_t corrupted{ ~0ull };
+        };
+        struct Job
+        {
+            std::unique_ptr<Decoded> decoded{};
+            std::jthread worker{};
+        };
+
+        const auto count = shards.size();
+        std::size_t total = 0;
+        std::size_t replayed = 0;
+        for (const auto shard : shards)
+            total += std::filesystem::file_size(_path/std::format("s{}", shard));
+
+        const auto workers = std::max<std::size_t>(1, _shared.cfg->logs.replay_workers);
+        std::deque<Job> jobs;
+        std::size_t next = 0;
+        for (std::size_t i = 0; i < count; i++)
+        {
+            while (next < count && jobs.size() < workers)
+            {
+                auto decoded = std::make_unique<Decoded>();
+                auto* ptr = decoded.get();
+                jobs.push_back({
+                    .decoded = std::move(decoded),
+                    .worker = std::jthread([this, ptr, path = _path/std::format("s{}", shards[next])]()
                     {
-                        RuntimeInterfaceReflection::RTII& info = schema.reflect_skey(i);
-                        size += info.storage(&shard.memory()[off + size]);
-                    }
-                    sort = View::view(shard.memory().subspan(off, size));
-                }
+                        ptr->corrupted = _decode_shard(path, ptr->shard, ptr->records, ptr->buffers);
+                    })
+                });
+                next++;
+            }
 
-                // If true we have data to parse
-                if (type != WriteType::Remov &&
-                        type != WriteType::Reset)
+            auto job = std::move(jobs.front());
+            jobs.pop_front();
+            job.worker.join();
+
+            // Snapshots taken while this shard is applied include it
+            _shard = shards[i] + 1;
+            for (const auto& [ type, key, sort, data ] : job.decoded->records)
+                callback(type, key, sort, data);
+
+            replayed += job.decoded->shard.size();
+            if (progress != nullptr)
+                progress(replayed, total);
+
+            // Replay stops at the first corrupted frame, the shard is cut there and later shards are set aside
+            [[ unlikely ]] if (job.decoded->corrupted != ~0ull)
+            {
+                RDB_WARN(log, "Corrupted log frame in ", (_path/std::format("s{}", shards[i])).string(), " at ", job.decoded->corrupted,
+                         ", ", count - i - 1, " later shards moved to lost")
+                job.decoded->shard.memory()[job.decoded->corrupted] = static_cast<unsigned char>(WriteType::Reserved);
+                job.decoded->shard.close();
+                while (!jobs.empty())
                 {
-                    const auto length = byte::sread<std::uint32_t>(shard.memory(), off);
-                    data = View::view(shard.memory().subspan(off, length));
-                    off += length;
+                    jobs.front().worker.join();
+                    jobs.pop_front();
                 }
+
+                const auto lost = _path.parent_path()/"lost";
+                std::filesystem::create_directories(lost);
+                const auto stamp = std::chrono::system_clock::now().time_since_epoch().count();
+                for (auto j = i + 1; j < count; j++)
+                    std::filesystem::rename(
+                        _path/std::format("s{}", shards[j]),
+                        lost/std::format("{}_s{}", stamp, shards[j])
+                    );
+                break;
             }
-            callback(type, key, sort, data);
+            job.decoded->shard.close();
         }
-        _smap.unmap();
     }
 
+    void Log::prepare() noexcept
+    {
+        if (_pool == nullptr && _shared.cfg->logs.log_pool_size)
+            _pool = std::make_unique<LogShardPool>(
+                _path.parent_path()/"pool",
+                _shared.cfg->logs.log_shard_size,
+                _shared.cfg->logs.log_pool_size,
+                _shared.shard_worker
+            );
+    }
     void Log::snapshot(std::size_t id) noexcept
     {
         std::filesystem::path p = _path/std::format("snapshot{}", id);
         std::filesystem::create_directory(p);
 
-        for (std::size_t i = 0; i < _shard; i++)
+        // Shard numbers keep growing, they identify a shard for log tails across snapshots and restarts
+        for (std::size_t i = _shard_base; i < _shard; i++)
         {
             const auto name = std::format("s{}", i);
-            std::filesystem::rename(_path/name, p/name);
+            if (std::filesystem::exists(_path/name))
+                std::filesystem::rename(_path/name, p/name);
         }
 
-        _shard = 0;
+        _shard_base = _shard;
         _shard_offset = 0;
         _current.clear();
     }
+    bool Log::_recycle(const std::filesystem::path& shard) noexcept
+    {
+        // Removed shards stay readable through the mappings of log tails, recycled ones are zeroed
+        if (_pool == nullptr)
+            return false;
+        if (_shared.tails == nullptr)
+            return _pool->retire(shard);
+        return _shared.tails->recycle([&]() { return _pool->retire(shard); });
+    }
     void Log::mark(std::size_t id) noexcept
     {
-        std::filesystem::remove_all(_path/std::format("snapshot{}", id));
+        const auto path = _path/std::format("snapshot{}", id);
+        if (!std::filesystem::exists(path))
+            return;
+
+        if (const auto retention = _shared.cfg->logs.tail_retention; retention)
+        {
+            // Shards stay readable by log tails until they fall out of the retention
+            const auto archive = _path.parent_path()/"archive";
+            std::filesystem::create_directory(archive);
+            for (decltype(auto) it : std::filesystem::directory_iterator(path))
+                std::filesystem::rename(it.path(), archive/it.path().filename());
+
+            std::vector<std::size_t> archived;
+            for (decltype(auto) it : std::filesystem::directory_iterator(archive))
+                archived.push_back(std::stoul(it.path().filename().string().substr(1)));
+            std::sort(archived.begin(), archived.end());
+            for (std::size_t i = 0; i + retention < archived.size(); i++)
+            {
+                const auto shard = archive/std::format("s{}", archived[i]);
+                if (!_recycle(shard))
+                    std::filesystem::remove(shard);
+            }
+        }
+        else if (_pool != nullptr)
+        {
+            for (decltype(auto) it : std::filesystem::directory_iterator(path))
+                if (!_recycle(it.path()))
+                    break;
+        }
+        std::filesystem::remove_all(path);
     }
     void Log::log(WriteType type, key_type key, View sort, View data) noexcept
     {
@@ -113,7 +514,7 @@ namespace rdb
                 data.size();
         }
 
-        if (_current.empty() || req + _shard_offset > _smap.size())
+        if (_current.empty() || frame_header_size + req + _shard_offset > _smap.size())
         {
             if (_shard_offset < _smap.size())
             {
@@ -126,19 +527,26 @@ namespace rdb
                 _smap.flush(_shard_flush, _pressure);
 
             _current = _path/std::format("s{}", _shard++);
+            const auto pooled = _pool != nullptr && _pool->acquire(_current);
             _smap.open(_current.c_str());
-            _smap.reserve(_shared.cfg->logs.log_shard_size);
+            if (!pooled)
+                _smap.reserve(_shared.cfg->logs.log_shard_size);
             _smap.map();
+            if (pooled)
+                _smap.hint(Mapper::Access::Hot);
 
             _shard_offset = 0;
             _shard_flush = 0;
             _pressure = 0;
         }
 
+        // Records are wrapped in checksummed frames, large ones are compressed
         auto buffer = _smap.memory().subspan(_shard_offset);
+        auto payload = buffer.subspan(frame_header_size);
+        payload[0] = static_cast<unsigned char>(type);
         if (type == WriteType::CreatePartition)
         {
-            byte::swrite(buffer.subspan(1), data);
+            byte::swrite(payload.subspan(1), data);
         }
         else
         {
@@ -146,126 +554,158 @@ namespace rdb
             if (data.empty())
             {
                 std::size_t off = 1;
-                off += byte::swrite(buffer.subspan(off), skey);
-                byte::swrite(buffer.subspan(off), sort);
+                off += byte::swrite(payload.subspan(off), skey);
+                byte::swrite(payload.subspan(off), sort);
             }
             else
             {
                 const auto len = byte::byteswap_for_storage<std::uint32_t>(data.size());
                 std::size_t off = 1;
-                off += byte::swrite(buffer.subspan(off), skey);
-                off += byte::swrite(buffer.subspan(off), sort);
-                off += byte::swrite(buffer.subspan(off), len);
-                byte::swrite(buffer.subspan(off), data);
+                off += byte::swrite(payload.subspan(off), skey);
+                off += byte::swrite(payload.subspan(off), sort);
+                off += byte::swrite(payload.subspan(off), len);
+                byte::swrite(payload.subspan(off), data);
             }
         }
 
+        std::uint8_t flags = 0;
+        std::size_t stored = req;
+        if (const auto threshold = _shared.cfg->logs.compression_threshold;
+                threshold && req >= threshold)
+        {
+            thread_local ct::vector<char> compressed;
+            compressed.resize(snappy::MaxCompressedLength(req));
+            std::size_t size = 0;
+            snappy::RawCompress(reinterpret_cast<const char*>(payload.data()), req, compressed.data(), &size);
+            if (float(size) / req < _shared.cfg->cache.compression_ratio)
+            {
+                // The raw tail is cleared, whatever follows the last frame has to read as the end of the shard
+                std::memcpy(payload.data(), compressed.data(), size);
+                std::memset(payload.data() + size, 0, req - size);
+                flags |= FrameFlags::Compressed;
+                stored = size;
+            }
+        }
+        {
+            std::size_t off = 1;
+            off += byte::swrite<std::uint8_t>(buffer, off, flags);
+            off += byte::swrite<std::uint32_t>(buffer, off, req);
+            off += byte::swrite<std::uint32_t>(buffer, off, stored);
+            byte::swrite<std::uint64_t>(buffer, off, xxh::xxhash3<64>(payload.data(), stored));
+        }
+
         // Separate into two writes to make sure the logs don't get corrupted during power failure
         // By default logs are zero'ed (filled with WriteType::Reserved)
-        // So if power fails this block is just skipped
+        // So if power fails this block is just skipped (and a frame torn by the page writeback order fails its checksum)
 
-        buffer[0] = static_cast<unsigned char>(type);
-        if ((_pressure += req) < _shared.cfg->logs.flush_pressure)
+        std::atomic_thread_fence(std::memory_order::release);
+        buffer[0] = frame_version;
+        const auto size = frame_header_size + stored;
+        if ((_pressure += size) < _shared.cfg->logs.flush_pressure &&
+                !_shared.cfg->logs.group_commit)
         {
             _smap.flush(_shard_flush, _pressure);
             _shard_flush += _pressure;
             _pressure = 0;
         }
-        _shard_offset += req;
+        _shard_offset += size;
     }
-    void Log::replay(std::function<void(WriteType, key_type, View, View)> callback) noexcept
+    void Log::sync() noexcept
+    {
+        if (!_pressure)
+            return;
+        _smap.flush(_shard_flush, _pressure);
+        _shard_flush += _pressure;
+        _pressure = 0;
+    }
+    void Log::replay(replay_callback callback, progress_callback progress) noexcept
     {
-        std::size_t max = 0;
         std::vector<std::pair<std::size_t, std::size_t>> snapshots;
+        std::vector<std::size_t> shards;
         for (decltype(auto) it : std::filesystem::directory_iterator(_path))
         {
-            if (it
-                    .path()
-                    .filename()
-                    .string()
-                    .starts_with("snapshot")
-               )
+            const auto name = it.path().filename().string();
+            if (name.starts_with("snapshot"))
             {
                 constexpr auto ssize = std::string_view("snapshot").size();
-                const auto id = std::stoul(it
-                                           .path()
-                                           .filename()
-                                           .string()
-                                           .substr(ssize));
-
+                const auto id = std::stoul(name.substr(ssize));
                 for (decltype(auto) s : std::filesystem::directory_iterator(it))
                 {
-                    const auto shard = std::stoul(s
-                                                  .path()
-                                                  .filename()
-                                                  .string()
-                                                  .substr(1));
                     snapshots.push_back(
                     {
                         id,
-                        shard
+                        std::stoul(s.path().filename().string().substr(1))
                     });
                 }
             }
             else
             {
-                max = std::max(std::stoul(it.path()
-                                          .filename()
-                                          .string()
-                                          .substr(1)) + 1, max);
+                shards.push_back(std::stoul(name.substr(1)));
             }
         }
+        std::sort(snapshots.begin(), snapshots.end());
+        std::sort(shards.begin(), shards.end());
 
-        // If we have snapshots we merge them with the root logs (and shift root logs at the end)
-        // Else we just replay the root logs
+        // Snapshots are replayed before the root shards
+        // Shard numbers keep growing across snapshots, so snapshot shards are moved back under their own names
+        std::vector<std::size_t> order;
+        for (const auto [ _, shard ] : snapshots)
+            order.push_back(shard);
+        order.insert(order.end(), shards.begin(), shards.end());
 
-        if (!snapshots.empty())
+        if (std::adjacent_find(order.begin(), order.end(), std::greater_equal<>()) == order.end())
         {
-            std::sort(snapshots.begin(), snapshots.end(), [](const auto& lhs, const auto& rhs)
+            for (const auto [ id, shard ] : snapshots)
             {
-                const auto& [ id1, s1 ] = lhs;
-                const auto& [ id2, s2 ] = rhs;
-                if (id1 == id2)
-                    return s1 < s2;
-                return id1 < id2;
-            });
-
-            for (std::size_t i = max; i != 0; i--)
-            {
-                const auto from = _path/std::format("s{}", i);
-                const auto to = _path/std::format("s{}", snapshots.size() + i - 1);
-                if (std::filesystem::exists(from))
-                    std::filesystem::rename(from, to);
+                const auto snap = _path/std::format("snapshot{}", id);
+                const auto name = std::format("s{}", shard);
+                std::filesystem::rename(snap/name, _path/name);
             }
-
-            for (std::size_t i = snapshots.size() - 1;; i--)
+        }
+        else
+        {
+            // Logs written while numbering restarted at every snapshot, root shards are renumbered to follow the snapshots
+            // Shards moving up are renamed from the back and shards moving down from the front so that no name is taken
+            const auto base = snapshots.size();
+            for (std::size_t i = shards.size(); i != 0; i--)
             {
-                const auto snap = std::format("snapshot{}", snapshots[i].first);
-                const auto from = _path/snap/std::format("s{}", snapshots[i].second);
-                const auto to = _path/std::format("s{}", i);
-                std::filesystem::rename(from, to);
-
-                if (i == 0 || snapshots[i - 1].first != snapshots[i].first)
-                {
-                    std::filesystem::remove_all(_path/snap);
-                }
-                if (i == 0)
-                    break;
+                if (base + i - 1 > shards[i - 1])
+                    std::filesystem::rename(
+                        _path/std::format("s{}", shards[i - 1]),
+                        _path/std::format("s{}", base + i - 1)
+                    );
             }
-
-            for (std::size_t i = 0; i < snapshots.size() + max; i++)
+            for (std::size_t i = 0; i < shards.size(); i++)
             {
-                _replay_shard(_path/std::format("s{}", i), callback);
+                if (base + i < shards[i])
+                    std::filesystem::rename(
+                        _path/std::format("s{}", shards[i]),
+                        _path/std::format("s{}", base + i)
+                    );
             }
-            _shard = max + snapshots.size();
-        }
-        else
-        {
-            for (std::size_t i = 0; i < max; i++)
+            for (std::size_t i = 0; i < snapshots.size(); i++)
             {
-                _replay_shard(_path/std::format("s{}", i), callback);
+                const auto snap = std::format("snapshot{}", snapshots[i].first);
+                std::filesystem::rename(
+                    _path/snap/std::format("s{}", snapshots[i].second),
+                    _path/std::format("s{}", i)
+                );
             }
-            _shard = max;
+            std::iota(order.begin(), order.end(), 0);
         }
+        for (const auto [ id, _ ] : snapshots)
+            std::filesystem::remove_all(_path/std::format("snapshot{}", id));
+
+        // New shards are numbered after every shard that is still around (archived ones included)
+        std::size_t next = order.empty() ? 0 : order.back() + 1;
+        if (const auto archive = _path.parent_path()/"archive"; std::filesystem::exists(archive))
+            for (decltype(auto) it : std::filesystem::directory_iterator(archive))
+                next = std::max(next, std::stoul(it.path().filename().string().substr(1)) + 1);
+
+        _shard_base = order.empty() ? next : order.front();
+        _replay_shards(order, callback, progress);
+        _shard = next;
+        _shard_offset = 0;
+        _current.clear();
     }
 }
@@ -3,24 +3,185 @@
 
 #include <filesystem>
 #include <functional>
+#include <condition_variable>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <memory>
 #include <rdb_root_config.hpp>
 #include <rdb_utils.hpp>
 #include <rdb_mapper.hpp>
 #include <rdb_writetype.hpp>
+#include <rdb_containers.hpp>
 
 namespace rdb
 {
+    class LogShardPool;
+
+    // Zeroes the shards of every pool of a mount from a single thread
+    // Pools take turns, one shard at a time, until none of them needs one
+    class LogShardWorker
+    {
+    public:
+        using ptr = std::shared_ptr<LogShardWorker>;
+    private:
+        std::mutex _mtx{};
+        std::condition_variable _cv{};
+        std::vector<LogShardPool*> _pools{};
+        // Pool preparing a shard outside of the lock
+        LogShardPool* _active{ nullptr };
+        bool _pending{ false };
+        bool _shutdown{ false };
+        std::jthread _worker{};
+
+        void _worker_impl() noexcept;
+    public:
+        LogShardWorker() noexcept;
+        LogShardWorker(const LogShardWorker&) = delete;
+        LogShardWorker(LogShardWorker&&) = delete;
+        ~LogShardWorker();
+
+        void attach(LogShardPool* pool) noexcept;
+        // Waits for the shard the pool is preparing, if any
+        void detach(LogShardPool* pool) noexcept;
+        // A pool may need a shard
+        void notify() noexcept;
+
+        LogShardWorker& operator=(const LogShardWorker&) = delete;
+        LogShardWorker& operator=(LogShardWorker&&) = delete;
+    };
+
+    // Keeps zeroed shards with allocated blocks ready for the log to roll over into
+    // Shards of marked snapshots are recycled instead of removed, they are zeroed again in the background
+    // By the worker of the mount when one is given, otherwise by a worker of the pool
+    // Files in the pool directory are either ready (p<N>) or waiting to be zeroed (r<N>)
+    class LogShardPool
+    {
+    public:
+        using ptr = std::unique_ptr<LogShardPool>;
+    private:
+        std::mutex _mtx{};
+        std::condition_variable _cv{};
+        std::deque<std::filesystem::path> _ready{};
+        std::deque<std::filesystem::path> _retired{};
+        std::filesystem::path _path{};
+        std::size_t _shard_size{ 0 };
+        std::size_t _capacity{ 0 };
+        std::size_t _preparing{ 0 };
+        std::size_t _next{ 0 };
+        bool _shutdown{ false };
+        LogShardWorker::ptr _shared_worker{};
+        std::jthread _worker{};
+
+        std::filesystem::path _name_impl(char prefix) noexcept;
+        // Whether a shard has to be zeroed (with the lock held)
+        bool _needed() const noexcept;
+        void _prepare_impl(const std::filesystem::path& path) noexcept;
+        // Zeroes one shard if needed, returns whether it did
+        bool _prepare_next() noexcept;
+        void _notify() noexcept;
+        void _worker_impl() noexcept;
+
+        friend class LogShardWorker;
+    public:
+        LogShardPool(std::filesystem::path path, std::size_t shard_size, std::size_t capacity, LogShardWorker::ptr worker = nullptr) noexcept;
+        LogShardPool(const LogShardPool&) = delete;
+        LogShardPool(LogShardPool&&) = delete;
+        ~LogShardPool();
+
+        // Moves a ready shard to the path, false if none is ready
+        bool acquire(const std::filesystem::path& to) noexcept;
+        // Takes ownership of a shard that is no longer needed, false if the pool is full
+        bool retire(const std::filesystem::path& shard) noexcept;
+
+        LogShardPool& operator=(const LogShardPool&) = delete;
+        LogShardPool& operator=(LogShardPool&&) = delete;
+    };
+
+    // Log tails of a mount, a shard mapped by a tail could be zeroed and reused under it if it was recycled
+    // Shards are only recycled while no tail is attached, a tail attached later can no longer find a recycled shard
+    class LogTailRegistry
+    {
+    public:
+        using ptr = std::shared_ptr<LogTailRegistry>;
+        // Keeps a tail attached for as long as it lives
+        class Attachment
+        {
+        private:
+            ptr _registry{};
+        public:
+            explicit Attachment(ptr registry) noexcept;
+            Attachment(const Attachment&) = delete;
+            Attachment(Attachment&&) = delete;
+            ~Attachment();
+
+            Attachment& operator=(const Attachment&) = delete;
+            Attachment& operator=(Attachment&&) = delete;
+        };
+    private:
+        std::mutex _mtx{};
+        std::size_t _tails{ 0 };
+    public:
+        LogTailRegistry() = default;
+        LogTailRegistry(const LogTailRegistry&) = delete;
+        LogTailRegistry(LogTailRegistry&&) = delete;
+
+        static std::unique_ptr<Attachment> attach(ptr registry) noexcept;
+        std::size_t tails() noexcept;
+        // Recycles a shard (returning whether it did) unless a tail is attached
+        template<typename Func>
+        bool recycle(Func&& func) noexcept
+        {
+            std::lock_guard lock(_mtx);
+            return _tails == 0 && func();
+        }
+
+        LogTailRegistry& operator=(const LogTailRegistry&) = delete;
+        LogTailRegistry& operator=(LogTailRegistry&&) = delete;
+    };
+
     // Lock-free
     // This class is responsible for logging any writes and replaying them to the memory cache after a runtime failure
     // Logs are append only and grow in blocks of constant size
-    // When a flush occurs logs are snapshotted and then atomically removed when done
+    // When a flush occurs logs are snapshotted and then atomically removed (or archived for log tails) when done
     // Snapshots are replayed in ascending order before the local shards
-    // Each log contains a: byte (WriteType, Reserved indicates the end), uint32 (length), data
+    // New shards are taken from the shard pool when one is ready
+    // Each record is wrapped in a frame: byte (frame version, Reserved indicates the end), byte (flags), uint32 (record size), uint32 (stored size), uint64 (XXH3 of the stored bytes), record
+    // Each record contains a: byte (WriteType), key, sort key, uint32 (length), data
+    // Frames whose record reaches the compression threshold may be stored compressed, replay stops at the first frame that fails its checksum
     class Log
     {
+    public:
+        using replay_callback = std::function<void(WriteType, key_type, View, View)>;
+        // Replayed bytes | total bytes (called after each shard)
+        using progress_callback = std::function<void(std::size_t, std::size_t)>;
+        using record = std::tuple<WriteType, key_type, View, View>;
+        using buffer_store = std::deque<ct::vector<unsigned char>>;
+
+        enum class FrameStatus
+        {
+            Ok,
+            // Reached the end of the written frames
+            End,
+            // The frame failed its checksum or could not be decoded
+            Corrupted,
+        };
     private:
+        // Any marker that is not a WriteType is a frame (records of older logs are not framed)
+        static constexpr std::uint8_t frame_version = 0x81;
+        static constexpr std::size_t frame_header_size =
+            sizeof(std::uint8_t) * 2 +
+            sizeof(std::uint32_t) * 2 +
+            sizeof(std::uint64_t);
+        enum FrameFlags : std::uint8_t
+        {
+            Compressed = 1 << 0
+        };
+
         schema_type _schema{ 0 };
         std::size_t _shard{ 0 };
+        // First shard not included in a snapshot
+        std::size_t _shard_base{ 0 };
         std::size_t _shard_offset{ 0 };
         std::size_t _shard_flush{ 0 };
         std::size_t _pressure{ 0 };
@@ -28,9 +189,14 @@ namespace rdb
         Shared _shared{};
         std::filesystem::path _path{};
         std::filesystem::path _current{};
+        LogShardPool::ptr _pool{};
 
-        void _replay_shard(std::filesystem::path path,
-                           const std::function<void(WriteType, key_type, View, View)>& callback) noexcept;
+        static std::size_t _decode_record(schema_type schema, std::span<const unsigned char> memory, std::size_t off, record& result) noexcept;
+        // Returns the offset of the first corrupted frame (or ~0ull)
+        std::size_t _decode_shard(const std::filesystem::path& path, Mapper& shard, ct::vector<record>& records, buffer_store& buffers) const noexcept;
+        // Hands a shard that is no longer needed to the pool, false if it has to be removed instead
+        bool _recycle(const std::filesystem::path& shard) noexcept;
+        void _replay_shards(const std::vector<std::size_t>& shards, const replay_callback& callback, const progress_callback& progress) noexcept;
     public:
         Log() = default;
         Log(Shared shared, std::filesystem::path path, schema_type schema) :
@@ -41,10 +207,19 @@ namespace rdb
         Log(const Log&) = delete;
         Log(Log&&) = default;
 
+        // Launches the shard pool (once the directory of the memory cache exists)
+        void prepare() noexcept;
         void snapshot(std::size_t id) noexcept;
         void mark(std::size_t id) noexcept;
         void log(WriteType type, key_type key, View sort, View data = nullptr) noexcept;
-        void replay(std::function<void(WriteType, key_type, View, View)> callback) noexcept;
+        // Syncs every record appended since the last sync
+        void sync() noexcept;
+        // Shards are decoded in parallel and applied in order
+        void replay(replay_callback callback, progress_callback progress = nullptr) noexcept;
+
+        // Decodes the frame at the offset and advances past it
+        // The record views point into the memory or into the buffers (for compressed frames)
+        static FrameStatus decode(schema_type schema, std::span<const unsigned char> memory, std::size_t& off, record& result, buffer_store& buffers) noexcept;
 
         Log& operator=(const Log&) = delete;
         Log& operator=(Log&&) = default;
@@ -0,0 +1,118 @@
+#include <rdb_log_tail.hpp>
+#include <format>
+
+namespace rdb
+{
+    std::optional<std::filesystem::path> LogTail::_locate(std::size_t shard) const noexcept
+    {
+        // Shards move from the log to a snapshot and then to the archive, so a miss is retried once
+        const auto name = std::format("s{}", shard);
+        for (std::size_t attempt = 0; attempt < 2; attempt++)
+        {
+            std::error_code ec;
+            if (const auto p = _path/"logs"/name; std::filesystem::exists(p, ec))
+                return p;
+            for (std::filesystem::directory_iterator it(_path/"logs", ec), end; !ec && it != end; it.increment(ec))
+            {
+                if (!it->path().filename().string().starts_with("snapshot"))
+                    continue;
+                if (const auto p = it->path()/name; std::filesystem::exists(p, ec))
+                    return p;
+            }
+            if (const auto p = _path/"archive"/name; std::filesystem::exists(p, ec))
+                return p;
+        }
+        return std::nullopt;
+    }
+    std::optional<std::size_t> LogTail::_oldest() const noexcept
+    {
+        std::optional<std::size_t> result{};
+        auto visit = [&](const std::filesystem::path& dir)
+        {
+            std::error_code ec;
+            for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+            {
+                const auto name = it->path().filename().string();
+                if (name.starts_with("snapshot"))
+                {
+                    for (std::filesystem::directory_iterator s(it->path(), ec), send; !ec && s != send; s.increment(ec))
+                    {
+                        const auto shard = std::stoul(s->path().filename().string().substr(1));
+                        result = std::min(result.value_or(shard), shard);
+                    }
+                    ec.clear();
+                }
+                else if (name.starts_with('s'))
+                {
+                    const auto shard = std::stoul(name.substr(1));
+                    result = std::min(result.value_or(shard), shard);
+                }
+            }
+        };
+        visit(_path/"logs");
+        visit(_path/"archive");
+        return result;
+    }
+
+    const LogTail::Cursor& LogTail::cursor() const noexcept
+    {
+        return _cursor;
+    }
+
+    LogTail::Status LogTail::poll(const callback& func, std::size_t max) noexcept
+    {
+        _buffers.clear();
+
+        std::size_t count = 0;
+        while (count < max)
+        {
+            if (!_shard.is_mapped())
+            {
+                const auto path = _locate(_cursor.shard);
+                if (!path.has_value())
+                {
+                    const auto oldest = _oldest();
+                    return oldest.has_value() && oldest.value() > _cursor.shard ?
+                        Status::Gap : Status::Pending;
+                }
+                _shard.map(path.value(), Mapper::OpenMode::RO);
+                _shard.hint(Mapper::Access::Sequential);
+            }
+
+            Log::record record;
+            auto off = _cursor.offset;
+            const auto status = Log::decode(_schema, _shard.memory(), off, record, _buffers);
+            if (status == Log::FrameStatus::Ok)
+            {
+                _cursor.offset = off;
+                count++;
+                const auto& [ type, key, sort, data ] = record;
+                func(_cursor, type, key, sort, data);
+                continue;
+            }
+
+            // The writer only moves to the next shard once it is done with this one
+            // Shards are not recycled while the tail is attached, one removed since it was mapped is still read in full
+            if (!_locate(_cursor.shard + 1).has_value())
+            {
+                // Unless the next shard was already dropped as well (reported as a gap once the cursor moves to it)
+                const auto oldest = _oldest();
+                if (!oldest.has_value() || oldest.value() <= _cursor.shard)
+                    return Status::Pending;
+            }
+            if (status == Log::FrameStatus::Corrupted)
+                return Status::Corrupted;
+
+            _shard.close();
+            _cursor.shard++;
+            _cursor.offset = 0;
+        }
+        return Status::Ok;
+    }
+    void LogTail::rewind() noexcept
+    {
+        _shard.close();
+        _cursor.shard = _oldest().value_or(_cursor.shard);
+        _cursor.offset = 0;
+    }
+}
@@ -0,0 +1,71 @@
+#ifndef RDB_LOG_TAIL_HPP
+#define RDB_LOG_TAIL_HPP
+
+#include <rdb_log.hpp>
+#include <optional>
+
+namespace rdb
+{
+    // Reads the log of a memory cache while it is written (change data capture)
+    // Shards are looked up in the log directory, its snapshots and the archive (see Config::Logs::tail_retention)
+    // Records are passed as views into the shard mapping, they are valid until the next poll
+    //
+    // A tail is not synchronized, but any number of tails may read the same log from other threads
+    class LogTail
+    {
+    public:
+        // Shard numbers are stable across snapshots and restarts, so a cursor can be persisted and resumed
+        struct Cursor
+        {
+            std::size_t core{ 0 };
+            std::size_t shard{ 0 };
+            std::size_t offset{ 0 };
+        };
+        enum class Status
+        {
+            // The callback was called for the maximum number of records
+            Ok,
+            // Every record written so far was read
+            Pending,
+            // The shard of the cursor is no longer retained (see rewind)
+            Gap,
+            // A frame failed its checksum in a shard that is no longer written to
+            Corrupted,
+        };
+        // Cursor to resume after the record | type | key | sort | data
+        using callback = std::function<void(const Cursor&, WriteType, key_type, View, View)>;
+    private:
+        std::filesystem::path _path{};
+        schema_type _schema{ 0 };
+        Cursor _cursor{};
+        Mapper _shard{};
+        Log::buffer_store _buffers{};
+        // Shards are not recycled under the mapping while the tail lives
+        std::unique_ptr<LogTailRegistry::Attachment> _attachment{};
+
+        std::optional<std::filesystem::path> _locate(std::size_t shard) const noexcept;
+        std::optional<std::size_t> _oldest() const noexcept;
+    public:
+        LogTail() = default;
+        // The path is the directory of the memory cache, the registry is the one of the mount writing it
+        LogTail(std::filesystem::path path, schema_type schema, Cursor cursor, LogTailRegistry::ptr registry) noexcept :
+            _path(std::move(path)),
+            _schema(schema),
+            _cursor(cursor),
+            _attachment(LogTailRegistry::attach(std::move(registry)))
+        {}
+        LogTail(const LogTail&) = delete;
+        LogTail(LogTail&&) = default;
+
+        const Cursor& cursor() const noexcept;
+
+        Status poll(const callback& func, std::size_t max = ~0ull) noexcept;
+        // Moves the cursor to the oldest retained shard
+        void rewind() noexcept;
+
+        LogTail& operator=(const LogTail&) = delete;
+        LogTail& operator=(LogTail&&) = default;
+    };
+}
+
+#endif // RDB_LOG_TAIL_HPP
@@ -1,10 +1,19 @@
 #include <rdb_memory.hpp>
+#include <shared_mutex>
+#include <bit>
 #include <rdb_locale.hpp>
 #include <rdb_dbg.hpp>
 #include <rdb_memunits.hpp>
 #include <rdb_reflect.hpp>
 #include <rdb_version.hpp>
 #include <cmath>
+#include <numeric>
+#include <queue>
+#include <deque>
+#include <XXHash/xxhash.hpp>
+#ifdef __AVX2__
+#   include <immintrin.h>
+#endif
 
 namespace rdb
 {
@@ -72,15 +81,20 @@ namespace rdb
 
     MemoryCache::Slot* MemoryCache::SlotDeleter::allocate(DataType vtype, std::span<const unsigned char> data) noexcept
     {
+        if (arena != nullptr)
+            return ct::ordered_byte_map<Slot>::arena_node(*arena, vtype, data);
         return ct::ordered_byte_map<Slot>::allocate_node(vtype, data);
     }
     MemoryCache::Slot* MemoryCache::SlotDeleter::allocate(DataType vtype, std::size_t size) noexcept
     {
+        if (arena != nullptr)
+            return ct::ordered_byte_map<Slot>::arena_node(*arena, vtype, size);
         return ct::ordered_byte_map<Slot>::allocate_node(vtype, size);
     }
     void MemoryCache::SlotDeleter::operator()(Slot* slot) noexcept
     {
-        ct::ordered_byte_map<Slot>::delete_node(slot);
+        if (arena == nullptr)
+            ct::ordered_byte_map<Slot>::delete_node(slot);
     }
 
     bool MemoryCache::LockData::expired_auto() const noexcept
@@ -141,8 +155,13 @@ namespace rdb
 
     void MemoryCache::_move(MemoryCache&& copy) noexcept
     {
-        while (copy._flush_running.load() != 0)
-            copy._flush_running.wait(copy._flush_running.load());
+        // The flush thread refers to the cache it was launched by, it is launched again on the next flush
+        copy._flush_stop();
+        if (_shared.write_buffer != nullptr)
+        {
+            _shared.write_buffer->charge(-static_cast<std::ptrdiff_t>(_pressure));
+            _shared.write_buffer->detach();
+        }
         _disk_logs = std::move(copy._disk_logs);
         _path = std::move(copy._path);
         _map = std::move(copy._map);
@@ -150,22 +169,54 @@ namespace rdb
         _readonly_maps = std::move(copy._readonly_maps);
         _handle_cache = std::move(copy._handle_cache);
         _handle_cache_tracker = std::move(copy._handle_cache_tracker);
-        _flush_thread = std::move(copy._flush_thread);
+        _disk_cache = std::exchange(copy._disk_cache, nullptr);
+        _disk_cache_owned = std::move(copy._disk_cache_owned);
+        _page_cache = std::exchange(copy._page_cache, nullptr);
+        _page_cache_owned = std::move(copy._page_cache_owned);
+        _segment_index = std::move(copy._segment_index);
+        _segment_indexed = copy._segment_indexed;
+        _segments = std::move(copy._segments);
+        _shared_segments = std::exchange(copy._shared_segments, std::make_shared<const shared_segments>());
+        _compaction_range = copy._compaction_range;
+        _compaction_pending = copy._compaction_pending.load();
+        _compaction_garbage = copy._compaction_garbage;
+        _scrub_timestamp = copy._scrub_timestamp;
+        _verify_counter = copy._verify_counter;
         _mappings = copy._mappings;
         _descriptors = copy._descriptors;
         _flush_id = copy._flush_id.load();
+        _flush_pressure = copy._flush_pressure.load();
+        _stall = copy._stall;
         _shared = copy._shared;
+        // The write buffer share moves with the memtable
+        copy._shared.write_buffer = nullptr;
         _id = copy._id;
         _pressure = copy._pressure;
         _schema = copy._schema;
         _lock_cnt = copy._lock_cnt;
     }
-    void MemoryCache::_push_bytes(int bytes) noexcept
+    std::unique_lock<util::SharedSpinlock> MemoryCache::_map_exclusive() noexcept
+    {
+        if (_shared.cfg->cache.concurrent_reads)
+            return std::unique_lock(_map_lock);
+        return std::unique_lock<util::SharedSpinlock>();
+    }
+    void MemoryCache::_sync_pressure() noexcept
     {
-        _pressure += bytes;
+        const auto pressure = _memory(*_map);
+        if (_shared.write_buffer != nullptr)
+            _shared.write_buffer->charge(static_cast<std::ptrdiff_t>(pressure) - static_cast<std::ptrdiff_t>(_pressure));
+        _pressure = pressure;
+    }
+    std::size_t MemoryCache::_memory(const write_store& map) noexcept
+    {
+        // Arena chunks (slots, keys and tree nodes) and the hash table (slots and control bytes)
+        return
+            map.arena.reserved() +
+            map.capacity() * (sizeof(write_store::value_type) + 1);
     }
 
-    MemoryCache::MemoryCache(Shared shared, std::size_t core, schema_type schema) :
+    MemoryCache::MemoryCache(Shared shared, std::size_t core, schema_type schema, DiskCache* disk_cache, PageCache* page_cache) :
         _shared(shared),
         _map(std::make_shared<write_store>()),
         _path(
@@ -175,8 +226,23 @@ namespace rdb
         ),
         _id(core),
         _disk_logs(shared, _path/"logs", schema),
+        _disk_cache(disk_cache),
+        _page_cache(page_cache),
+        _segment_index(shared.cfg->cache.max_segment_index_volume),
         _schema(schema)
     {
+        if (_disk_cache == nullptr)
+        {
+            _disk_cache_owned = DiskCache::make(_shared.cfg->cache.cache_type, _shared.cfg->cache.max_cache_volume);
+            _disk_cache = _disk_cache_owned.get();
+        }
+        if (_page_cache == nullptr && _shared.cfg->cache.cache_page)
+        {
+            _page_cache_owned = std::make_unique<PageCache>(_shared.cfg->cache.max_page_cache_volume);
+            _page_cache = _page_cache_owned.get();
+        }
+        if (_shared.write_buffer != nullptr)
+            _shared.write_buffer->attach();
         _handle_cache.reserve(164);
         _handle_cache_tracker.reserve(164);
         if (!std::filesystem::exists(_path))
@@ -190,19 +256,42 @@ namespace rdb
         {
             RDB_MODULE(mem, "C", _id, " Replaying memory cache")
             std::vector<std::filesystem::path> corrupted;
+            std::vector<std::pair<std::size_t, std::size_t>> compactions;
             for (decltype(auto) it : std::filesystem::directory_iterator(_path/"flush"))
             {
-                if (std::filesystem::exists(it.path()/"lock"))
+                const auto name = it.path().filename().string();
+                // Flushes retired by a committed compaction
+                if (name.starts_with('g'))
+                {
+                    corrupted.push_back(it.path());
+                }
+                else if (name.starts_with('c'))
+                {
+                    const auto first = std::stoul(name.substr(1));
+                    const auto last = std::stoul(name.substr(name.find('_') + 1));
+                    if (std::filesystem::exists(it.path()/"lock"))
+                    {
+                        RDB_LOG(mem, "C", _id, " Detected interrupted compaction F", first, "-F", last)
+                        corrupted.push_back(it.path());
+                    }
+                    else
+                    {
+                        compactions.push_back({ first, last });
+                        _flush_id = std::max(
+                                        last + 1,
+                                        _flush_id.load()
+                                    );
+                    }
+                }
+                else if (std::filesystem::exists(it.path()/"lock"))
                 {
                     RDB_LOG(mem, "C", _id, " Detected corrupted flush",
-                            std::stoul(it.path().filename().string().substr(1)))
+                            std::stoul(name.substr(1)))
                     corrupted.push_back(it.path());
                 }
                 else
                 {
-                    _handle_reserve(true);
-
-                    const auto id = std::stoul(it.path().filename().string().substr(1));
+                    const auto id = std::stoul(name.substr(1));
                     if (const auto p = _path/"logs"/std::format("snapshot{}", id);
                             std::filesystem::exists(p))
                         std::filesystem::remove_all(p);
@@ -217,51 +306,116 @@ namespace rdb
             {
                 std::filesystem::remove_all(it);
             }
+            // Finish compactions that were written but never swapped in
+            for (const auto [ first, last ] : compactions)
+            {
+                RDB_LOG(mem, "C", _id, " Completing compaction F", first, "-F", last)
+                const auto merged = _path/"flush"/std::format("c{}_{}", first, last);
+                for (auto id = first; id <= last; id++)
+                    std::filesystem::remove_all(_path/"flush"/std::format("f{}", id));
+                if (std::filesystem::exists(merged/"data.dat"))
+                    std::filesystem::rename(merged, _path/"flush"/std::format("f{}", last));
+                else
+                    std::filesystem::remove_all(merged);
+            }
+            // Flush ids are stable, folded flushes leave permanently locked handles behind
+            auto segments = std::make_shared<shared_segments>();
+            for (std::size_t id = 0; id < _flush_id; id++)
+            {
+                const auto live = std::filesystem::exists(_path/"flush"/std::format("f{}", id));
+                _handle_reserve(live);
+                if (live)
+                {
+                    _segments.push_back(id);
+                    _shared_segment_insert(*segments, id);
+                }
+            }
+            _shared_segments = std::move(segments);
+
+            // Consecutive records of a partition share the lookup (until the map is swapped or a partition is inserted)
+            write_store* cached_map = nullptr;
+            write_store::iterator cached{};
+            key_type cached_key = 0;
+            auto find = [&](key_type key)
+            {
+                if (cached_map != _map.get() || cached_key != key)
+                {
+                    cached_map = _map.get();
+                    cached_key = key;
+                    cached = _find_partition(*_map, key);
+                }
+                return cached;
+            };
 
-            _disk_logs.replay([this](WriteType type, key_type key, View sort, View data)
+            _disk_logs.replay([&](WriteType type, key_type key, View sort, View data)
             {
                 if (type == WriteType::CreatePartition)
                 {
                     RDB_TRACE(mem, "C", _id, " Replay - create partition <", uuid::encode(key, uuid::table_alnum), ">")
                     _create_partition_if(*_map, key, data);
+                    cached_map = nullptr;
+                    return;
+                }
+
+                const auto part = find(key);
+                [[ unlikely ]] if (part == _map->end())
+                {
+                    RDB_WARN(mem, "C", _id, " Replay - skipped record of a missing partition <", uuid::encode(key, uuid::table_alnum), ">")
+                    return;
                 }
-                else if (type == WriteType::Reset)
+                if (type == WriteType::Reset)
                 {
                     RDB_TRACE(mem, "C", _id, " Replay - reset <", uuid::encode(key, uuid::table_alnum), ">")
-                    _reset_impl(_find_partition(*_map, key), sort);
-                    _flush_if();
+                    _reset_impl(part, sort);
                 }
                 else if (type == WriteType::Remov)
                 {
                     RDB_TRACE(mem, "C", _id, " Replay - remove <", uuid::encode(key, uuid::table_alnum), ">")
-                    _remove_impl(_find_partition(*_map, key), sort);
-                    _flush_if();
+                    _remove_impl(part, sort);
                 }
                 else
                 {
                     RDB_TRACE(mem, "C", _id, " Replay - write <", uuid::encode(key, uuid::table_alnum), ">")
-                    _write_impl(_find_partition(*_map, key), type, sort, data);
-                    _flush_if();
+                    _write_impl(part, type, sort, data);
                 }
+                _flush_if();
+            },
+            [this](std::size_t replayed, std::size_t total)
+            {
+                RDB_LOG(mem, "C", _id, " Replayed ", replayed, "b out of ", total, "b")
+                _shared.events->trigger<Event::ReplayProgress>(_id, replayed, total);
             });
         }
+        _disk_logs.prepare();
     }
     MemoryCache::~MemoryCache()
     {
-        _shutdown = true;
-        _flush_tasks.enqueue(nullptr, 0);
+        _flush_stop();
+        // Pending flushes release their share once committed
+        if (_shared.write_buffer != nullptr)
+        {
+            _shared.write_buffer->charge(-static_cast<std::ptrdiff_t>(_pressure));
+            _shared.write_buffer->detach();
+        }
+        // Flush ids may be reused by the next cache of the schema (corrupted flushes are removed)
+        if (_disk_cache != nullptr && _disk_cache_owned == nullptr)
+            _disk_cache->erase(_schema);
+        if (_page_cache != nullptr && _page_cache_owned == nullptr)
+            _page_cache->clear(_schema);
         RDB_MODULE(mem, "C", _id, " Stopping memory cache")
     }
 
     RuntimeSchemaReflection::RTSI& MemoryCache::_info() const noexcept
     {
-        [[ unlikely ]] if (_schema_info == nullptr || RuntimeSchemaReflection::stale(_schema_version))
+        auto* info = _schema_info.load(std::memory_order::acquire);
+        [[ unlikely ]] if (info == nullptr || RuntimeSchemaReflection::stale(_schema_version.load(std::memory_order::relaxed)))
         {
-            const auto [ version, info ] = RuntimeSchemaReflection::version(_schema);
-            _schema_version = version;
-            _schema_info = info;
+            const auto [ version, latest ] = RuntimeSchemaReflection::version(_schema);
+            _schema_version.store(version, std::memory_order::relaxed);
+            _schema_info.store(latest, std::memory_order::release);
+            info = latest;
         }
-        return *_schema_info;
+        return *info;
     }
     std::size_t MemoryCache::core() const noexcept
     {
@@ -271,10 +425,52 @@ namespace rdb
     {
         return _pressure;
     }
+    std::size_t MemoryCache::flush_pressure() const noexcept
+    {
+        return _flush_pressure.load();
+    }
+    bool MemoryCache::idle() noexcept
+    {
+        _compaction_commit_if();
+        // The flush thread stays busy from the commit of a flush until its compaction is running, which lasts until it is pending
+        return
+            _flush_running.load() == 0 &&
+            !_flush_busy.load() &&
+            !_compaction_running.load() &&
+            !_compaction_pending.load();
+    }
+    std::size_t MemoryCache::locks() const noexcept
+    {
+        return _lock_cnt;
+    }
+    WriteStall MemoryCache::stall() const noexcept
+    {
+        return _stall;
+    }
+    float MemoryCache::stall_level() noexcept
+    {
+        const auto level = _stall_update();
+        // If nothing is pending the memtable alone is over the limit and the next flush has to go through
+        [[ unlikely ]] if (level >= 1.f && _flush_running.load() == 0)
+            return 0.f;
+        return level;
+    }
     std::size_t MemoryCache::descriptors() const noexcept
     {
         return _descriptors;
     }
+    const DiskCache& MemoryCache::disk_cache() const noexcept
+    {
+        return *_disk_cache;
+    }
+    const PageCache* MemoryCache::page_cache() const noexcept
+    {
+        return _page_cache;
+    }
+    const SegmentIndex& MemoryCache::segment_index() const noexcept
+    {
+        return _segment_index;
+    }
 
     MemoryCache::FlushHandle& MemoryCache::_handle_open(std::size_t flush) const noexcept
     {
@@ -381,6 +577,46 @@ namespace rdb
         }
     }
 
+    void MemoryCache::_shared_segment_insert(shared_segments& segments, std::size_t flush) noexcept
+    {
+        auto segment = std::make_shared<SharedSegment>();
+        segment->flush = flush;
+        segments.insert(
+            std::upper_bound(segments.begin(), segments.end(), flush,
+                [](std::size_t flush, const auto& it) { return flush < it->flush; }),
+            std::move(segment)
+        );
+    }
+    void MemoryCache::_shared_segment_commit(std::size_t flush) noexcept
+    {
+        const std::lock_guard lock(_shared_segments_lock);
+        auto segments = std::make_shared<shared_segments>(*_shared_segments);
+        _shared_segment_insert(*segments, flush);
+        _shared_segments = std::move(segments);
+    }
+    MemoryCache::FlushHandle* MemoryCache::_shared_segment_map(SharedSegment& segment) const noexcept
+    {
+        [[ likely ]] if (segment.mapped.load(std::memory_order::acquire))
+            return &segment.handle;
+
+        const std::lock_guard lock(_shared_segments_lock);
+        if (segment.retired)
+            return nullptr;
+        if (!segment.mapped.load(std::memory_order::relaxed))
+        {
+            const auto path = _path/"flush"/std::format("f{}", segment.flush);
+            auto& handle = segment.handle;
+            handle.data.open(path/"data.dat", Mapper::OpenMode::Read);
+            handle.indexer.open(path/"indexer.idx", Mapper::OpenMode::Read);
+            handle.bloom.open(path/"filter.blx", Mapper::OpenMode::Read);
+            handle.data.map(Mapper::OpenMode::Read);
+            handle.indexer.map(Mapper::OpenMode::Read);
+            handle.bloom.map(Mapper::OpenMode::Read);
+            segment.mapped.store(true, std::memory_order::release);
+        }
+        return &segment.handle;
+    }
+
     std::size_t MemoryCache::_read_entry_size_impl(const View& view, DataType type) noexcept
     {
         auto& info = _info();
@@ -405,12 +641,16 @@ namespace rdb
     }
     std::size_t MemoryCache::_read_entry_impl(const View& view, DataType type, field_bitmap& fields, const read_callback& callback) noexcept
     {
-        auto& info = _info();
+        return _read_entry_impl(_info(), view, type, fields, callback);
+    }
+    std::size_t MemoryCache::_read_entry_impl(RuntimeSchemaReflection::RTSI& info, const View& view, DataType type, field_bitmap& fields,
+                                              const read_callback& callback) noexcept
+    {
         std::size_t cnt = 0;
         if (type == DataType::FieldSequence)
         {
             std::size_t off = 0;
-            do
+            for (auto count = view.data()[off++]; count--;)
             {
                 const auto field = view.data()[off++];
                 RuntimeInterfaceReflection::RTII& finf =
@@ -432,7 +672,6 @@ namespace rdb
                 }
                 off += size;
             }
-            while (off < view.size());
         }
         else if (type == DataType::SchemaInstance)
         {
@@ -463,7 +702,7 @@ namespace rdb
         }
         return cnt;
     }
-    std::size_t MemoryCache::_read_cache_impl(write_store& map, key_type key, const View& sort, field_bitmap& fields, const read_callback& callback) noexcept
+    std::optional<std::size_t> MemoryCache::_read_cache_impl(write_store& map, key_type key, const View& sort, field_bitmap& fields, const read_callback& callback) noexcept
     {
         auto fp = map.find(key);
         if (fp == map.end())
@@ -471,8 +710,26 @@ namespace rdb
         auto f = _find_slot(fp, sort);
         if (f == nullptr)
             return 0;
+        if (f->vtype == DataType::Tombstone)
+            return std::nullopt;
         return _read_entry_impl(View::view(f->buffer()), f->vtype, fields, callback);
     }
+    std::optional<std::size_t> MemoryCache::_read_cache_shared_impl(const write_store& map, RuntimeSchemaReflection::RTSI& info, key_type key, const View& sort,
+                                                     field_bitmap& fields, const read_callback& callback) noexcept
+    {
+        const auto fp = map.find(key);
+        if (fp == map.end())
+            return 0;
+        const auto& pdata = fp->second.second;
+        const_slot f = info.skeys() ?
+            std::get<partition>(pdata).find(sort) :
+            std::get<single_slot>(pdata).get();
+        if (f == nullptr)
+            return 0;
+        if (f->vtype == DataType::Tombstone)
+            return std::nullopt;
+        return _read_entry_impl(info, View::view(f->buffer()), f->vtype, fields, callback);
+    }
 
     std::optional<std::size_t> MemoryCache::_disk_find_partition(key_type key, FlushHandle& handle) noexcept
     {
@@ -503,9 +760,267 @@ namespace rdb
         metadata.version = byte::sread<std::uint64_t>(data.memory(), off);
         metadata.partition_sparse_index =  byte::sread<std::uint64_t>(data.memory(), off);
         metadata.intra_partition_sparse_index =  byte::sread<std::uint64_t>(data.memory(), off);
+        metadata.sort_sparse_index =  byte::sread<std::uint64_t>(data.memory(), off);
         metadata.block_size = byte::sread<std::uint64_t>(data.memory(), off);
         return { off, metadata };
     }
+    MemoryCache::PartitionHeader MemoryCache::_disk_read_partition(FlushHandle& handle, std::size_t off) noexcept
+    {
+        PartitionHeader header;
+        auto& data = handle.data;
+        header.size = byte::sread<std::uint64_t>(data.memory(), off);
+        header.accumulated_size = byte::sread<std::uint64_t>(data.memory(), off);
+        header.index_offset = byte::sread<std::uint64_t>(data.memory(), off);
+        header.bloom_offset = byte::sread<std::uint64_t>(data.memory(), off);
+        header.block_count = byte::sread<std::uint32_t>(data.memory(), off);
+        header.key_count = byte::sread<std::uint32_t>(data.memory(), off);
+        header.key = byte::sread<key_type>(data.memory(), off);
+        header.begin = off;
+        header.end = off + header.size;
+        return header;
+    }
+    std::optional<MemoryCache::PartitionHeader> MemoryCache::_disk_seek_partition(key_type key, FlushHandle& handle) noexcept
+    {
+        // The primary index is sparse, it only gives us a partition to start walking from
+        auto& data = handle.data;
+        auto [ off, metadata ] = _disk_read_partition_metadata(handle);
+        if (const auto hint = _disk_find_partition(key, handle);
+                hint.has_value() && hint.value() >= off && hint.value() < data.size() &&
+                _disk_read_partition(handle, hint.value()).key <= key)
+        {
+            off = hint.value();
+        }
+
+        while (off < data.size())
+        {
+            const auto partition = _disk_read_partition(handle, off);
+            if (partition.key == key)
+                return partition;
+            // Partitions are written in key order
+            if (partition.key > key)
+                break;
+            off = _disk_next_partition(partition, handle);
+        }
+        return std::nullopt;
+    }
+    std::size_t MemoryCache::_disk_next_partition(const PartitionHeader& partition, FlushHandle& handle) noexcept
+    {
+        auto& info = _info();
+        auto off = partition.end;
+        // Wide partitions with dynamic sorting keys are followed by their block index
+        if (info.skeys() && !info.static_prefix())
+        {
+            const auto count = byte::sread<std::uint32_t>(handle.data.memory(), off);
+            off += count * sizeof(std::uint64_t) * 2;
+        }
+        return off;
+    }
+    MemoryCache::BlockHeader MemoryCache::_disk_read_block(FlushHandle& handle, std::size_t off) noexcept
+    {
+        auto& info = _info();
+        BlockHeader header;
+        auto& data = handle.data;
+        header.version = byte::sread<std::uint16_t>(data.memory(), off);
+        header.flags = byte::sread<std::uint16_t>(data.memory(), off);
+        header.checksum = byte::sread<std::uint64_t>(data.memory(), off);
+        header.index_offset = byte::sread<std::uint64_t>(data.memory(), off);
+        header.decompressed = byte::sread<std::uint32_t>(data.memory(), off);
+        header.compressed = byte::sread<std::uint32_t>(data.memory(), off);
+        header.begin = off;
+        header.end = off + header.compressed;
+        // Min key
+        if (!info.skeys())
+            header.end += sizeof(key_type);
+        else if (info.static_prefix())
+            header.end += sizeof(std::uint64_t);
+        return header;
+    }
+    std::span<const unsigned char> MemoryCache::_disk_read_block_data(FlushHandle& handle, const BlockHeader& block, StaticBufferSink& sink) noexcept
+    {
+        auto& data = handle.data;
+        if (block.decompressed == block.compressed)
+            return data.memory().subspan(block.begin, block.decompressed);
+
+        SourceView source(data.memory().subspan(block.begin, block.compressed));
+        snappy::Uncompress(&source, &sink);
+        return sink.data();
+    }
+    std::span<const unsigned char> MemoryCache::_disk_read_block_cached(std::size_t flush, FlushHandle& handle, std::size_t off, std::size_t compressed, std::size_t decompressed,
+                                                                       std::uint16_t flags, std::uint64_t checksum, DiskCache::block& hold) noexcept
+    {
+        auto& data = handle.data;
+        const auto stored = data.memory().subspan(off, compressed);
+
+        // Raw blocks are served straight from the mapping
+        if (decompressed == compressed)
+        {
+            if (_disk_verify_if() && !_disk_verify_block(flush, off, stored, flags, checksum))
+                return {};
+            return stored;
+        }
+
+        const auto key = DiskCache::key(_schema, flush, off);
+        if ((hold = _disk_cache->find(key)) == nullptr)
+        {
+            if (_disk_verify_if() && !_disk_verify_block(flush, off, stored, flags, checksum))
+                return {};
+
+            auto buffer = std::make_shared<ct::vector<unsigned char>>(decompressed);
+            snappy::RawUncompress(
+                reinterpret_cast<const char*>(stored.data()), compressed,
+                reinterpret_cast<char*>(buffer->data())
+            );
+            hold = std::move(buffer);
+            _disk_cache->insert(key, hold);
+            _shared.events->trigger<Event::DiskCachePressure>(
+                _disk_cache->volume(), _disk_cache->hits(), _disk_cache->misses()
+            );
+        }
+        return *hold;
+    }
+    std::span<const unsigned char> MemoryCache::_disk_read_block_owned(std::size_t flush, FlushHandle& handle, const BlockHeader& block, ct::vector<unsigned char>& buffer) noexcept
+    {
+        // Compactions and stolen reads always verify and bypass the disk cache (which belongs to the owner core)
+        const auto stored = handle.data.memory().subspan(block.begin, block.compressed);
+        if (!_disk_verify_block(flush, block.begin, stored, block.flags, block.checksum))
+            return {};
+        if (block.decompressed == block.compressed)
+            return stored;
+
+        buffer.resize(block.decompressed);
+        snappy::RawUncompress(
+            reinterpret_cast<const char*>(stored.data()), block.compressed,
+            reinterpret_cast<char*>(buffer.data())
+        );
+        return buffer;
+    }
+    bool MemoryCache::_disk_verify_block(std::size_t flush, std::size_t off, std::span<const unsigned char> stored, std::uint16_t flags, std::uint64_t checksum) noexcept
+    {
+        // Older blocks carry a digest of the unencoded entries, those are not verified
+        if (!(flags & BlockFlags::Checksummed))
+            return true;
+        if (xxh::xxhash3<64>(stored.data(), stored.size()) == checksum)
+            return true;
+
+        RDB_WARN("C", _id, " F", flush, " Checksum mismatch in block at ", off)
+        _shared.events->trigger<Event::ChecksumFailure>(flush, off);
+        return false;
+    }
+    bool MemoryCache::_disk_verify_if() noexcept
+    {
+        switch (_shared.cfg->cache.verify_checksums)
+        {
+        case Config::Cache::Verify::Always: return true;
+        case Config::Cache::Verify::Sample:
+            if (++_verify_counter >= _shared.cfg->cache.verify_sample_ratio)
+            {
+                _verify_counter = 0;
+                return true;
+            }
+            return false;
+        default: return false;
+        }
+    }
+    std::pair<MemoryCache::DataType, std::span<const unsigned char>> MemoryCache::_disk_read_sorted_entry(std::span<const unsigned char> block, std::size_t& off, View& sort) noexcept
+    {
+        auto& info = _info();
+        const auto type = DataType(block[off++]);
+        if (type == DataType::SchemaInstance)
+        {
+            const auto len = info.prefix_length(block.data() + off);
+            sort = View::copy(len);
+            info.prefix(block.data() + off, View::view(sort));
+        }
+        else
+        {
+            const auto len = byte::sread<std::uint16_t>(block, off);
+            sort = View::view(block.subspan(off, len));
+            off += len;
+        }
+
+        const auto size = _read_entry_size_impl(View::view(block.subspan(off)), type);
+        const auto entry = block.subspan(off, size);
+        off += size;
+        return { type, entry };
+    }
+
+    bool MemoryCache::_disk_find_sorted_entry(PageCursor& cursor, key_type key, const View& sort) noexcept
+    {
+        auto& handle = *cursor.handle;
+        const auto partition = _disk_seek_partition(key, handle);
+        if (!partition.has_value())
+            return false;
+        if (partition->bloom_offset && !_bloom_may_contain(uuid::xxhash(sort), partition->bloom_offset, handle))
+        {
+            RDB_TRACE(mem, "C", _id, " Intra-partition bloom discard")
+            return false;
+        }
+        return
+            _page_seek(cursor, partition.value(), sort) &&
+            byte::binary_compare(cursor.sort, sort) == 0;
+    }
+    bool MemoryCache::_disk_find_unary_entry(PageCursor& cursor, key_type key) noexcept
+    {
+        // Every unary partition of a flush shares a single partition, its blocks are in key order and end with their first key
+        // The first block is always indexed, so a key without a primary index hint is out of range
+        auto& handle = *cursor.handle;
+        auto& data = handle.data;
+        const auto hint = _disk_find_partition(key, handle);
+        if (!hint.has_value())
+            return false;
+
+        std::optional<BlockHeader> block;
+        for (auto boff = hint.value(); boff < data.size();)
+        {
+            const auto header = _disk_read_block(handle, boff);
+            if (byte::sread<key_type>(data.memory().subspan(header.end - sizeof(key_type))) > key)
+                break;
+            block = header;
+            boff = header.end;
+        }
+        if (!block.has_value())
+            return false;
+
+        cursor.block = cursor.owned ?
+            _disk_read_block_owned(cursor.flush, handle, block.value(), cursor.buffer) :
+            _disk_read_block_cached(cursor.flush, handle, block->begin, block->compressed, block->decompressed, block->flags, block->checksum, cursor.hold);
+        cursor.off = 0;
+        [[ unlikely ]] if (cursor.block.empty())
+        {
+            cursor.corrupt = true;
+            return false;
+        }
+        if (block->index_offset)
+        {
+            auto& indexer = handle.indexer;
+            std::size_t ioff = block->index_offset;
+            const auto cells = byte::sread<std::uint32_t>(indexer.memory(), ioff);
+            if (const auto off = byte::search_partition<key_type, std::uint64_t>(key, indexer.memory().subspan(ioff), cells, true);
+                    off.has_value())
+                cursor.off = off.value();
+        }
+
+        // [ partition key | key | type | entry ]
+        auto& info = _info();
+        const auto entries = cursor.block;
+        while (cursor.off < entries.size())
+        {
+            cursor.off += info.partition_size(entries.data() + cursor.off);
+            const auto entry_key = byte::sread<key_type>(entries, cursor.off);
+            const auto type = DataType(entries[cursor.off++]);
+            const auto size = _read_entry_size_impl(View::view(entries.subspan(cursor.off)), type);
+            if (entry_key == key)
+            {
+                cursor.type = type;
+                cursor.value = entries.subspan(cursor.off, size);
+                return true;
+            }
+            if (entry_key > key)
+                break;
+            cursor.off += size;
+        }
+        return false;
+    }
 
     bool MemoryCache::_read_impl(key_type key, const View& sort, field_bitmap fields, const read_callback& callback) noexcept
     {
@@ -519,16 +1034,16 @@ namespace rdb
 
         auto& info = _info();
         const auto sorted = info.skeys();
-        const auto dynamic = !info.static_prefix();
         const auto required = callback ? fields.count() : 1;
         const auto flush_running = _flush_running.load();
 
-        // Search cache
+        // Search cache (a removed row hides every older version)
         std::size_t found = 0;
         {
-            if ((found += _read_cache_impl(
-                              *_map, key, View::view(sort), fields, callback
-                          )) == required)
+            const auto cached = _read_cache_impl(*_map, key, View::view(sort), fields, callback);
+            if (!cached.has_value())
+                return false;
+            if ((found += cached.value()) == required)
             {
                 return true;
             }
@@ -539,466 +1054,382 @@ namespace rdb
                 {
                     if (const auto lock = it->lock(); lock != nullptr)
                     {
-                        if ((found += _read_cache_impl(
-                                          *lock, key, View::view(sort), fields, callback
-                                      )) == required)
-                        {
+                        const auto cached = _read_cache_impl(*lock, key, View::view(sort), fields, callback);
+                        if (!cached.has_value())
+                            return false;
+                        if ((found += cached.value()) == required)
                             return true;
-                        }
                     }
                 }
             }
-            else
+            else if (!_shared.cfg->cache.concurrent_reads)
                 _readonly_maps.clear();
         }
         // Search disk
         {
             RDB_TRACE(mem, "C", _id, " Cache miss")
+            _compaction_commit_if();
             // Refer to the disk layout in _data_impl
-            for (std::size_t j = _flush_id - flush_running; j > 0; j--)
+            for (const auto [ i, filtered ] : _segment_index_find(key))
             {
-                RDB_TRACE(mem, "C", _id, " Searching S", j - 1)
+                RDB_TRACE(mem, "C", _id, " Searching S", i)
 
-                const auto i = j - 1;
+                // Pending or folded by a compaction
+                if (!_handle_cache[i].ready())
+                    continue;
 
                 auto& handle = _handle_open(i);
-                auto& [ data, indexer, bloom, _1, _2 ] = handle;
-
-                if (handle.ready() && _bloom_may_contain(key, handle))
+                if (!filtered && !_bloom_may_contain(key, handle))
+                    continue;
+
+                // The cursor holds on to the block the entry is read from
+                PageCursor cursor;
+                cursor.flush = i;
+                cursor.handle = &handle;
+                if (!(sorted ?
+                        _disk_find_sorted_entry(cursor, key, sort) :
+                        _disk_find_unary_entry(cursor, key)))
                 {
-                    // Search the indexer
-                    const auto partition_offset = _disk_find_partition(key, handle);
-                    if (!partition_offset.has_value())
-                        continue;
-                    const auto offset = partition_offset.value();
-                    auto off = partition_offset.value();
-
-                    /*const auto partition_size = */byte::sread<std::uint64_t>(data.memory(), off);
-                    /*const auto accumulated_size = */byte::sread<std::uint64_t>(data.memory(), off);
-                    const auto index_offset = byte::sread<std::uint64_t>(data.memory(), off);
-                    const auto bloom_offset = byte::sread<std::uint64_t>(data.memory(), off);
-                    /*const auto block_count = */byte::sread<std::uint32_t>(data.memory(), off);
-                    /*const auto key_count = */byte::sread<std::uint32_t>(data.memory(), off);
-
-                    // Search data
-
-                    // Wide partition
-                    if (sorted)
+                    // An older flush could hold a superseded version, the read fails instead
+                    [[ unlikely ]] if (cursor.corrupt)
                     {
-                        RDB_TRACE(mem, "C", _id, " Searching partition")
-
-                        const auto partition_size = byte::sread<std::uint64_t>(data.memory(), off);
+                        RDB_WARN(mem, "C", _id, " F", i, " Read of <", uuid::encode(key, uuid::table_alnum), "> failed on a corrupted block")
+                        _shared.events->trigger<Event::ReadFailure>(
+                            ReadType::Field,
+                            std::span(reinterpret_cast<const unsigned char*>(&key), sizeof(key))
+                        );
+                        return false;
+                    }
+                    continue;
+                }
 
-                        std::size_t partition_footer_off = off + partition_size;
+                RDB_TRACE(mem, "C", _id, " Value found")
+                if (cursor.type == DataType::Tombstone)
+                    return false;
+                if ((found += _read_entry_impl(View::view(cursor.value), cursor.type, fields, callback)) == required)
+                    return true;
+                RDB_TRACE(mem, "C", _id, " Continue search")
+            }
+        }
 
-                        const auto sparse_block_indices = byte::sread<std::uint32_t>(data.memory(), partition_footer_off);
-                        const auto sort_bloom_offset = byte::sread<std::uint64_t>(data.memory(), partition_footer_off);
+        return false;
+    }
 
-                        if (!_bloom_may_contain(uuid::xxhash(sort), sort_bloom_offset, handle))
-                        {
-                            RDB_TRACE(mem, "C", _id, " Intra-partition bloom discard")
-                            continue;
-                        }
+    bool MemoryCache::_page_fill(PageCursor& cursor) noexcept
+    {
+        // Refills resume from the last key handed out, which is then skipped
+        const auto from = cursor.sort;
+        const auto skip = !cursor.batch.empty();
+        cursor.batch.clear();
+        cursor.batch_off = 0;
 
-                        const auto index = data.memory().subspan(partition_footer_off);
-                        const auto sparse_block_offset = sparse_block_indices ?
-                            (dynamic ?
-                            byte::search_partition_binary_indirect<std::uint64_t, std::uint64_t, std::uint16_t>(
-                                sort, index, data.memory(), sparse_block_indices, true, true
-                            ) :
-                            byte::search_partition_binary<std::uint64_t>(
-                                sort, index, sparse_block_indices, true, true
-                            )
-                        ) : std::optional<std::uint64_t>(off);
-
-                        // Linar search across blocks
-                        if (sparse_block_offset.has_value())
-                        {
-                            data.hint(Mapper::Access::Sequential);
+        auto fill = [&](partition::const_key key, partition::const_pointer value)
+        {
+            if (skip && byte::binary_compare(key, from) == 0)
+                return true;
+            cursor.batch.emplace_back(key, value);
+            return cursor.batch.size() < cursor.limit;
+        };
+        if (from == nullptr) cursor.map->foreach(fill);
+        else cursor.map->foreach(from, fill);
 
-                            off = sparse_block_offset.value();
+        return !cursor.batch.empty();
+    }
+    std::uint64_t MemoryCache::_page_load_block(PageCursor& cursor) noexcept
+    {
+        auto& handle = *cursor.handle;
+        const auto header = _disk_read_block(handle, cursor.boff);
+        cursor.hold = nullptr;
+        cursor.block = cursor.owned ?
+            _disk_read_block_owned(cursor.flush, handle, header, cursor.buffer) :
+            _disk_read_block_cached(cursor.flush, handle, header.begin, header.compressed, header.decompressed, header.flags, header.checksum, cursor.hold);
+        // Failed verification, the rest of the partition is skipped
+        [[ unlikely ]] if (cursor.block.empty())
+        {
+            cursor.corrupt = true;
+            cursor.off = 0;
+            cursor.boff = cursor.pend;
+            return 0;
+        }
+        // The first block of a wide partition leads with the partition key
+        cursor.off = 0;
+        if (cursor.boff == cursor.pbegin && _info().skeys())
+        {
+            cursor.off = _info().partition_size(cursor.block.data());
+            if (cursor.owned)
+                cursor.pkey = View::copy(cursor.block.subspan(0, cursor.off));
+        }
+        cursor.boff = header.end;
+        return header.index_offset;
+    }
+    bool MemoryCache::_page_seek(PageCursor& cursor, key_type key, const View& sort) noexcept
+    {
+        const auto partition = _disk_seek_partition(key, *cursor.handle);
+        if (!partition.has_value())
+            return false;
+        return _page_seek(cursor, partition.value(), sort);
+    }
+    bool MemoryCache::_page_seek(PageCursor& cursor, const PartitionHeader& partition, const View& sort) noexcept
+    {
+        // Refer to the disk layout in _data_impl
 
-                            RDB_TRACE(mem, "C", _id, " Searching block sequence")
-                            while (off < offset + partition_size)
-                            {
-                                const auto prefix = info.static_prefix();
+        auto& handle = *cursor.handle;
+        auto& info = _info();
+        const auto prefix = info.static_prefix() ? info.sprefix_length() : 0;
+        auto& indexer = handle.indexer;
 
-                                /*const auto checksum = */byte::sread<std::uint64_t>(data.memory(), off);
-                                auto index_offset = byte::sread<std::uint64_t>(data.memory(), off);
-                                const auto index_count = byte::sread<std::uint32_t>(indexer.memory(), index_offset);
+        // Handles of owned cursors may be shared with other threads, their hints are left alone
+        if (!cursor.owned)
+            handle.data.hint(Mapper::Access::Sequential);
 
-                                View min_key;
-                                View max_key;
+        cursor.pbegin = partition.begin;
+        cursor.pend = partition.end;
+        cursor.boff = partition.begin;
+        cursor.block = {};
+        cursor.off = 0;
 
-                                auto saved_off = off;
-                                if (dynamic)
-                                {
-                                    const auto keyspace_size = byte::sread<std::uint32_t>(indexer.memory(), index_offset);
-                                    const auto keyspace_last = byte::sread<std::uint32_t>(indexer.memory(), index_offset);
+        // Find the last indexed block starting at or before the sorting key
+        // The block index only exists for static sorting keys, otherwise we scan from the first block
+        if (sort != nullptr && prefix && partition.index_offset)
+        {
+            std::size_t ioff = partition.index_offset;
+            const auto cells = byte::sread<std::uint32_t>(indexer.memory(), ioff);
+            const auto index = indexer.memory().subspan(ioff);
+            if (const auto cell = byte::search_floor<std::uint64_t>(sort, index, prefix, cells);
+                    cell.has_value())
+            {
+                cursor.boff = byte::sread<std::uint64_t>(
+                    index.subspan(cell.value() * (prefix + sizeof(std::uint64_t)) + prefix)
+                );
+                RDB_TRACE(mem, "C", _id, " F", cursor.flush, " Block index hit ", cursor.boff)
+            }
+        }
 
-                                    std::size_t min_off = index_offset;
-                                    std::size_t max_off = index_offset + keyspace_last;
+        // Then jump to the last indexed value at or before the sorting key
+        if (cursor.boff < cursor.pend)
+        {
+            const auto index_offset = _page_load_block(cursor);
+            if (sort != nullptr && prefix && index_offset)
+            {
+                std::size_t ioff = index_offset;
+                const auto cells = byte::sread<std::uint32_t>(indexer.memory(), ioff);
+                const auto index = indexer.memory().subspan(ioff);
+                if (const auto cell = byte::search_floor<std::uint32_t>(sort, index, prefix, cells);
+                        cell.has_value())
+                {
+                    cursor.off = std::max<std::size_t>(cursor.off, byte::sread<std::uint32_t>(
+                        index.subspan(cell.value() * (prefix + sizeof(std::uint32_t)) + prefix)
+                    ));
+                }
+            }
+        }
 
-                                    const auto len_min = byte::sread<std::uint16_t>(indexer.memory(), min_off);
-                                    const auto len_max = byte::sread<std::uint16_t>(indexer.memory(), max_off);
+        while (_page_next(cursor))
+        {
+            if (sort == nullptr || byte::binary_compare(cursor.sort, sort) >= 0)
+                return true;
+        }
+        return false;
+    }
+    bool MemoryCache::_page_next(PageCursor& cursor) noexcept
+    {
+        if (cursor.map != nullptr)
+        {
+            // A short batch means the partition was exhausted
+            if (cursor.batch_off == cursor.batch.size() &&
+                    (cursor.batch.size() < cursor.limit || !_page_fill(cursor)))
+                return false;
 
-                                    min_key = View::view(indexer.memory().subspan(min_off, len_min));
-                                    max_key = View::view(indexer.memory().subspan(max_off, len_max));
+            const auto [ key, value ] = cursor.batch[cursor.batch_off++];
+            cursor.sort = View::view(key);
+            cursor.type = value->vtype;
+            cursor.value = value->buffer();
+            return true;
+        }
 
-                                    saved_off += sizeof(std::uint32_t) * 2;
-                                }
-                                else
-                                {
-                                    min_key = View::view(indexer.memory().subspan(index_offset, prefix));
-                                    max_key = View::view(indexer.memory().subspan(index_offset + (index_count - 1) * (prefix + sizeof(std::uint32_t)), prefix));
-                                }
+        while (cursor.off >= cursor.block.size())
+        {
+            if (cursor.boff >= cursor.pend)
+                return false;
+            _page_load_block(cursor);
+        }
 
-                                const auto decompressed = byte::sread<std::uint32_t>(data.memory(), off);
-                                const auto compressed = byte::sread<std::uint32_t>(data.memory(), off);
+        const auto begin = cursor.off;
+        const auto [ type, value ] = _disk_read_sorted_entry(cursor.block, cursor.off, cursor.sort);
+        cursor.type = type;
+        cursor.value = value;
+        cursor.entry = cursor.block.subspan(begin, cursor.off - begin);
+        return true;
+    }
 
-                                const auto result_min = byte::binary_compare(sort, min_key);
-                                const auto result_max = byte::binary_compare(sort, max_key);
+    View MemoryCache::page(key_type key, std::size_t count) noexcept
+    {
+        return page_from(key, nullptr, count);
+    }
+    View MemoryCache::page_from(key_type key, const View& sort, std::size_t count) noexcept
+    {
+        RDB_TRACE(mem, "C", _id, " Page ", count, "c <", uuid::encode(key, uuid::table_alnum), ">")
 
-                                if ((result_min <= 0 && result_max >= 0) ||
-                                    (result_max <= 0 && result_min >= 0))
-                                {
-                                    const auto ascending = (result_min <= 0 && result_max >= 0);
+        auto& info = _info();
+        if (info.skeys() && count > 0)
+        {
+            if (_page_cache != nullptr)
+            {
+                if (auto cached = _page_cache->find(_schema, key, sort, count); cached.has_value())
+                {
+                    RDB_TRACE(mem, "C", _id, " Page cache hit <", uuid::encode(key, uuid::table_alnum), ">")
+                    return std::move(cached.value());
+                }
+            }
 
-                                    RDB_TRACE(mem, "C", _id, " Found matching block")
+            // Every source of the partition is a sorted cursor, newest first
+            // Descending keys are stored inverted, so byte order is already the result order
+            ct::vector<std::shared_ptr<write_store>> maps;
+            ct::vector<PageCursor> cursors;
 
-                                    const auto sparse_offset = dynamic ?
-                                    byte::search_partition_binary_indirect<std::uint32_t, std::uint32_t, std::uint16_t>(
-                                        sort, index, data.memory().subspan(saved_off), index_count, true
-                                    ) :
-                                    byte::search_partition_binary<std::uint32_t>(
-                                        sort.data(), data.memory().subspan(saved_off), prefix, index_count, ascending, true
-                                    );
+            auto push_map = [&](const std::shared_ptr<write_store>& map)
+            {
+                const auto part = _find_partition(*map, key);
+                if (part == map->end())
+                    return;
 
-                                    if (sparse_offset.has_value())
-                                    {
-                                        StaticBufferSink sink = (decompressed == compressed) ?
-                                                                StaticBufferSink() : StaticBufferSink(decompressed);
-                                        SourceView source(data.memory().subspan(off, compressed));
-                                        std::span<const unsigned char> block;
-
-                                        if (decompressed != compressed)
-                                        {
-                                            snappy::Uncompress(&source, &sink);
-                                            block = sink.data();
-                                        }
-                                        else
-                                        {
-                                            block = data.memory().subspan(off, decompressed);
-                                        }
-
-                                        RDB_TRACE(mem, "C", _id, " Linear block search")
-
-                                        off = sparse_offset.value() + info.partition_size(block.data());
-                                        do
-                                        {
-                                            const auto type = DataType(block[off++]);
-                                            const auto instance = View::view(block.subspan(off));
-                                            bool eq = false;
-                                            if (type == DataType::SchemaInstance)
-                                            {
-                                                const auto len = info.prefix_length(block.data() + off);
-                                                View prefix = View::copy(len);
-                                                info.prefix(block.data() + off, View::view(prefix));
-                                                eq = byte::binary_equal(sort, prefix.data());
-                                            }
-                                            else if (type == DataType::Tombstone)
-                                            {
-                                                RDB_TRACE(mem, "C", _id, " Value removed")
-                                                return false;
-                                            }
-                                            else
-                                            {
-                                                const auto len = byte::sread<std::uint16_t>(block, off);
-                                                eq = byte::binary_equal(sort, block.subspan(off, len));
-                                                off += len;
-                                            }
-
-                                            if (eq)
-                                            {
-                                                RDB_TRACE(mem, "C", _id, " Value found")
-                                                if ((found += _read_entry_impl(instance, type, fields, callback)) == required)
-                                                {
-                                                    return true;
-                                                }
-                                                else
-                                                {
-                                                    RDB_TRACE(mem, "C", _id, " Continue search")
-                                                    break;
-                                                }
-                                            }
-                                            else
-                                            {
-                                                off += _read_entry_size_impl(
-                                                           View::view(block.subspan(off)), type
-                                                       );
-                                            }
-                                        }
-                                        while (off < block.size());
-                                    }
-                                    else
-                                    {
-                                        RDB_TRACE(mem, "C", _id, " Bloom miss")
-                                    }
-                                }
-                                else
-                                    off += compressed;
-                            }
-                        }
-                        else
-                        {
-                            RDB_TRACE(mem, "C", _id, " Intra-Bloom miss")
-                        }
-                    }
-                    // Unary partition
-                    else
-                    {
-                        // Search block
-                        // Search the sparse index table
-                        // Linear search the partition
-
-                        // Block header
-
-                        /*const auto checksum = */byte::sread<std::uint64_t>(data.memory(), off);
-                        auto index_offset = byte::sread<std::uint64_t>(data.memory(), off);
-                        const auto index_count = byte::sread<std::uint32_t>(indexer.memory(), index_offset);
-
-                        // Search in block
-
-                        RDB_TRACE(mem, "C", _id, " Searching in block")
+                PageCursor cursor;
+                cursor.age = cursors.size();
+                cursor.map = &std::get<partition>(part->second.second);
+                cursor.limit = count;
+                cursor.sort = sort;
+                if (_page_fill(cursor) && _page_next(cursor))
+                {
+                    maps.push_back(map);
+                    cursors.push_back(std::move(cursor));
+                }
+            };
 
-                        const auto sparse_offset = byte::search_partition<key_type, std::uint64_t>(
-                            key, indexer.memory().subspan(index_offset), index_count, true
-                        );
+            // Check primary cache
+            push_map(_map);
+            // Check readonly maps
+            if (_flush_running)
+            {
+                RDB_TRACE(mem, "C", _id, " Scanning RMPS")
+                for (auto it = _readonly_maps.rbegin(); it != _readonly_maps.rend(); ++it)
+                {
+                    if (const auto lock = it->lock(); lock != nullptr)
+                        push_map(lock);
+                }
+            }
+            else if (!_shared.cfg->cache.concurrent_reads)
+                _readonly_maps.clear();
+            // Check disk
+            bool corrupt = false;
+            {
+                _compaction_commit_if();
+                for (const auto [ i, filtered ] : _segment_index_find(key))
+                {
+                    RDB_TRACE(mem, "C", _id, "Searching F", i)
 
-                        // Continue block hehader
+                    if (!_handle_cache[i].ready())
+                        continue;
 
-                        const auto decompressed = byte::sread<std::uint32_t>(data.memory(), off);
-                        const auto compressed = byte::sread<std::uint32_t>(data.memory(), off);
+                    auto& handle = _handle_open(i);
+                    if (filtered || _bloom_may_contain(key, handle))
+                    {
+                        PageCursor cursor;
+                        cursor.age = cursors.size();
+                        cursor.flush = i;
+                        cursor.handle = &handle;
+                        if (_page_seek(cursor, key, sort))
+                            cursors.push_back(std::move(cursor));
+                        else if (cursor.corrupt)
+                            corrupt = true;
+                    }
+                }
 
-                        if (sparse_offset.has_value())
+                // Opening a flush may have closed one we are already reading from (resource limits)
+                for (std::size_t pass = 0; pass < cursors.size(); pass++)
+                {
+                    bool stable = true;
+                    for (auto it = cursors.begin(); it != cursors.end();)
+                    {
+                        if (it->handle == nullptr || it->handle->data.is_mapped())
                         {
-                            data.hint(Mapper::Access::Sequential);
-
-                            StaticBufferSink sink = (decompressed == compressed) ? StaticBufferSink() : StaticBufferSink(decompressed);
-                            SourceView source(data.memory().subspan(off, compressed));
-                            std::span<const unsigned char> block;
-
-                            if (decompressed != compressed)
-                            {
-                                snappy::Uncompress(&source, &sink);
-                                block = sink.data();
-                            }
-                            else
-                            {
-                                block = data.memory().subspan(off, decompressed);
-                            }
-
-                            RDB_TRACE(mem, "C", _id, " Linear block search")
-
-                            off = sparse_offset.value();
-                            do
-                            {
-                                if (byte::sread<key_type>(block, off) == key)
-                                {
-                                    RDB_TRACE(mem, "C", _id, " Value found")
-
-                                    const auto type = DataType(block[off++]);
-                                    const auto instance = View::view(block.subspan(off));
-                                    if (type == DataType::Tombstone)
-                                        return false;
-
-                                    if ((found += _read_entry_impl(instance, type, fields, callback)) == required)
-                                    {
-                                        return true;
-                                    }
-                                    else
-                                    {
-                                        RDB_TRACE(mem, "C", _id, " Continue search")
-                                        break;
-                                    }
-                                }
-                                else
-                                {
-                                    const auto type = DataType(block[off++]);
-                                    const auto instance = View::view(block.subspan(off));
-                                    off += _read_entry_size_impl(instance, type);
-                                    off += info.partition_size(block.data() + off);
-                                }
-                            }
-                            while (off < block.size());
+                            ++it;
+                            continue;
                         }
-                        else
+                        stable = false;
+                        _handle_open(it->flush);
+                        if (!_page_seek(*it, key, sort))
                         {
-                            RDB_TRACE(mem, "C", _id, " Bloom miss")
+                            corrupt |= it->corrupt;
+                            it = cursors.erase(it);
                         }
+                        else
+                            ++it;
                     }
+                    if (stable)
+                        break;
                 }
             }
-        }
-
-        return false;
-    }
-
-    std::tuple<std::size_t, View, View> MemoryCache::_page_map(write_store::iterator map, key_type key, const View& sort, std::size_t count) noexcept
-    {
-        std::tuple<std::size_t, View, View> ret;
-        auto& [ cnt, result, last ] = ret;
-
-        const auto& part = std::get<partition>(map->second.second);
-        const auto saved_count = count;
-        std::size_t size = 0;
-
-        // Reserve required space up front (we also get to know which key is last)
-        auto scan = [&](partition::const_key, partition::const_pointer value)
-        {
-            size += value->size;
-            cnt++;
-            if (--count == 0)
-                return false;
-            return true;
-        };
-        if (sort == nullptr) part.foreach(scan);
-        else part.foreach(sort, scan);
-
-        result = View::copy(size);
-
-        std::size_t off = 0;
-        std::size_t last_cnt_proper = 0;
-        count = saved_count;
-
-        // Copy the data into our buffer and get the actual last key
-        auto accumulate = [&](partition::const_key key, partition::const_pointer value)
-        {
-            std::memcpy(
-                result.mutate().data() + off,
-                value->buffer().data(),
-                value->size
-            );
-            off += value->size;
-            if (--count == 0)
-                return false;
-            if (++last_cnt_proper == cnt)
-                last = View::view(key);
-            return true;
-        };
-        if (sort == nullptr) part.foreach(accumulate);
-        else part.foreach(sort, accumulate);
-
-        return ret;
-    }
-    std::tuple<std::size_t, View, View> MemoryCache::_page_disk(key_type key, const View& sort, std::size_t count, FlushHandle& handle) noexcept
-    {
-        return {};
-    }
-
-    View MemoryCache::page(key_type key, std::size_t count) noexcept
-    {
-        return page_from(key, nullptr, count);
-    }
-    View MemoryCache::page_from(key_type key, const View& sort, std::size_t count) noexcept
-    {
-        thread_local std::unique_ptr<View[]> frag_pool_data{ new View[4] };
-        thread_local std::span<View> frag_pool{ frag_pool_data.get(), 4 };
 
-        RDB_TRACE(mem, "C", _id, " Page ", count, "c <", uuid::encode(key, uuid::table_alnum), ">")
+            // K-way merge, the smallest key first and the newest source first on ties
+            auto order = [](const PageCursor* lhs, const PageCursor* rhs)
+            {
+                if (const auto cmp = byte::binary_compare(lhs->sort, rhs->sort); cmp != 0)
+                    return cmp > 0;
+                return lhs->age > rhs->age;
+            };
+            std::priority_queue<PageCursor*, ct::vector<PageCursor*>, decltype(order)> heap(order);
+            for (decltype(auto) it : cursors)
+                heap.push(&it);
 
-        auto& info = _info();
-        if (info.skeys() && count > 0)
-        {
-            auto partition = _find_partition(*_map, key);
+            // The requested count keys the page cache, so the remainder is tracked separately
             View result = nullptr;
-            View last = nullptr;
-
-            auto push = [&](View value, std::size_t cnt)
+            ct::vector<PageCursor*> advance;
+            auto remaining = count;
+            while (!heap.empty() && remaining)
             {
-                count -= cnt;
-                if (cnt)
+                auto* top = heap.top();
+                heap.pop();
+
+                if (top->type != DataType::Tombstone)
                 {
                     if (result == nullptr)
-                    {
-                        if (!count)
-                        {
-                            result = std::move(value);
-                        }
-                        else
-                        {
-                            result = View::copy();
-                            auto& v = *result.vec();
-                            v.reserve((count * value.size()) / cnt);
-                            v.insert(v.end(), value.begin(), value.end());
-                        }
-                    }
-                    else
-                    {
-                        auto& v = *result.vec();
-                        v.insert(v.end(), value.begin(), value.end());
-                    }
-
+                        result = View::copy();
+                    auto& v = *result.vec();
+                    v.insert(v.end(), top->value.begin(), top->value.end());
+                    remaining--;
                 }
-            };
 
-            // Check primary cache
-            if (partition != _map->end())
-            {
-                auto [ cnt, li, lkey ] = _page_map(partition, key, sort, count);
-                push(std::move(li), cnt);
-                last = std::move(lkey);
-            }
-            // Check readonly maps
-            if (count)
-            {
-                if (_flush_running)
+                // Older versions of the same key are shadowed
+                advance.clear();
+                advance.push_back(top);
+                while (!heap.empty() && byte::binary_compare(heap.top()->sort, top->sort) == 0)
                 {
-                    RDB_TRACE(mem, "C", _id, " Scanning RMPS")
-                    for (auto it = _readonly_maps.rbegin(); it != _readonly_maps.rend(); ++it)
-                    {
-                        if (const auto lock = it->lock(); lock != nullptr)
-                        {
-                            auto data = _find_partition(*lock, key);
-                            if (data != lock->end())
-                            {
-                                auto [ cnt, li, lkey ] = _page_map(data, key, last, count);
-                                push(std::move(li), cnt);
-                                if (lkey != nullptr)
-                                    last = std::move(lkey);
-                                if (!count)
-                                    break;
-                            }
-                        }
-                    }
+                    advance.push_back(heap.top());
+                    heap.pop();
                 }
-                else
-                    _readonly_maps.clear();
-            }
-            // Check disk
-            if (count)
-            {
-                const auto flush_running = _flush_running.load();
-                for (std::size_t j = _flush_id - flush_running; j > 0; j--)
+                for (decltype(auto) it : advance)
                 {
-                    RDB_TRACE(mem, "C", _id, "Searching F", j - 1)
+                    if (_page_next(*it))
+                        heap.push(it);
+                }
+            }
 
-                    const auto i = j - 1;
+            // A page that skipped a corrupted block could show superseded rows, it fails as a whole
+            for (decltype(auto) it : cursors)
+                corrupt |= it.corrupt;
+            [[ unlikely ]] if (corrupt)
+            {
+                RDB_WARN(mem, "C", _id, " Page of <", uuid::encode(key, uuid::table_alnum), "> failed on a corrupted block")
+                _shared.events->trigger<Event::ReadFailure>(
+                    ReadType::Page,
+                    std::span(reinterpret_cast<const unsigned char*>(&key), sizeof(key))
+                );
+                return nullptr;
+            }
 
-                    auto& handle = _handle_open(i);
-                    auto& [ data, indexer, bloom, _1, _2 ] = handle;
+            if (_page_cache != nullptr)
+                _page_cache->insert(_schema, key, sort, count, result);
 
-                    if (handle.ready() && _bloom_may_contain(key, handle))
-                    {
-                        auto [ cnt, li, lkey ] = _page_disk(key, last, count, handle);
-                        push(std::move(li), cnt);
-                        if (lkey != nullptr)
-                            last = std::move(lkey);
-                        if (!count)
-                            break;
-                    }
-                }
-            }
             RDB_LOG(mem, "C", _id, "Size ", result.size(), "b <", uuid::encode(key, uuid::table_alnum), ">")
             return result;
         }
@@ -1012,32 +1443,135 @@ namespace rdb
     {
         return _read_impl(key, sort, field_bitmap(), nullptr);
     }
-
-    MemoryCache::write_store::iterator MemoryCache::_create_partition_log_if(write_store& map, key_type key, const View& pkey) noexcept
+    std::optional<bool> MemoryCache::read_shared(key_type key, const View& sort, field_bitmap fields, const read_callback& callback) noexcept
     {
-        auto& schema = _info();
-        auto [ it, created ] = map.emplace(
-                                   key,
-                                   std::make_pair(
-                                       View::copy(pkey),
-                                       schema.skeys() ? partition_variant(partition()) : partition_variant(single_slot())
-                                   )
-                               );
-        if (created)
+        return _read_shared_impl(key, sort, fields, callback, false);
+    }
+    std::optional<bool> MemoryCache::exists_shared(key_type key, const View& sort) noexcept
+    {
+        return _read_shared_impl(key, sort, field_bitmap(), nullptr, false);
+    }
+    std::optional<bool> MemoryCache::read_stolen(key_type key, const View& sort, field_bitmap fields, const read_callback& callback) noexcept
+    {
+        return _read_shared_impl(key, sort, fields, callback, true);
+    }
+    std::optional<bool> MemoryCache::exists_stolen(key_type key, const View& sort) noexcept
+    {
+        return _read_shared_impl(key, sort, field_bitmap(), nullptr, true);
+    }
+    std::optional<bool> MemoryCache::_read_shared_impl(key_type key, const View& sort, field_bitmap fields, const read_callback& callback, bool segments) noexcept
+    {
+        if (!_shared.cfg->cache.concurrent_reads)
+            return std::nullopt;
+        // The cached schema info belongs to the owner core
+        auto* info = RuntimeSchemaReflection::fetch(_schema);
+        if (info == nullptr)
+            return std::nullopt;
+
+        // Values are delivered only once the read is complete (a partial hit is read again by the owner core)
+        // The readonly maps they point into are held until then
+        thread_local ct::vector<std::pair<std::size_t, View>> values{};
+        thread_local ct::vector<std::shared_ptr<write_store>> maps{};
+        values.clear();
+        maps.clear();
+        const auto collect = callback ? read_callback([](std::size_t field, View value)
+        {
+            values.emplace_back(field, std::move(value));
+        }) : read_callback();
+        const auto required = callback ? fields.count() : 1;
+
+        std::shared_lock lock(_map_lock);
+        // A removed row ends the read, the fields of newer versions are all there is
+        std::size_t found = 0;
+        bool removed = false;
+        if (const auto cached = _read_cache_shared_impl(*_map, *info, key, sort, fields, collect); cached.has_value())
+            found += cached.value();
+        else
+            removed = true;
+        for (auto it = _readonly_maps.rbegin(); !removed && found != required && it != _readonly_maps.rend(); ++it)
+        {
+            if (auto map = it->lock(); map != nullptr)
+            {
+                if (const auto cached = _read_cache_shared_impl(*map, *info, key, sort, fields, collect); cached.has_value())
+                    found += cached.value();
+                else
+                    removed = true;
+                maps.push_back(std::move(map));
+            }
+        }
+
+        if (!removed && found != required)
         {
-            RDB_LOG(mem, "C", _id, " Creating partition <", uuid::encode(key, uuid::table_alnum), ">")
-            _disk_logs.log(WriteType::CreatePartition, key, nullptr, pkey);
+            if (!segments)
+                return std::nullopt;
+
+            // The memtable is written to by the owner core once the lock is released, its values are copied
+            for (decltype(auto) it : values)
+                it.second = View::copy(it.second);
+            lock.unlock();
+
+            // Listed after the memtables were read, a flushed memtable that is gone is in the list
+            std::shared_ptr<const shared_segments> list;
+            {
+                const std::lock_guard guard(_shared_segments_lock);
+                list = _shared_segments;
+            }
+            const auto copy = callback ? read_callback([](std::size_t field, View value)
+            {
+                values.emplace_back(field, View::copy(value));
+            }) : read_callback();
+            for (auto it = list->rbegin(); !removed && found != required && it != list->rend(); ++it)
+            {
+                auto* handle = _shared_segment_map(**it);
+                if (handle == nullptr)
+                    return std::nullopt;
+                if (!_bloom_may_contain(key, *handle))
+                    continue;
+
+                PageCursor cursor;
+                cursor.flush = (*it)->flush;
+                cursor.handle = handle;
+                cursor.owned = true;
+                if (!(info->skeys() ?
+                        _disk_find_sorted_entry(cursor, key, sort) :
+                        _disk_find_unary_entry(cursor, key)))
+                {
+                    // The owner core reports it
+                    if (cursor.corrupt)
+                        return std::nullopt;
+                    continue;
+                }
+                if (cursor.type == DataType::Tombstone)
+                    removed = true;
+                else
+                    found += _read_entry_impl(*info, View::view(cursor.value), cursor.type, fields, copy);
+            }
         }
-        return it;
+        for (decltype(auto) it : values)
+            callback(it.first, std::move(it.second));
+        return found == required;
+    }
+
+    void MemoryCache::_log_partition_if(const write_store& map, key_type key, const View& pkey) noexcept
+    {
+        // Only the owning core mutates the memtable, the lookup does not need the map lock
+        if (map.contains(key))
+            return;
+        RDB_LOG(mem, "C", _id, " Creating partition <", uuid::encode(key, uuid::table_alnum), ">")
+        _disk_logs.log(WriteType::CreatePartition, key, nullptr, pkey);
     }
     MemoryCache::write_store::iterator MemoryCache::_create_partition_if(write_store& map, key_type key, const View& pkey) noexcept
     {
+        if (const auto f = map.find(key); f != map.end())
+            return f;
         auto& schema = _info();
         return map.emplace(
                    key,
                    std::make_pair(
-                       View::copy(pkey),
-                       schema.skeys() ? partition_variant(partition()) : partition_variant(single_slot())
+                       View::view(map.arena.copy(pkey.data())),
+                       schema.skeys() ?
+                           partition_variant(partition(&map.arena)) :
+                           partition_variant(single_slot(nullptr, SlotDeleter{ &map.arena }))
                    )
                ).first;
     }
@@ -1069,7 +1603,7 @@ namespace rdb
         }
         else
         {
-            ptr.reset(SlotDeleter::allocate(vtype, reserve));
+            ptr.reset(ptr.get_deleter().allocate(vtype, reserve));
             return ptr.get();
         }
     }
@@ -1114,7 +1648,7 @@ namespace rdb
         }
         else
         {
-            ptr.reset(SlotDeleter::allocate(vtype, buffer));
+            ptr.reset(ptr.get_deleter().allocate(vtype, buffer));
             return ptr.get();
         }
     }
@@ -1126,34 +1660,56 @@ namespace rdb
         return _create_unsorted_slot(partition, vtype, buffer);
     }
 
-    MemoryCache::slot MemoryCache::_resize_sorted_slot(write_store::iterator partition, const View& sort, std::size_t size)
+    std::size_t MemoryCache::_slot_capacity(std::size_t size) const noexcept
     {
-        auto& data = std::get<MemoryCache::partition>(partition->second.second);
-        auto* ptr = data.find(sort);
-        auto* nptr = SlotDeleter::allocate(ptr->vtype, size);
+        // Geometric slack so repeated growth (appends) is amortized
+        size += static_cast<std::size_t>(size * _shared.cfg->cache.slot_growth);
+        // Size classes, 16 byte steps for small slots then four classes per doubling
+        if (size <= 128)
+            return (size + 15) & ~std::size_t(15);
+        const auto step = std::bit_floor(size) / 4;
+        return (size + step - 1) & ~(step - 1);
+    }
+    MemoryCache::slot MemoryCache::_grow_slot(SlotDeleter alloc, slot ptr, std::size_t size) noexcept
+    {
+        const auto capacity = _slot_capacity(size);
+        // The most recent allocation of the arena is grown in place
+        if (alloc.arena != nullptr && alloc.arena->extend(
+                ptr,
+                Slot::allocation_size(ptr->vtype, ptr->capacity),
+                Slot::allocation_size(ptr->vtype, capacity)
+            ))
+        {
+            ptr->capacity = capacity;
+            ptr->size = size;
+            return ptr;
+        }
 
+        auto* nptr = alloc.allocate(ptr->vtype, capacity);
         std::memcpy(
             nptr->buffer().data(),
             ptr->buffer().data(),
             ptr->size
         );
-        data.insert(sort, nptr);
-
+        nptr->size = size;
+        return nptr;
+    }
+    MemoryCache::slot MemoryCache::_resize_sorted_slot(write_store::iterator partition, const View& sort, std::size_t size)
+    {
+        auto& data = std::get<MemoryCache::partition>(partition->second.second);
+        auto* ptr = data.find(sort);
+        auto* nptr = _grow_slot(SlotDeleter{ data.arena() }, ptr, size);
+        if (nptr != ptr)
+            data.insert(sort, nptr);
         return nptr;
     }
     MemoryCache::slot MemoryCache::_resize_unsorted_slot(write_store::iterator partition, std::size_t size)
     {
         auto& ptr = std::get<single_slot>(partition->second.second);
-        auto* nptr = SlotDeleter::allocate(ptr->vtype, size);
-
-        std::memcpy(
-            nptr->buffer().data(),
-            ptr->buffer().data(),
-            ptr->size
-        );
-        ptr.reset(nptr);
-
-        return ptr.get();
+        auto* nptr = _grow_slot(ptr.get_deleter(), ptr.get(), size);
+        if (nptr != ptr.get())
+            ptr.reset(nptr);
+        return nptr;
     }
     MemoryCache::slot MemoryCache::_resize_slot(write_store::iterator partition, const View& sort, std::size_t size)
     {
@@ -1181,8 +1737,93 @@ namespace rdb
         return _find_unsorted_slot(partition);
     }
 
+    MemoryCache::slot MemoryCache::_write_field_impl(write_store::iterator partition, const View& sort, slot slot, std::span<const unsigned char> data) noexcept
+    {
+        auto& info =
+            _info();
+
+        if (slot->vtype == DataType::SchemaInstance)
+        {
+            auto state = FieldWriteApplyState
+            {
+                .size = slot->size,
+                .capacity = slot->capacity
+            };
+            const auto size = info.fwapply(
+                                  slot->buffer().data(),
+                                  data[0], View::view(data.subspan(1)),
+                                  state
+                              );
+            if (size > slot->capacity)
+            {
+                slot = _resize_slot(partition, sort, size);
+                state.capacity = slot->capacity;
+                info.fwapply(
+                    slot->buffer().data(),
+                    data[0], View::view(data.subspan(1)),
+                    state
+                );
+            }
+            slot->size = size;
+            return slot;
+        }
+
+        // [ uint8(field-count) | [ uint8(field) | value ] ... ]
+        const auto args = View::view(data.subspan(1));
+        const auto size = slot->size;
+        auto* sdata = slot->buffer().data();
+        std::size_t off = 1;
+        for (auto count = sdata[0]; count--;)
+        {
+            const auto field = sdata[off++];
+            RuntimeInterfaceReflection::RTII& cinfo =
+                info.reflect(field);
+
+            const auto fsize = cinfo.storage(sdata + off);
+            if (field == data[0])
+            {
+                if (args.size() != fsize)
+                {
+                    const auto diff = static_cast<int>(args.size()) - static_cast<int>(fsize);
+                    const auto req = static_cast<std::size_t>(static_cast<int>(size) + diff);
+                    if (req > slot->capacity)
+                        slot = _resize_slot(partition, sort, req);
+                    // The fields behind this one move with its end
+                    auto* fdata = slot->buffer().data() + off + fsize;
+                    std::memmove(
+                        fdata + diff,
+                        fdata,
+                        size - (off + fsize)
+                    );
+                    slot->size = req;
+                }
+                std::memcpy(
+                    slot->buffer().data() + off,
+                    args.data().data(),
+                    args.size()
+                );
+                return slot;
+            }
+            off += fsize;
+        }
+
+        // Fields that were never written are appended
+        const auto req = size + data.size();
+        if (req > slot->capacity)
+            slot = _resize_slot(partition, sort, req);
+        slot->size = req;
+        std::memcpy(
+            slot->buffer().data() + size,
+            data.data(),
+            data.size()
+        );
+        slot->buffer()[0]++;
+        return slot;
+    }
     void MemoryCache::_write_impl(write_store::iterator partition, WriteType type, const View& sort, std::span<const unsigned char> data) noexcept
     {
+        if (_page_cache != nullptr)
+            _page_cache->invalidate(_schema, partition->first);
         if (type == WriteType::Table)
         {
             auto& info =
@@ -1196,7 +1837,6 @@ namespace rdb
                 info.prefix(data.data(), View::view(prefix));
             }
             _create_slot(partition, prefix, DataType::SchemaInstance, data);
-            _push_bytes(data.size() + prefix.size() + sizeof(key_type));
 
             return;
         }
@@ -1206,8 +1846,9 @@ namespace rdb
         {
             if (type == WriteType::Field)
             {
-                _create_slot(partition, sort, DataType::FieldSequence, data);
-                _push_bytes(data.size() + sort.size() + sizeof(key_type));
+                slot = _create_slot(partition, sort, DataType::FieldSequence, data.size() + 1);
+                slot->buffer()[0] = 1;
+                std::memcpy(slot->buffer().data() + 1, data.data(), data.size());
             }
             else if (type == WriteType::WProc)
             {
@@ -1218,7 +1859,7 @@ namespace rdb
                 if (!read(partition->first, sort, fields,
                           [&](std::size_t, View value)
             {
-                result = std::move(value);
+                result = View::copy(value.data());
                 })
                    ) return;
 
@@ -1231,98 +1872,28 @@ namespace rdb
                 const auto args = View::view(data.subspan(2));
                 const auto op = data[1];
                 const auto type = finfo.wproc(sdata, op, args, wproc_query::Type);
-                if (type == wproc_type::Dynamic)
-                {
-                    const auto size = finfo.wproc(sdata, op, args, wproc_query::Storage);
-                    if (size > slot->size)
-                        slot = _create_slot(partition, sort, DataType::FieldSequence, size + 1);
-                }
-                else
-                    slot = _create_slot(partition, sort, DataType::FieldSequence, result.size() + 1);
-
-                slot->buffer()[0] = data[0];
-                std::memcpy(slot->buffer().data() + 1, result.data().data(), result.size());
-                finfo.wproc(slot->buffer().data() + 1, op, args, wproc_query::Commit);
-
-                _push_bytes(result.size() + sort.size() + sizeof(key_type));
+                const auto size = type == wproc_type::Dynamic ?
+                    std::max<std::size_t>(finfo.wproc(sdata, op, args, wproc_query::Storage), result.size()) :
+                    result.size();
+
+                slot = _create_slot(partition, sort, DataType::FieldSequence, size + 2);
+                slot->buffer()[0] = 1;
+                slot->buffer()[1] = data[0];
+                std::memcpy(slot->buffer().data() + 2, result.data().data(), result.size());
+                finfo.wproc(slot->buffer().data() + 2, op, args, wproc_query::Commit);
+                slot->size = 2 + finfo.storage(slot->buffer().data() + 2);
             }
         }
         else if (type == WriteType::Field)
         {
-            auto& info =
-                _info();
-
-            if (slot->vtype == DataType::SchemaInstance)
+            if (slot->vtype == DataType::Tombstone)
             {
-                auto state = FieldWriteApplyState
-                {
-                    .size = slot->size,
-                    .capacity = slot->capacity
-                };
-                const auto psize = static_cast<int>(slot->capacity);
-                const auto size = info.fwapply(
-                                      slot->buffer().data(),
-                                      data[0], View::view(data.subspan(1)),
-                                      state
-                                  );
-                if (size > slot->capacity)
-                {
-                    slot = _resize_slot(partition, sort, size);
-                    state.capacity = size;
-                    info.fwapply(
-                        slot->buffer().data() + 1,
-                        data[0], View::view(data.subspan(1)),
-                        state
-                    );
-                }
-                slot->size = size;
-                _push_bytes(static_cast<int>(slot->capacity) - psize);
+                slot = _create_slot(partition, sort, DataType::FieldSequence, data.size() + 1);
+                slot->buffer()[0] = 1;
+                std::memcpy(slot->buffer().data() + 1, data.data(), data.size());
             }
             else
-            {
-                RuntimeInterfaceReflection::RTII& finfo =
-                    info.reflect(data[0]);
-
-                auto* sdata = slot->buffer().data();
-                for (std::size_t off = 0; off != slot->size;)
-                {
-                    const auto field = sdata[off++];
-                    RuntimeInterfaceReflection::RTII& cinfo =
-                        info.reflect(field);
-
-                    const auto fsize = cinfo.storage(sdata + off);
-                    if (field == data[0])
-                    {
-                        const auto args = View::view(data.subspan(1));
-                        const auto psize = static_cast<int>(slot->capacity);
-                        auto req = slot->size;
-                        if (args.size() != fsize)
-                        {
-                            const auto diff = static_cast<int>(args.size()) - static_cast<int>(fsize);
-                            req = static_cast<std::size_t>(psize + diff);
-                            if (req > slot->capacity)
-                                slot = _resize_slot(partition, sort, req);
-                            auto* src = slot->buffer().data() + off;
-                            auto* fdata = src + fsize;
-                            const auto back = slot->size - (src - reinterpret_cast<unsigned char*>(this));
-                            std::memmove(
-                                fdata + diff,
-                                fdata,
-                                back
-                            );
-                        }
-                        std::memcpy(
-                            slot->buffer().data() + off,
-                            args.data().data(),
-                            args.size()
-                        );
-                        slot->size = req;
-                        _push_bytes(static_cast<int>(slot->capacity) - static_cast<int>(psize));
-                        break;
-                    }
-                    off += fsize;
-                }
-            }
+                _write_field_impl(partition, sort, slot, data);
         }
         else if (type == WriteType::WProc)
         {
@@ -1353,7 +1924,6 @@ namespace rdb
                     const auto op = data[1];
                     const auto args = View::view(data.subspan(2));
                     const auto size = info.wpapply(ptr, field, op, args, state);
-                    const auto psize = static_cast<int>(slot->capacity);
                     if (size > slot->capacity)
                     {
                         slot = _resize_slot(partition, sort, size);
@@ -1361,12 +1931,12 @@ namespace rdb
                         info.wpapply(slot->buffer().data(), field, op, args, state);
                     }
                     slot->size = size;
-                    _push_bytes(static_cast<int>(slot->capacity) - psize);
                 }
                 else if (slot->vtype == DataType::FieldSequence)
                 {
                     auto* sdata = slot->buffer().data();
-                    for (std::size_t off = 0; off != slot->size;)
+                    std::size_t off = 1;
+                    for (auto count = sdata[0]; count--;)
                     {
                         const auto field = sdata[off++];
                         RuntimeInterfaceReflection::RTII& cinfo =
@@ -1377,27 +1947,23 @@ namespace rdb
                             const auto args = View::view(data.subspan(2));
                             const auto op = data[1];
                             const auto type = finfo.wproc(sdata + off, op, args, wproc_query::Type);
-                            const auto psize = static_cast<int>(slot->capacity);
-                            auto req = slot->size;
+                            const auto size = slot->size;
+                            auto req = size;
                             if (type == wproc_type::Dynamic)
                             {
-                                const auto size = finfo.wproc(sdata + off, op, args, wproc_query::Storage);
-                                const auto diff = static_cast<int>(size) - static_cast<int>(fsize);
-                                req = static_cast<std::size_t>(psize + diff);
+                                const auto diff = static_cast<int>(finfo.wproc(sdata + off, op, args, wproc_query::Storage)) - static_cast<int>(fsize);
+                                req = static_cast<std::size_t>(static_cast<int>(size) + diff);
                                 if (req > slot->capacity)
                                     slot = _resize_slot(partition, sort, req);
-                                auto* src = slot->buffer().data() + off;
-                                auto* fdata = src + fsize;
-                                const auto back = slot->size - (src - reinterpret_cast<unsigned char*>(this));
+                                auto* fdata = slot->buffer().data() + off + fsize;
                                 std::memmove(
                                     fdata + diff,
                                     fdata,
-                                    back
+                                    size - (off + fsize)
                                 );
                             }
                             finfo.wproc(slot->buffer().data() + off, op, args, wproc_query::Commit);
                             slot->size = req;
-                            _push_bytes(static_cast<int>(slot->capacity) - static_cast<int>(psize));
                             break;
                         }
                         off += fsize;
@@ -1408,14 +1974,16 @@ namespace rdb
     }
     void MemoryCache::_reset_impl(write_store::iterator partition, const View& sort) noexcept
     {
+        if (_page_cache != nullptr)
+            _page_cache->invalidate(_schema, partition->first);
         auto& schema = _info();
         auto* slot = _create_slot(partition, sort, DataType::SchemaInstance, schema.cstorage(sort));
         schema.construct(slot->buffer().data(), sort);
-        _pressure += slot->size + sizeof(key_type) + 16;
     }
     void MemoryCache::_remove_impl(write_store::iterator partition, const View& sort) noexcept
     {
-        _pressure += sizeof(key_type) + 24;
+        if (_page_cache != nullptr)
+            _page_cache->invalidate(_schema, partition->first);
         _create_slot(partition, View::view(sort), DataType::Tombstone, 0);
     }
 
@@ -1427,10 +1995,14 @@ namespace rdb
             RDB_LOG(mem, "C", _id, " Locked <", _id, uuid::encode(key, uuid::table_alnum), ">")
             return;
         }
-        auto& schema = _info();
-        const auto part = _create_partition_log_if(*_map, key, partition);
+        _stall_update();
+        // The log is appended outside of the map lock, concurrent readers only wait for the mutation
+        _log_partition_if(*_map, key, partition);
         _disk_logs.log(type, key, sort, View::view(data));
-        _write_impl(part, type, sort, data);
+        {
+            const auto lock = _map_exclusive();
+            _write_impl(_create_partition_if(*_map, key, partition), type, sort, data);
+        }
         _flush_if();
     }
     void MemoryCache::reset(key_type key, const View& partition, const View& sort, Origin origin) noexcept
@@ -1441,12 +2013,16 @@ namespace rdb
             RDB_LOG(mem, "C", _id, " Locked <", uuid::encode(key, uuid::table_alnum), ">")
             return;
         }
-        const auto part = _create_partition_log_if(*_map, key, partition);
+        _stall_update();
+        _log_partition_if(*_map, key, partition);
         _disk_logs.log(WriteType::Reset, key, sort);
-        _reset_impl(part, sort);
+        {
+            const auto lock = _map_exclusive();
+            _reset_impl(_create_partition_if(*_map, key, partition), sort);
+        }
         _flush_if();
     }
-    void MemoryCache::remove(key_type key, const View& sort, Origin origin) noexcept
+    void MemoryCache::remove(key_type key, const View& partition, const View& sort, Origin origin) noexcept
     {
         RDB_TRACE(mem, "C", _id, " Remove <", uuid::encode(key, uuid::table_alnum), ">")
         [[ unlikely ]] if (is_locked(key, sort, origin))
@@ -1454,11 +2030,14 @@ namespace rdb
             RDB_LOG(mem, "C", _id, " Locked <", uuid::encode(key, uuid::table_alnum), ">")
             return;
         }
+        _stall_update();
+        // The partition record has to precede the tombstone, replay drops records of missing partitions
+        _log_partition_if(*_map, key, partition);
         _disk_logs.log(WriteType::Remov, key, sort);
-        _remove_impl(
-            _create_partition_log_if(*_map, key, sort),
-            sort
-        );
+        {
+            const auto lock = _map_exclusive();
+            _remove_impl(_create_partition_if(*_map, key, partition), sort);
+        }
         _flush_if();
     }
 
@@ -1556,6 +2135,10 @@ namespace rdb
 
     bool MemoryCache::_bloom_may_contain(key_type key, FlushHandle& handle) const noexcept
     {
+        // No partition filter was written
+        if (handle.bloom.memory().empty() ||
+            !(handle.bloom.memory()[0] & BloomType::PK_SK))
+            return true;
         return _bloom_may_contain(key, sizeof(std::uint8_t), handle);
     }
     bool MemoryCache::_bloom_may_contain(key_type key, std::size_t off, FlushHandle& handle) const noexcept
@@ -1565,8 +2148,15 @@ namespace rdb
         const auto prob = byte::sread<std::uint16_t>(bloom.memory(), off) / 10'000.f;
         const auto size = byte::sread<std::uint32_t>(bloom.memory(), off);
         const auto bits = _bloom_bits(size, prob);
-        const auto hashes = _bloom_hashes(bits, size);
 
+        // The layout is shared by every filter in the file
+        if (bloom.memory()[0] & BloomType::Blocked)
+        {
+            off = (off + bloom_block_size - 1) & ~(bloom_block_size - 1);
+            return _bloom_blocked_may_contain(key, bloom.memory().data() + off, _bloom_blocks(bits));
+        }
+
+        const auto hashes = _bloom_hashes(bits, size);
         const auto* buffer = bloom.memory().data() + off;
         const auto [ k1, k2 ] = _hash_pair(key);
         for (std::size_t i = 0; i < hashes; i++)
@@ -1581,12 +2171,34 @@ namespace rdb
 
         return true;
     }
-    std::size_t MemoryCache::_bloom_bits(std::size_t keys, float probability) const noexcept
+    bool MemoryCache::_bloom_blocked_may_contain(key_type key, const unsigned char* buffer, std::size_t blocks) const noexcept
     {
-        const float nkeys = keys;
-        const float l2 = std::log(2.f);
-        return static_cast<std::size_t>((-nkeys * std::log(probability)) / (l2 * l2));
-    }
+        const auto [ k1, k2 ] = _hash_pair(key);
+        const auto* block = buffer + (k1 % blocks) * bloom_block_size;
+        const auto hash = static_cast<std::uint32_t>(k2);
+#       ifdef __AVX2__
+        const auto salt = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bloom_salt));
+        const auto shift = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(hash), salt), 27);
+        const auto mask = _mm256_sllv_epi32(_mm256_set1_epi32(1), shift);
+        const auto data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+        return _mm256_testc_si256(data, mask);
+#       else
+        for (std::size_t i = 0; i < std::size(bloom_salt); i++)
+        {
+            std::uint32_t lane;
+            std::memcpy(&lane, block + i * sizeof(lane), sizeof(lane));
+            if (!(lane & (std::uint32_t(1) << ((hash * bloom_salt[i]) >> 27))))
+                return false;
+        }
+        return true;
+#       endif
+    }
+    std::size_t MemoryCache::_bloom_bits(std::size_t keys, float probability) const noexcept
+    {
+        const float nkeys = keys;
+        const float l2 = std::log(2.f);
+        return static_cast<std::size_t>((-nkeys * std::log(probability)) / (l2 * l2));
+    }
     std::size_t MemoryCache::_bloom_hashes(std::size_t bits, std::size_t keys) const noexcept
     {
         const float nbits = bits;
@@ -1598,6 +2210,10 @@ namespace rdb
                    )
                );
     }
+    std::size_t MemoryCache::_bloom_blocks(std::size_t bits) const noexcept
+    {
+        return std::max<std::size_t>(1, (bits + bloom_block_size * 8 - 1) / (bloom_block_size * 8));
+    }
     std::pair<key_type, key_type> MemoryCache::_hash_pair(key_type key) const noexcept
     {
         return
@@ -1620,79 +2236,686 @@ namespace rdb
                 std::uint8_t(1) << rem;
         }
     }
-    void MemoryCache::_bloom_impl(const write_store& map, Mapper& bloom, int id) noexcept
+    void MemoryCache::_bloom_blocked_round_impl(key_type key, unsigned char* buffer, std::size_t blocks) noexcept
     {
-        // [ uint8(flag,type) | [ uint32(key-count) | uint16[probability as 1/100 of percentage] | ... ] ... ]
+        // Split block filter, one block is chosen by the first hash and the second one sets a bit in every lane
+        const auto [ k1, k2 ] = _hash_pair(key);
+        auto* block = buffer + (k1 % blocks) * bloom_block_size;
+        const auto hash = static_cast<std::uint32_t>(k2);
+        for (std::size_t i = 0; i < std::size(bloom_salt); i++)
+        {
+            std::uint32_t lane;
+            std::memcpy(&lane, block + i * sizeof(lane), sizeof(lane));
+            lane |= std::uint32_t(1) << ((hash * bloom_salt[i]) >> 27);
+            std::memcpy(block + i * sizeof(lane), &lane, sizeof(lane));
+        }
+    }
+    void MemoryCache::_bloom_align_impl(Mapper& bloom) noexcept
+    {
+        // Blocks never straddle a cache line (the mapping itself is page aligned)
+        const auto size = bloom.size();
+        bloom.vmap_increment(((size + bloom_block_size - 1) & ~(bloom_block_size - 1)) - size);
+    }
+    std::span<unsigned char> MemoryCache::_bloom_impl(std::size_t keys, Mapper& bloom, int id) noexcept
+    {
+        // [ uint8(flag,type) | [ uint16[probability as 1/100 of percentage] | uint32(key-count) | pad | blocks ] ... ]
+        // The type is always written, the partition filter only if enabled (PK_SK)
+        // The blocked layout applies to every filter in the file
+
+        bloom.vmap();
+        bloom.hint(Mapper::Access::Random);
+        bloom.hint(Mapper::Access::Hot);
 
         if (_shared.cfg->cache.partition_bloom_fp_rate == 1.f)
-            return;
+        {
+            bloom.vmap_increment(byte::swrite<std::uint8_t>(bloom.append(), BloomType::Blocked));
+            return {};
+        }
 
         const auto prob = _shared.cfg->cache.partition_bloom_fp_rate;
         const auto prob_conv = static_cast<std::uint16_t>(prob * 10'000);
-        const auto bits = _bloom_bits(map.size(), prob);
+        const auto blocks = _bloom_blocks(_bloom_bits(keys, prob));
 
-        RDB_LOG(mem, "C", _id, " F", id, " Writing bloom ", bits, "bits")
+        RDB_LOG(mem, "C", _id, " F", id, " Writing bloom ", blocks, " blocks")
 
-        bloom.vmap();
-        bloom.hint(Mapper::Access::Random);
-        bloom.hint(Mapper::Access::Hot);
-
-        bloom.vmap_increment(byte::swrite<std::uint8_t>(bloom.append(), BloomType::PK_SK));
+        bloom.vmap_increment(byte::swrite<std::uint8_t>(bloom.append(), BloomType::PK_SK | BloomType::Blocked));
         bloom.vmap_increment(byte::swrite<std::uint16_t>(bloom.append(), prob_conv));
-        bloom.vmap_increment(byte::swrite<std::uint32_t>(bloom.append(), map.size()));
-        const auto buffer = bloom.append();
-        for (decltype(auto) key : map)
-            _bloom_round_impl(key.first, buffer, map.size(), bits);
-        bloom.vmap_increment((bits + 7) / 8);
+        bloom.vmap_increment(byte::swrite<std::uint32_t>(bloom.append(), keys));
+        _bloom_align_impl(bloom);
+
+        // Only reserved here, the keys are added as they are written
+        const auto filter = std::span(bloom.append(), blocks * bloom_block_size);
+        bloom.vmap_increment(filter.size());
+        return filter;
     }
 
-    std::size_t MemoryCache::_bloom_intra_partition_begin_impl(write_store::const_iterator part, Mapper& bloom, int id) noexcept
+    std::size_t MemoryCache::_bloom_intra_partition_begin_impl(std::size_t size, Mapper& bloom, int id) noexcept
     {
         if (_shared.cfg->cache.intra_partition_bloom_fp_rate == 1.f)
             return 0;
 
-        const auto size = std::get<partition>(part->second.second).size();
         const auto prob = _shared.cfg->cache.intra_partition_bloom_fp_rate;
         const auto prob_conv = static_cast<std::uint16_t>(prob * 10'000);
         const auto bits = _bloom_bits(size, prob);
 
-        RDB_LOG(mem, "C", _id, " F", id, " Writing partition bloom ", bits, "bits")
+        RDB_LOG(mem, "C", _id, " F", id, " Writing partition bloom ", _bloom_blocks(bits), " blocks")
 
         bloom.vmap_increment(byte::swrite<std::uint16_t>(bloom.append(), prob_conv));
         bloom.vmap_increment(byte::swrite<std::uint32_t>(bloom.append(), size));
+        _bloom_align_impl(bloom);
 
         return bits;
     }
-    void MemoryCache::_bloom_intra_partition_round_impl(write_store::const_iterator part, const View& key, std::size_t bits, Mapper& bloom, int id) noexcept
+    void MemoryCache::_bloom_intra_partition_round_impl(const View& key, std::size_t bits, Mapper& bloom) noexcept
     {
         if (!bits)
             return;
-        _bloom_round_impl(
+        _bloom_blocked_round_impl(
             uuid::xxhash(key),
             bloom.append(),
-            std::get<partition>(part->second.second).size(),
-            bits
+            _bloom_blocks(bits)
         );
     }
-    void MemoryCache::_bloom_intra_partition_end_impl(write_store::const_iterator partition, std::size_t bits, Mapper& bloom, int id) noexcept
+    void MemoryCache::_bloom_intra_partition_end_impl(std::size_t bits, Mapper& bloom, int id) noexcept
     {
         if (_shared.cfg->cache.intra_partition_bloom_fp_rate == 1.f)
             return;
-        bloom.vmap_increment((bits + 7) / 8);
-        RDB_LOG(mem, "C", _id, " F", id, " Bloom written ", (bits + 7) / 8, "b")
+        const auto size = _bloom_blocks(bits) * bloom_block_size;
+        bloom.vmap_increment(size);
+        RDB_LOG(mem, "C", _id, " F", id, " Bloom written ", size, "b")
+    }
+
+    // Partitions are handed over in key order, and so are the entries of a wide partition
+    // Blocks are assembled here and compressed by the flush workers, the writing thread then writes every item in order
+    // Data offsets are only known once an item is written, so the indices referring to items are patched by close
+    // Refer to the disk layout in _data_impl
+    class MemoryCache::FlushWriter
+    {
+    private:
+        static constexpr auto partition_header_size = sizeof(std::uint64_t) * 4 + sizeof(std::uint32_t) * 2 + sizeof(key_type);
+
+        static thread_local std::vector<std::unique_ptr<FlushItem>> _item_storage;
+        static thread_local std::vector<FlushItem*> _item_pool;
+
+        MemoryCache& _cache;
+        Shared& _shared;
+        const int _flush;
+        const bool _sorted;
+        const bool _dynamic;
+
+        Mapper _data{};
+        Mapper _indexer{};
+        Mapper _bloom{};
+        Mapper _keys{};
+        Mapper _lock{};
+        // Partition filter, reserved for the announced key count
+        std::span<unsigned char> _filter{};
+        std::size_t _key_count{ 0 };
+        key_type _max_key{ 0 };
+        std::size_t _primary_index_off{ 0 };
+        std::size_t _primary_index_count{ 0 };
+
+        std::deque<FlushItem*> _items{};
+        // Absolute data offset of every written item
+        std::vector<std::uint64_t> _item_offsets{};
+        // Indexer offset | item whose data offset is written there
+        std::vector<std::pair<std::size_t, std::size_t>> _item_fixups{};
+        std::size_t _submitted{ 0 };
+        std::size_t _window{ 0 };
+        // Written partition
+        std::size_t _partition_offset{ 0 };
+
+        std::size_t _value_index_offset{ 0 };
+        std::size_t _blocks{ 0 };
+        std::size_t _partitions{ 0 };
+        // Entries of the current partition (every unary partition shares a single one)
+        std::size_t _entries{ 0 };
+
+        // Partition data
+
+        bool _partition_open{ false };
+        key_type _partition_key{ 0 };
+        std::size_t _block_index_offset{ 0 };
+        std::size_t _partition_starting_block{ 0 };
+        std::size_t _partition_item{ 0 };
+        std::size_t _partition_size{ 0 };
+        std::size_t _partition_keys{ 0 };
+        std::size_t _bloom_offset{ 0 };
+        std::size_t _bloom_bits{ 0 };
+        key_type _block_key{ 0 };
+
+        // Entries handed over for copying live until their block is assembled, index keys until their partition is written
+        bool _copy{ false };
+        ct::Arena _block_arena{};
+        ct::Arena _partition_arena{};
+
+        // For unary partitions
+
+        std::vector<std::pair<key_type, std::uint64_t>> _indices{};
+
+        // For wide partitions
+
+        // Static (the block indices refer to items)
+
+        std::vector<std::pair<std::span<const unsigned char>, std::uint64_t>> _sort_block_indices{};
+        std::vector<std::pair<std::span<const unsigned char>, std::uint32_t>> _sort_indices{};
+
+        // Dynamic
+
+        std::size_t _sort_keyspace_size{ 0 };
+        std::size_t _sort_keyspace_offset{ 0 };
+        std::vector<std::span<const unsigned char>> _sort_keyspace{};
+        std::vector<std::pair<std::uint32_t, std::uint64_t>> _sort_block_dynamic_indices{};
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> _sort_dynamic_indices{};
+
+        BlockSourceMultiplexer _source;
+
+        static std::span<unsigned char> _block_pool(std::size_t block_size) noexcept;
+        static std::span<BlockSourceMultiplexer::Node> _frag_pool() noexcept;
+
+        std::span<const unsigned char> _keep(std::span<const unsigned char> data) noexcept;
+        void _key(key_type key) noexcept;
+        void _write_item() noexcept;
+        FlushItem* _acquire(FlushItem::Type type) noexcept;
+        void _submit(FlushItem* item) noexcept;
+        void _index(key_type key, std::size_t item) noexcept;
+        void _index_block(FlushItem* end) noexcept;
+        void _index_value() noexcept;
+        void _write_block() noexcept;
+        void _start_partition(key_type key) noexcept;
+        void _write_partition(FlushItem* end) noexcept;
+        void _write_sorted(std::span<const unsigned char> sort, BlockSourceMultiplexer::Node node, std::size_t size) noexcept;
+        void _write_unary(key_type key) noexcept;
+    public:
+        // The key count only has to bound the keys written, it sizes the filters and the primary index
+        FlushWriter(MemoryCache& cache, const std::filesystem::path& path, int flush, std::size_t keys) noexcept;
+        FlushWriter(const FlushWriter&) = delete;
+        ~FlushWriter();
+
+        // Wide partitions, the entry count only has to bound the entries written
+        void begin(key_type key, std::span<const unsigned char> pkey, std::size_t entries, bool copy) noexcept;
+        void write(std::span<const unsigned char> sort, const Slot* slot) noexcept;
+        // Entries read back from a flush are already encoded, they are always copied
+        void write_raw(std::span<const unsigned char> sort, std::span<const unsigned char> entry) noexcept;
+        void end() noexcept;
+
+        // Unary partitions
+        void write(key_type key, std::span<const unsigned char> pkey, const Slot* slot, bool copy) noexcept;
+        void write_raw(key_type key, std::span<const unsigned char> entry) noexcept;
+
+        // Writes the indices and removes the lock, a writer that is never closed leaves its lock behind
+        void close() noexcept;
+    };
+
+    thread_local std::vector<std::unique_ptr<MemoryCache::FlushItem>> MemoryCache::FlushWriter::_item_storage{};
+    thread_local std::vector<MemoryCache::FlushItem*> MemoryCache::FlushWriter::_item_pool{};
+
+    MemoryCache::FlushWriter::FlushWriter(MemoryCache& cache, const std::filesystem::path& path, int flush, std::size_t keys) noexcept :
+        _cache(cache),
+        _shared(cache._shared),
+        _flush(flush),
+        _sorted(cache._info().skeys()),
+        _dynamic(!cache._info().static_prefix()),
+        _window(std::max<std::size_t>(1, cache._flush_workers.size()) * 4),
+        _source(_block_pool(cache._shared.cfg->cache.block_size), _frag_pool())
+    {
+        auto& cfg = _shared.cfg->cache;
+        std::filesystem::create_directory(path);
+
+        _data.open(path/"data.dat");
+        _indexer.open(path/"indexer.idx");
+        _bloom.open(path/"filter.blx");
+        _keys.open(path/"keys.idx");
+        _lock.open(path/"lock");
+
+        RDB_LOG(mem, "C", _cache._id, " F", _flush, " Begin data write")
+        RDB_LOG(mem, "C", _cache._id, " F", _flush, " Begin indexer write ", keys, " partitions")
+
+        // The partition filter is reserved ahead of the intra-partition filters appended by the data
+        _filter = _cache._bloom_impl(keys, _bloom, _flush);
+
+        // [ uint64(key-count) | key... ], the count is written by close
+        _keys.vmap();
+        _keys.vmap_increment(sizeof(std::uint64_t));
+
+        _indexer.vmap();
+        _data.vmap();
+        _indexer.hint(Mapper::Access::Sequential);
+        _data.hint(Mapper::Access::Sequential);
+        _data.hint(Mapper::Access::Huge);
+
+        // Metadata
+        {
+            RDB_TRACE(mem, "C", _cache._id, " F", _flush, " Writing metadata")
+            _data.vmap_increment(byte::swrite<std::uint64_t>(_data.append(), version));
+            _data.vmap_increment(byte::swrite<std::uint64_t>(_data.append(), cfg.partition_sparse_index_ratio));
+            _data.vmap_increment(byte::swrite<std::uint64_t>(_data.append(), cfg.block_sparse_index_ratio));
+            _data.vmap_increment(byte::swrite<std::uint64_t>(_data.append(), cfg.sort_sparse_index_ratio));
+            _data.vmap_increment(byte::swrite<std::uint64_t>(_data.append(), cfg.block_size));
+        }
+        // Reserve space for primary index
+        {
+            // Wide partitions index every partition_sparse_index_ratio partition, unary partitions every block_sparse_index_ratio block
+            // Every block holds at least one key, so the key count bounds the blocks (the max key and the actual count are written by close)
+            const auto ratio = _sorted ?
+                cfg.partition_sparse_index_ratio :
+                cfg.block_sparse_index_ratio;
+            const auto reserved = (keys + ratio - 1) / ratio;
+            _primary_index_off += sizeof(key_type);
+            _primary_index_off += byte::swrite<std::uint32_t>(_indexer.append() + _primary_index_off, reserved);
+            _indexer.vmap_increment(
+                _primary_index_off + (sizeof(key_type) + sizeof(std::uint64_t)) * reserved
+            );
+        }
     }
-    void MemoryCache::_data_impl(const write_store& map, Mapper& data, Mapper& indexer, Mapper& bloom, int id) noexcept
+    MemoryCache::FlushWriter::~FlushWriter()
     {
-        const auto amortized_block_size = static_cast<std::size_t>(_shared.cfg->cache.block_size * 1.2);
-
-        thread_local std::unique_ptr<BlockSourceMultiplexer::Node[]> frag_pool_data{ new BlockSourceMultiplexer::Node[1024] };
+        // Items of an abandoned writer may still be compressed by the flush workers
+        for (auto* item : _items)
+        {
+            item->done.wait(false, std::memory_order::acquire);
+            _item_pool.push_back(item);
+        }
+    }
+    std::span<unsigned char> MemoryCache::FlushWriter::_block_pool(std::size_t block_size) noexcept
+    {
+        const auto amortized_block_size = static_cast<std::size_t>(block_size * 1.2);
         thread_local std::unique_ptr<unsigned char[]> block_pool_data{ new unsigned char[amortized_block_size] };
-        thread_local std::unique_ptr<unsigned char[]> compressed_block_pool_data{ new unsigned char[amortized_block_size] };
+        return { block_pool_data.get(), amortized_block_size };
+    }
+    std::span<BlockSourceMultiplexer::Node> MemoryCache::FlushWriter::_frag_pool() noexcept
+    {
+        thread_local std::unique_ptr<BlockSourceMultiplexer::Node[]> frag_pool_data{ new BlockSourceMultiplexer::Node[1024] };
+        return { frag_pool_data.get(), 1024 };
+    }
+    std::span<const unsigned char> MemoryCache::FlushWriter::_keep(std::span<const unsigned char> data) noexcept
+    {
+        return _copy ? _partition_arena.copy(data) : data;
+    }
+    void MemoryCache::FlushWriter::_key(key_type key) noexcept
+    {
+        if (!_filter.empty())
+            _cache._bloom_blocked_round_impl(key, _filter.data(), _filter.size() / bloom_block_size);
+        _keys.vmap_increment(byte::swrite<key_type>(_keys.append(), key));
+        _key_count++;
+        _max_key = key;
+    }
+    void MemoryCache::FlushWriter::_write_item() noexcept
+    {
+        // Writes the oldest item once it is ready
+        auto* item = _items.front();
+        _items.pop_front();
+        item->done.wait(false, std::memory_order::acquire);
+        _item_offsets.push_back(_data.size());
+        switch (item->type)
+        {
+        case FlushItem::Type::Block:
+            _data.vmap_increment(byte::swrite(_data.append(), std::span<const unsigned char>(item->output)));
+            break;
+        case FlushItem::Type::PartitionBegin:
+            _partition_offset = _data.size();
+            _data.vmap_increment(partition_header_size - sizeof(key_type));
+            _data.vmap_increment(byte::swrite<key_type>(_data.append(), item->key));
+            break;
+        case FlushItem::Type::PartitionEnd:
+        {
+            const auto partition_end = _data.size();
+            _data.vmap_increment(byte::swrite(_data.append(), std::span<const unsigned char>(item->input)));
+
+            std::size_t off = _partition_offset;
+            off += byte::swrite<std::uint64_t>(_data.memory(), off, partition_end - _partition_offset - partition_header_size);
+            off += byte::swrite<std::uint64_t>(_data.memory(), off, item->size);
+            off += byte::swrite<std::uint64_t>(_data.memory(), off, item->block_index_offset);
+            off += byte::swrite<std::uint64_t>(_data.memory(), off, item->bloom_offset);
+            off += byte::swrite<std::uint32_t>(_data.memory(), off, item->blocks);
+            byte::swrite<std::uint32_t>(_data.memory(), off, item->keys);
+            break;
+        }
+        }
+        _item_pool.push_back(item);
+    }
+    MemoryCache::FlushItem* MemoryCache::FlushWriter::_acquire(FlushItem::Type type) noexcept
+    {
+        if (_item_pool.empty())
+        {
+            _item_storage.push_back(std::make_unique<FlushItem>());
+            _item_pool.push_back(_item_storage.back().get());
+        }
+        auto* item = _item_pool.back();
+        _item_pool.pop_back();
+        item->type = type;
+        item->input.clear();
+        item->min_key.reset();
+        item->done.store(false, std::memory_order::relaxed);
+        return item;
+    }
+    void MemoryCache::FlushWriter::_submit(FlushItem* item) noexcept
+    {
+        // Queues an item behind every other, blocks go to the flush workers (or are compressed here if there are none)
+        auto& workers = _cache._flush_workers;
+        if (item->type != FlushItem::Type::Block)
+            item->done.store(true, std::memory_order::relaxed);
+        else if (workers.empty())
+            _cache._data_compress_impl(*item);
+        else
+            workers[_submitted % workers.size()]->tasks.enqueue(item);
+        _items.push_back(item);
+        _submitted++;
+        while (_items.size() >= _window)
+            _write_item();
+    }
+    void MemoryCache::FlushWriter::_index(key_type key, std::size_t item) noexcept
+    {
+        // Advance the primary indexer (partitions for wide partitions, blocks for unary partitions)
+        _primary_index_off += byte::swrite<key_type>(_indexer.memory(), _primary_index_off, key);
+        _item_fixups.push_back({ _primary_index_off, item });
+        _primary_index_off += sizeof(std::uint64_t);
+        _primary_index_count++;
+    }
+    void MemoryCache::FlushWriter::_index_block(FlushItem* end) noexcept
+    {
+        // Advance the block indexer
+        RDB_TRACE(mem, "C", _cache._id, " F", _flush, " B", _blocks, " Indexing block")
+        _block_index_offset = _indexer.size();
+        if (_dynamic)
+        {
+            _indexer.vmap_increment(byte::swrite<std::uint32_t>(_indexer.append(), _sort_keyspace_size));
+            for (decltype(auto) it : _sort_keyspace)
+            {
+                _indexer.vmap_increment(byte::swrite<std::uint16_t>(_indexer.append(), it.size()));
+                _indexer.vmap_increment(byte::swrite(_indexer.append(), it));
+            }
+            _sort_keyspace.clear();
 
-        thread_local std::span<BlockSourceMultiplexer::Node> frag_pool{ frag_pool_data.get(), 1024 };
-        thread_local std::span<unsigned char> block_pool{ block_pool_data.get(), amortized_block_size };
-        thread_local std::span<unsigned char> compressed_block_pool{ compressed_block_pool_data.get(), amortized_block_size };
+            // Written right after the partition
+            auto& buffer = end->input;
+            buffer.resize(sizeof(std::uint32_t) + _sort_block_dynamic_indices.size() * sizeof(std::uint64_t) * 2);
+            std::size_t off = byte::swrite<std::uint32_t>(buffer.data(), _sort_block_dynamic_indices.size());
+            for (decltype(auto) it : _sort_block_dynamic_indices)
+            {
+                off += byte::swrite<std::uint64_t>(buffer.data() + off, it.first);
+                off += byte::swrite<std::uint64_t>(buffer.data() + off, it.second);
+            }
+            _sort_block_dynamic_indices.clear();
+        }
+        else
+        {
+            _indexer.vmap_increment(byte::swrite<std::uint32_t>(_indexer.append(), _sort_block_indices.size()));
+            for (decltype(auto) it : _sort_block_indices)
+            {
+                _indexer.vmap_increment(byte::swrite(_indexer.append(), it.first));
+                _item_fixups.push_back({ _indexer.size(), it.second });
+                _indexer.vmap_increment(sizeof(std::uint64_t));
+            }
+            _sort_block_indices.clear();
+        }
+    }
+    void MemoryCache::FlushWriter::_index_value() noexcept
+    {
+        // Advance the value indexer (block for unary partitions, sort for wide partitions)
+        RDB_TRACE(mem, "C", _cache._id, " F", _flush, " B", _blocks, " Indexing values")
+        _value_index_offset = _indexer.size();
+        if (!_sorted)
+        {
+            _indexer.vmap_increment(byte::swrite<std::uint32_t>(_indexer.append(), _indices.size()));
+            for (decltype(auto) it : _indices)
+            {
+                _indexer.vmap_increment(byte::swrite<key_type>(_indexer.append(), it.first));
+                _indexer.vmap_increment(byte::swrite<std::uint64_t>(_indexer.append(), it.second));
+            }
+            _indices.clear();
+        }
+        else if (_dynamic)
+        {
+            _indexer.vmap_increment(byte::swrite<std::uint32_t>(_indexer.append(), _sort_dynamic_indices.size()));
+            for (decltype(auto) it : _sort_dynamic_indices)
+            {
+                _indexer.vmap_increment(byte::swrite<std::uint32_t>(_indexer.append(), it.first));
+                _indexer.vmap_increment(byte::swrite<std::uint32_t>(_indexer.append(), it.second));
+            }
+            _sort_dynamic_indices.clear();
+        }
+        else
+        {
+            _indexer.vmap_increment(byte::swrite<std::uint32_t>(_indexer.append(), _sort_indices.size()));
+            for (decltype(auto) it : _sort_indices)
+            {
+                _indexer.vmap_increment(byte::swrite(_indexer.append(), it.first));
+                _indexer.vmap_increment(byte::swrite<std::uint32_t>(_indexer.append(), it.second));
+            }
+            _sort_indices.clear();
+        }
+    }
+    void MemoryCache::FlushWriter::_write_block() noexcept
+    {
+        // Block assembly, the block is stored by _write_item once compressed
+        if (_source.empty())
+            return;
 
+        RDB_TRACE(mem, "C", _cache._id, " F", _flush, " B", _blocks, " Emitting block")
+        RDB_WARN_IF(
+            _source.fragments() >= _frag_pool().size(),
+            mem, "C", _cache._id, " F", _flush, " B", _blocks, " High fragmentation: ", _source.fragments()
+        )
+
+        _source.flush();
+        auto* item = _acquire(FlushItem::Type::Block);
+        const auto block = _source.block();
+        item->input.assign(block.begin(), block.end());
+        item->index = _value_index_offset;
+        if (!_sorted)
+            item->min_key = _block_key;
+        else if (!_dynamic)
+            item->min_key = _value_index_offset;
+        RDB_TRACE(mem, "C", _cache._id, " F", _flush, " Queued B", _blocks, " ", block.size(), "b")
+        _blocks++;
+        _source.clear();
+        _block_arena.release();
+        _submit(item);
+    }
+    void MemoryCache::FlushWriter::_start_partition(key_type key) noexcept
+    {
+        // Reserves a new partition
+        auto* item = _acquire(FlushItem::Type::PartitionBegin);
+        item->key = key;
+        _partition_item = _submitted;
+        _partition_key = key;
+        _partition_open = true;
+        _submit(item);
+        _block_index_offset = 0;
+        _partition_starting_block = _blocks;
+        _partition_size = 0;
+        _partition_keys = 0;
+        _entries = 0;
+    }
+    void MemoryCache::FlushWriter::_write_partition(FlushItem* end) noexcept
+    {
+        // Partition header
+        end->size = _partition_size;
+        end->block_index_offset = _block_index_offset;
+        end->bloom_offset = _bloom_offset;
+        end->blocks = _blocks - _partition_starting_block;
+        end->keys = _partition_keys;
+        _partition_open = false;
+        _submit(end);
+    }
+    void MemoryCache::FlushWriter::_write_sorted(std::span<const unsigned char> sort, BlockSourceMultiplexer::Node node, std::size_t size) noexcept
+    {
+        auto& cfg = _shared.cfg->cache;
+        _partition_keys++;
+        _partition_size += size;
+        _cache._bloom_intra_partition_round_impl(View::view(sort), _bloom_bits, _bloom);
+
+        if (_entries++ % cfg.sort_sparse_index_ratio == 0)
+        {
+            if (_dynamic)
+            {
+                _sort_dynamic_indices.push_back({
+                    _sort_keyspace_offset,
+                    _source.size()
+                });
+                _sort_keyspace.push_back(_keep(sort));
+                _sort_keyspace_offset += sort.size() + sizeof(std::uint16_t);
+            }
+            else
+            {
+                _sort_indices.push_back({
+                    sort,
+                    _source.size()
+                });
+            }
+        }
+        _source.push(node);
+
+        if (_source.size() >= cfg.block_size)
+        {
+            RDB_TRACE(mem, "C", _cache._id, " F", _flush, " B", _blocks, " Pressure reached ", _source.size())
+            if (!_dynamic && !_sort_indices.empty() &&
+                _blocks % cfg.block_sparse_index_ratio == 0)
+            {
+                // The block is the next item
+                _sort_block_indices.push_back({
+                    _keep(_sort_indices[0].first),
+                    _submitted
+                });
+            }
+            _index_value();
+            _write_block();
+        }
+    }
+    void MemoryCache::FlushWriter::_write_unary(key_type key) noexcept
+    {
+        // Every unary partition of a flush shares a single partition, its blocks end with their first key
+        auto& cfg = _shared.cfg->cache;
+        _key(key);
+        if (!_partition_open)
+            _start_partition(key);
+        if (_source.empty())
+        {
+            _block_key = key;
+            if (_blocks % cfg.block_sparse_index_ratio == 0)
+                _index(key, _submitted);
+        }
+        if (_entries++ % cfg.sort_sparse_index_ratio == 0)
+        {
+            _indices.push_back({
+                key,
+                _source.size()
+            });
+        }
+        _partition_keys++;
+    }
+    void MemoryCache::FlushWriter::begin(key_type key, std::span<const unsigned char> pkey, std::size_t entries, bool copy) noexcept
+    {
+        auto& cfg = _shared.cfg->cache;
+        _copy = copy;
+        _key(key);
+
+        _sort_block_indices.reserve(entries / cfg.partition_sparse_index_ratio);
+        _sort_indices.reserve(_sort_block_indices.capacity() / cfg.block_sparse_index_ratio);
+
+        // Reserve partition data and setup partition
+        _source.push({ .data = _keep(pkey) });
+        // Start bloom filter
+        _bloom_offset = _bloom.size();
+        _bloom_bits = _cache._bloom_intra_partition_begin_impl(entries, _bloom, _flush);
+        if (!_bloom_bits)
+            _bloom_offset = 0;
+
+        _start_partition(key);
+    }
+    void MemoryCache::FlushWriter::write(std::span<const unsigned char> sort, const Slot* slot) noexcept
+    {
+        auto buffer = slot->flush_buffer();
+        if (_copy)
+        {
+            sort = _block_arena.copy(sort);
+            buffer = _block_arena.copy(buffer);
+        }
+        if (slot->vtype == DataType::SchemaInstance)
+            _write_sorted(sort, { .data = buffer }, slot->size + sort.size());
+        else
+            _write_sorted(sort, { .key = sort, .data = buffer }, slot->size + sort.size());
+    }
+    void MemoryCache::FlushWriter::write_raw(std::span<const unsigned char> sort, std::span<const unsigned char> entry) noexcept
+    {
+        sort = _block_arena.copy(sort);
+        entry = _block_arena.copy(entry);
+        _write_sorted(sort, { .data = entry }, entry.size());
+    }
+    void MemoryCache::FlushWriter::end() noexcept
+    {
+        // The partition extent covers every block, the remainder included
+        _index_value();
+        _write_block();
+        auto* end = _acquire(FlushItem::Type::PartitionEnd);
+        _index_block(end);
+        _write_partition(end);
+
+        // End bloom filter
+        _cache._bloom_intra_partition_end_impl(_bloom_bits, _bloom, _flush);
+        if (_partitions++ % _shared.cfg->cache.partition_sparse_index_ratio == 0)
+            _index(_partition_key, _partition_item);
+        _partition_arena.release();
+    }
+    void MemoryCache::FlushWriter::write(key_type key, std::span<const unsigned char> pkey, const Slot* slot, bool copy) noexcept
+    {
+        _write_unary(key);
+        auto buffer = slot->flush_buffer();
+        if (copy)
+        {
+            pkey = _block_arena.copy(pkey);
+            buffer = _block_arena.copy(buffer);
+        }
+        _source.push({ .data = pkey });
+        _source.push({ .data = _block_arena.copy(byte::tspan(key)) });
+        _source.push({ .data = buffer });
+        if (_source.size() >= _shared.cfg->cache.block_size)
+        {
+            _index_value();
+            _write_block();
+        }
+    }
+    void MemoryCache::FlushWriter::write_raw(key_type key, std::span<const unsigned char> entry) noexcept
+    {
+        _write_unary(key);
+        _source.push({ .data = _block_arena.copy(entry) });
+        if (_source.size() >= _shared.cfg->cache.block_size)
+        {
+            _index_value();
+            _write_block();
+        }
+    }
+    void MemoryCache::FlushWriter::close() noexcept
+    {
+        if (!_sorted && _partition_open)
+        {
+            _index_value();
+            _write_block();
+            _write_partition(_acquire(FlushItem::Type::PartitionEnd));
+        }
+        while (!_items.empty())
+            _write_item();
+        for (const auto [ off, item ] : _item_fixups)
+            byte::swrite<std::uint64_t>(_indexer.memory(), off, _item_offsets[item]);
+        byte::swrite<key_type>(_indexer.memory(), 0, _max_key);
+        byte::swrite<std::uint32_t>(_indexer.memory(), sizeof(key_type), _primary_index_count);
+        byte::swrite<std::uint64_t>(_keys.memory(), 0, _key_count);
+
+        RDB_LOG(mem, "C", _cache._id, " F", _flush, " Key list written ", _key_count, " keys")
+        RDB_LOG(mem, "C", _cache._id, " F", _flush, " Commit bloom ", _bloom.size(), "b")
+        RDB_LOG(mem, "C", _cache._id, " F", _flush, " Commit indexer ", _indexer.size(), "b")
+        RDB_LOG(mem, "C", _cache._id, " F", _flush, " Commit data ", _data.size(), "b")
+
+        _cache._data_close_impl(_data);
+        _cache._indexer_close_impl(_indexer);
+        _cache._bloom_close_impl(_bloom);
+        _cache._segment_index_close_impl(_keys);
+        _lock.remove();
+    }
+
+    void MemoryCache::_data_impl(const write_store& map, FlushWriter& writer, int id) noexcept
+    {
         // Indexer layout
         // Unary Partition
         // one for finding the correct partition
@@ -1813,19 +3036,7 @@ namespace rdb
         // [ byte ] - type
         // [ ...  ] - data
 
-        RDB_LOG(mem, "C", _id, " F", id, " Begin data write")
-        RDB_LOG(mem, "C", _id, " F", id, " Begin indexer write ", map.size(), " partitions")
-
         auto& info = _info();
-        const auto sorted = info.skeys();
-        const auto dynamic = !info.static_prefix();
-        constexpr auto partition_header_size = sizeof(std::uint64_t) * 4 + sizeof(std::uint32_t) * 2 + sizeof(key_type);
-
-        indexer.vmap();
-        data.vmap();
-        indexer.hint(Mapper::Access::Sequential);
-        data.hint(Mapper::Access::Sequential);
-        data.hint(Mapper::Access::Huge);
 
         // Sort keys
         std::vector<key_type> keys{};
@@ -1835,399 +3046,632 @@ namespace rdb
             std::transform(map.begin(), map.end(), keys.begin(), [](const auto& it) { return it.first; });
             std::sort(keys.begin(), keys.end());
         }
-        // Metadata
+        // The memtable outlives the writer, its entries are not copied
+        if (info.skeys())
         {
-            RDB_TRACE(mem, "C", _id, " F", id, " Writing metadata")
-            data.vmap_increment(byte::swrite<std::uint64_t>(data.append(), version));
-            data.vmap_increment(byte::swrite<std::uint64_t>(data.append(), _shared.cfg->cache.partition_sparse_index_ratio));
-            data.vmap_increment(byte::swrite<std::uint64_t>(data.append(), _shared.cfg->cache.block_sparse_index_ratio));
-            data.vmap_increment(byte::swrite<std::uint64_t>(data.append(), _shared.cfg->cache.sort_sparse_index_ratio));
-            data.vmap_increment(byte::swrite<std::uint64_t>(data.append(), _shared.cfg->cache.block_size));
+            for (const auto key : keys)
+            {
+                const auto& [ pkey, pdata ] = map.at(key);
+                const auto& part = std::get<partition>(pdata);
+                writer.begin(key, pkey.data(), part.size(), false);
+                part.foreach([&](partition::const_key sort, const Slot* value) {
+                    writer.write(sort, value);
+                    return true;
+                });
+                writer.end();
+            }
         }
-        // Reserve space for primary index
-        std::size_t primary_index_off = 0;
+        else
         {
-            primary_index_off += byte::swrite<key_type>(indexer.append() + primary_index_off, keys.back());
-            primary_index_off += byte::swrite<std::uint32_t>(indexer.append() + primary_index_off, map.size());
-            indexer.vmap_increment(
-                primary_index_off + std::min<std::size_t>((sizeof(key_type) + sizeof(std::uint64_t)) *
-                    _map->size() / _shared.cfg->cache.block_sparse_index_ratio, 1)
-            );
+            for (const auto key : keys)
+            {
+                const auto& [ pkey, pdata ] = map.at(key);
+                writer.write(key, pkey.data(), std::get<single_slot>(pdata).get(), false);
+            }
         }
-        // Stream blocks
-        {
-            std::size_t value_index_offset = 0;
-            std::size_t blocks = 0;
-            std::size_t idx = 0;
+    }
 
-            // Partition data
+    void MemoryCache::_data_compress_impl(FlushItem& item) noexcept
+    {
+        // Refer to the block layout in _data_impl
+        constexpr auto header_size = sizeof(std::uint16_t) * 2 + sizeof(std::uint64_t) * 2 + sizeof(std::uint32_t) * 2;
+        const auto psize = item.input.size();
+        auto& output = item.output;
+        output.resize(header_size + snappy::MaxCompressedLength(psize) + sizeof(std::uint64_t));
 
-            std::size_t block_index_offset = 0;
-            std::size_t partition_starting_block = 0;
-            std::size_t partition_offset = 0;
-            std::size_t partition_size = 0;
-            std::size_t partition_keys = 0;
-            std::size_t bloom_offset = 0;
-            std::size_t bloom_bits = 0;
+        auto* stored = output.data() + header_size;
+        std::size_t ssize = 0;
+        snappy::RawCompress(
+            reinterpret_cast<const char*>(item.input.data()), psize,
+            reinterpret_cast<char*>(stored), &ssize
+        );
+        if (float(ssize) / psize >= _shared.cfg->cache.compression_ratio)
+        {
+            std::memcpy(stored, item.input.data(), psize);
+            ssize = psize;
+        }
 
-            // For unary partitions
+        // Checksum of the data as stored, so that it can be verified without decompressing
+        std::size_t off = 0;
+        off += byte::swrite<std::uint16_t>(output.data() + off, 0);
+        off += byte::swrite<std::uint16_t>(output.data() + off, BlockFlags::Checksummed);
+        off += byte::swrite<std::uint64_t>(output.data() + off, xxh::xxhash3<64>(stored, ssize));
+        off += byte::swrite<std::uint64_t>(output.data() + off, item.index);
+        off += byte::swrite<std::uint32_t>(output.data() + off, psize);
+        off += byte::swrite<std::uint32_t>(output.data() + off, ssize);
+        off += ssize;
+        if (item.min_key.has_value())
+            off += byte::swrite<std::uint64_t>(output.data() + off, *item.min_key);
+        output.resize(off);
+
+        item.done.store(true, std::memory_order::release);
+        item.done.notify_one();
+    }
+    void MemoryCache::_data_close_impl(Mapper& data) noexcept
+    {
+        data.vmap_flush();
+        data.close();
+    }
+    void MemoryCache::_indexer_close_impl(Mapper& indexer) noexcept
+    {
+        indexer.vmap_flush();
+        indexer.close();
+    }
+    void MemoryCache::_bloom_close_impl(Mapper& bloom) noexcept
+    {
+        bloom.vmap_flush();
+        bloom.close();
+    }
+    void MemoryCache::_segment_index_close_impl(Mapper& keys) noexcept
+    {
+        keys.vmap_flush();
+        keys.close();
+    }
 
-            std::vector<std::pair<key_type, std::uint64_t>> indices{};
-            if (!sorted)
-                indices.reserve((keys.size() / _shared.cfg->cache.partition_sparse_index_ratio) / 2);
+    bool MemoryCache::_segment_index_read(std::size_t flush, ct::vector<key_type>& keys) noexcept
+    {
+        const auto path = _path/"flush"/std::format("f{}", flush)/"keys.idx";
+        if (!std::filesystem::exists(path))
+            return false;
 
-            // For wide partitions
+        Mapper mapper;
+        mapper.open(path, Mapper::OpenMode::Read);
+        mapper.map(Mapper::OpenMode::Read);
 
-            // Static
+        std::size_t off = 0;
+        const auto memory = mapper.memory();
+        if (memory.size() < sizeof(std::uint64_t))
+            return false;
+        const auto count = byte::sread<std::uint64_t>(memory, off);
+        if (memory.size() < off + count * sizeof(key_type))
+            return false;
 
-            std::vector<std::pair<std::span<const unsigned char>, std::uint64_t>> sort_block_indices{};
-            std::vector<std::pair<std::span<const unsigned char>, std::uint32_t>> sort_indices{};
+        keys.resize(count);
+        for (decltype(auto) it : keys)
+            it = byte::sread<key_type>(memory, off);
+        return true;
+    }
+    void MemoryCache::_segment_index_sync() noexcept
+    {
+        // Flushes are committed in order, the ones below the running count are done
+        const auto committed = _flush_id - _flush_running.load();
+        ct::vector<key_type> keys;
+        for (; _segment_indexed < committed; _segment_indexed++)
+        {
+            if (!_handle_cache[_segment_indexed].ready())
+                continue;
+            if (_segment_index_read(_segment_indexed, keys))
+            {
+                if (!_segment_index.insert(_segment_indexed, keys))
+                    RDB_WARN(mem, "C", _id, " F", _segment_indexed, " Segment index volume exceeded, segment is only fenced")
+            }
+            else
+            {
+                RDB_WARN("C", _id, " F", _segment_indexed, " Missing key list, segment will always be searched")
+                _segment_index.insert_unindexed(_segment_indexed);
+            }
+        }
+    }
+    const ct::vector<SegmentIndex::Candidate>& MemoryCache::_segment_index_find(key_type key) noexcept
+    {
+        _segment_index_sync();
+        _segment_index.find(key, _segment_candidates);
+        return _segment_candidates;
+    }
 
-            // Dynamic
+    void MemoryCache::_flush_impl(const write_store& map, const std::filesystem::path& fpath, int id) noexcept
+    {
+        FlushWriter writer(*this, fpath, id, map.size());
+        _data_impl(map, writer, id);
+        writer.close();
+    }
+    void MemoryCache::_flush_commit_impl(std::size_t id, std::size_t pressure) noexcept
+    {
+        _disk_logs.mark(id);
+        _flush_pressure -= pressure;
+        if (_shared.write_buffer != nullptr)
+            _shared.write_buffer->commit(pressure);
+        _handle_cache[id].unlocked.store(true, std::memory_order::release);
+        _segments.push_back(id);
+        // Before the memtable is released, stolen reads that no longer find it find the flush
+        _shared_segment_commit(id);
+        --_flush_running;
+        _flush_running.notify_all();
+        RDB_LOG(mem, "C", _id, " F", id, " Commited")
+    }
+    void MemoryCache::_flush_queue(std::shared_ptr<write_store> map, std::size_t id, std::size_t pressure) noexcept
+    {
+        // The core never waits for room in the ring, the backlog keeps the order once it is used
+        const std::lock_guard lock(_flush_backlog_lock);
+        if (!_flush_backlog.empty() || !_flush_tasks.try_enqueue(map, id, pressure))
+            _flush_backlog.emplace_back(std::move(map), id, pressure);
+    }
+    void MemoryCache::_flush_requeue() noexcept
+    {
+        const std::lock_guard lock(_flush_backlog_lock);
+        while (!_flush_backlog.empty())
+        {
+            const auto& [ map, id, pressure ] = _flush_backlog.front();
+            if (!_flush_tasks.try_enqueue(map, id, pressure))
+                break;
+            _flush_backlog.pop_front();
+        }
+    }
+    void MemoryCache::_flush_stop() noexcept
+    {
+        // Pending flushes are written and committed first, a running compaction is abandoned
+        if (!_flush_thread.joinable())
+            return;
+        _shutdown = true;
+        _flush_queue(nullptr, 0, 0);
+        _flush_thread.join();
+    }
+    void MemoryCache::_flush_if() noexcept
+    {
+        _sync_pressure();
+        [[ unlikely ]] if (_pressure > _shared.cfg->cache.flush_pressure)
+            flush();
+    }
+    float MemoryCache::_stall_level() const noexcept
+    {
+        // Zero below the soft threshold and one at the hard threshold
+        auto level = [](std::size_t value, std::size_t soft, std::size_t hard) -> float
+        {
+            if (!hard || value < soft)
+                return 0.f;
+            if (value >= hard || hard <= soft)
+                return 1.f;
+            return float(value - soft) / float(hard - soft);
+        };
+        const auto& cfg = _shared.cfg->cache;
+        return std::max(
+            level(_flush_running.load(), cfg.stall_soft_flushes, cfg.stall_hard_flushes),
+            level(_pressure + _flush_pressure.load(), cfg.stall_soft_pressure, cfg.stall_hard_pressure)
+        );
+    }
+    float MemoryCache::_stall_update() noexcept
+    {
+        const auto level = _stall_level();
+        const auto state =
+            level >= 1.f ? WriteStall::Stop :
+            level > 0.f ? WriteStall::Slowdown : WriteStall::None;
+        [[ unlikely ]] if (state != _stall)
+        {
+            RDB_LOG(mem, "C", _id, " Write stall ", int(_stall), " -> ", int(state),
+                    " (", _flush_running.load(), " pending flushes, ", _pressure + _flush_pressure.load(), "b)")
+            _stall = state;
+            _shared.events->trigger<Event::MemoryPressure>(
+                _pressure + _flush_pressure.load(), _map->size(), state
+            );
+        }
+        return level;
+    }
 
-            std::size_t sort_keyspace_size = 0;
-            std::size_t sort_keyspace_offset = 0;
-            std::vector<std::span<const unsigned char>> sort_keyspace{};
-            std::vector<std::pair<std::uint32_t, std::uint64_t>> sort_block_dynamic_indices{};
-            std::vector<std::pair<std::uint32_t, std::uint32_t>> sort_dynamic_indices{};
+    void MemoryCache::_scrub_impl() noexcept
+    {
+        // Every live flush is read through its own mapping in file order, nothing is decompressed
+        std::size_t blocks = 0;
+        std::size_t failures = 0;
+        for (const auto id : _segments)
+        {
+            const auto path = _path/"flush"/std::format("f{}", id)/"data.dat";
+            if (!std::filesystem::exists(path))
+                continue;
+
+            FlushHandle handle(0, true);
+            auto& data = handle.data;
+            data.open(path, Mapper::OpenMode::Read);
+            data.map(Mapper::OpenMode::Read);
+            data.hint(Mapper::Access::Sequential);
+
+            auto [ off, metadata ] = _disk_read_partition_metadata(handle);
+            while (off < data.size())
+            {
+                const auto partition = _disk_read_partition(handle, off);
+                for (auto boff = partition.begin; boff < partition.end;)
+                {
+                    const auto header = _disk_read_block(handle, boff);
+                    // Reported at the offset of the stored data like the failures found by reads
+                    failures += !_disk_verify_block(
+                        id, header.begin, data.memory().subspan(header.begin, header.compressed), header.flags, header.checksum
+                    );
+                    blocks++;
+                    boff = header.end;
+                }
+                off = _disk_next_partition(partition, handle);
+            }
+            data.hint(Mapper::Access::Cold);
+        }
+        RDB_LOG(mem, "C", _id, " Scrubbed ", blocks, " blocks in ", _segments.size(), " flushes, ", failures, " corrupted")
+    }
+    void MemoryCache::_scrub_if() noexcept
+    {
+        const auto interval = _shared.cfg->cache.scrub_interval;
+        if (interval.count() == 0 ||
+            std::chrono::steady_clock::now() - _scrub_timestamp < interval)
+            return;
+        _flush_busy = true;
+        _scrub_impl();
+        _flush_busy = false;
+        _scrub_timestamp = std::chrono::steady_clock::now();
+    }
 
-            BlockSourceMultiplexer source(block_pool, frag_pool);
+    void MemoryCache::_compaction_merge_impl(write_store::iterator partition, const View& sort, DataType type, std::span<const unsigned char> data) noexcept
+    {
+        auto* slot = _find_slot(partition, sort);
+        if (type != DataType::FieldSequence ||
+            slot == nullptr ||
+            slot->vtype == DataType::Tombstone)
+        {
+            _create_slot(partition, sort, type, data);
+            return;
+        }
 
-            // Advance the primary indexer
-            auto index = [&]
+        // Newer field sequences are layered over the older value field by field
+        auto& info = _info();
+        std::size_t off = 1;
+        for (auto count = data[0]; count--;)
+        {
+            RuntimeInterfaceReflection::RTII& finfo =
+                info.reflect(data[off]);
+            const auto size = finfo.storage(data.data() + off + 1) + 1;
+            slot = _write_field_impl(partition, sort, slot, data.subspan(off, size));
+            off += size;
+        }
+    }
+    bool MemoryCache::_compaction_next(PageCursor& cursor) noexcept
+    {
+        // Steps through every entry of a flush in key order, partition by partition
+        auto& info = _info();
+        auto& handle = *cursor.handle;
+        while (true)
+        {
+            if (info.skeys())
             {
-                primary_index_off += byte::swrite<key_type>(indexer.append() + primary_index_off, keys[partition_starting_block]);
-                primary_index_off += byte::swrite<std::uint64_t>(indexer.append() + primary_index_off, partition_offset);
-            };
-            // Advance the block indexer
-            auto index_block = [&]
+                if (cursor.pend && _page_next(cursor))
+                    return true;
+            }
+            else if (cursor.pend)
             {
-                RDB_TRACE(mem, "C", _id, " F", id, " B", blocks, " Indexing block")
-                block_index_offset = indexer.size();
-                if (dynamic)
+                while (cursor.off >= cursor.block.size() && cursor.boff < cursor.pend && !cursor.corrupt)
+                    _page_load_block(cursor);
+                if (cursor.off < cursor.block.size())
                 {
-                    indexer.vmap_increment(byte::swrite<std::uint32_t>(indexer.append(), sort_keyspace_size));
-                    for (decltype(auto) it : sort_keyspace)
-                    {
-                        indexer.vmap_increment(byte::swrite<std::uint16_t>(indexer.append(), it.size()));
-                        indexer.vmap_increment(byte::swrite(indexer.append(), it));
-                    }
-                    sort_keyspace.clear();
-
-                    data.vmap_increment(byte::swrite<std::uint32_t>(data.append(), sort_block_dynamic_indices.size()));
-                    for (decltype(auto) it : sort_block_dynamic_indices)
-                    {
-                        data.vmap_increment(byte::swrite<std::uint64_t>(data.append(), it.first));
-                        data.vmap_increment(byte::swrite<std::uint64_t>(data.append(), it.second));
-                    }
-                    sort_block_dynamic_indices.clear();
+                    // [ partition key | key | type | entry ]
+                    const auto begin = cursor.off;
+                    const auto len = info.partition_size(cursor.block.data() + cursor.off);
+                    cursor.pkey = View::view(cursor.block.subspan(cursor.off, len));
+                    cursor.off += len;
+                    cursor.key = byte::sread<key_type>(cursor.block, cursor.off);
+                    cursor.type = DataType(cursor.block[cursor.off++]);
+                    const auto size = _read_entry_size_impl(View::view(cursor.block.subspan(cursor.off)), cursor.type);
+                    cursor.value = cursor.block.subspan(cursor.off, size);
+                    cursor.off += size;
+                    cursor.entry = cursor.block.subspan(begin, cursor.off - begin);
+                    return true;
                 }
-                else
-                {
-                    indexer.vmap_increment(byte::swrite<std::uint32_t>(indexer.append(), sort_block_indices.size()));
-                    for (decltype(auto) it : sort_block_indices)
-                    {
-                        indexer.vmap_increment(byte::swrite(indexer.append(), it.first));
-                        indexer.vmap_increment(byte::swrite<std::uint64_t>(indexer.append(), it.second));
-                    }
-                    sort_block_indices.clear();
-                }
-            };
-            // Advance the value indexer (block for unary partitions, sort for wide partitions
-            auto index_value = [&]
+            }
+            if (cursor.corrupt || cursor.next >= handle.data.size())
+                return false;
+
+            const auto partition = _disk_read_partition(handle, cursor.next);
+            cursor.next = _disk_next_partition(partition, handle);
+            cursor.key = partition.key;
+            cursor.partition_keys = partition.key_count;
+            cursor.pbegin = partition.begin;
+            cursor.pend = partition.end;
+            cursor.boff = partition.begin;
+            cursor.block = {};
+            cursor.off = 0;
+        }
+    }
+    std::optional<bool> MemoryCache::_compaction_impl(const ct::vector<std::size_t>& flushes, bool drop) noexcept
+    {
+        // Folds the flushes into the newest one with a k-way merge, a block of every flush and the block being written are held
+        // The newest version of an entry wins, newer field sequences are layered over the versions below them
+        // Tombstones only survive if older flushes remain
+        // Returns nothing if the merge was abandoned, otherwise whether a merged flush was written
+
+        auto& info = _info();
+        const auto sorted = info.skeys();
+        const auto first = flushes.front();
+        const auto last = flushes.back();
+        const auto merged = _path/"flush"/std::format("c{}_{}", first, last);
+
+        RDB_LOG(mem, "C", _id, " Compacting F", first, "-F", last, " (", flushes.size(), " flushes)")
+
+        // Lower age is newer
+        std::vector<std::unique_ptr<FlushHandle>> handles;
+        ct::vector<PageCursor> cursors(flushes.size());
+        std::size_t keys = 0;
+        for (std::size_t i = 0; i < flushes.size(); i++)
+        {
+            const auto path = _path/"flush"/std::format("f{}", flushes[i]);
+            auto& handle = *handles.emplace_back(std::make_unique<FlushHandle>(0, true));
+            handle.data.open(path/"data.dat", Mapper::OpenMode::Read);
+            handle.data.map(Mapper::OpenMode::Read);
+            handle.data.hint(Mapper::Access::Sequential);
+
+            auto& cursor = cursors[i];
+            cursor.age = flushes.size() - 1 - i;
+            cursor.flush = flushes[i];
+            cursor.handle = &handle;
+            cursor.owned = true;
+            cursor.next = _disk_read_partition_metadata(handle).first;
+
+            // The key lists bound the merged keys, a flush without one is bounded by its partition headers (no block is read)
+            if (ct::vector<key_type> list; _segment_index_read(flushes[i], list))
+                keys += list.size();
+            else
             {
-                RDB_TRACE(mem, "C", _id, " F", id, " B", blocks, " Indexing values")
-                if (sorted)
+                for (auto off = cursor.next; off < handle.data.size();)
                 {
-                    value_index_offset = indexer.size();
-                    if (dynamic)
-                    {
-                        indexer.vmap_increment(byte::swrite<std::uint32_t>(indexer.append(), sort_dynamic_indices.size()));
-                        for (decltype(auto) it : sort_dynamic_indices)
-                        {
-                            indexer.vmap_increment(byte::swrite<std::uint32_t>(indexer.append(), it.first));
-                            indexer.vmap_increment(byte::swrite<std::uint32_t>(indexer.append(), it.second));
-                        }
-                        sort_dynamic_indices.clear();
-                    }
-                    else
-                    {
-                        indexer.vmap_increment(byte::swrite<std::uint32_t>(indexer.append(), sort_indices.size()));
-                        for (decltype(auto) it : sort_indices)
-                        {
-                            indexer.vmap_increment(byte::swrite(indexer.append(), it.first));
-                            indexer.vmap_increment(byte::swrite<std::uint32_t>(indexer.append(), it.second));
-                        }
-                        sort_indices.clear();
-                    }
+                    const auto partition = _disk_read_partition(handle, off);
+                    // A wide partition holds a single key, unary partitions count theirs
+                    keys += sorted ? 1 : partition.key_count;
+                    off = _disk_next_partition(partition, handle);
                 }
-                else
-                {
-                    block_index_offset = indexer.size();
-                    indexer.vmap_increment(byte::swrite<std::uint32_t>(indexer.append(), indices.size()));
-                    for (decltype(auto) it : indices)
-                    {
-                        indexer.vmap_increment(byte::swrite<key_type>(indexer.append(), it.first));
-                        indexer.vmap_increment(byte::swrite<std::uint64_t>(indexer.append(), it.second));
-                    }
-                    indices.clear();
-                }
-            };
-            // Block Writing logic
-            auto write_block = [&]
+            }
+        }
+
+        auto order = [sorted](const PageCursor* lhs, const PageCursor* rhs)
+        {
+            if (lhs->key != rhs->key)
+                return lhs->key > rhs->key;
+            if (sorted)
             {
-                if (source.empty())
-                    return;
+                if (const auto cmp = byte::binary_compare(lhs->sort, rhs->sort); cmp != 0)
+                    return cmp > 0;
+            }
+            return lhs->age > rhs->age;
+        };
+        std::priority_queue<PageCursor*, ct::vector<PageCursor*>, decltype(order)> heap(order);
+
+        bool corrupt = false;
+        for (decltype(auto) it : cursors)
+        {
+            if (_compaction_next(it))
+                heap.push(&it);
+            corrupt |= it.corrupt;
+        }
 
-                RDB_TRACE(mem, "C", _id, " F", id, " B", blocks, " Emitting block")
-                RDB_WARN_IF(
-                    source.fragments() >= frag_pool.size(),
-                    mem, "C", _id, " F", id, " B", blocks, " High fragmentation: ", source.fragments()
-                )
+        // Created with the first surviving entry
+        std::optional<FlushWriter> writer;
+        bool open = false;
+        key_type current = 0;
+        // Layered field sequences are rebuilt in a scratch memtable
+        auto scratch = std::make_unique<write_store>();
+        ct::vector<PageCursor*> group;
+        while (!heap.empty() && !corrupt && !_shutdown)
+        {
+            // Every version of the entry, newest first
+            group.clear();
+            group.push_back(heap.top());
+            heap.pop();
+            auto* top = group.front();
+            while (!heap.empty() && heap.top()->key == top->key &&
+                   (!sorted || byte::binary_compare(heap.top()->sort, top->sort) == 0))
+            {
+                group.push_back(heap.top());
+                heap.pop();
+            }
 
-                source.flush();
-                // Metadata
+            if (!drop || top->type != DataType::Tombstone)
+            {
+                if (!writer.has_value())
+                    writer.emplace(*this, merged, last, keys);
+                if (sorted && (!open || current != top->key))
                 {
-                    data.vmap_increment(byte::swrite<std::uint16_t>(data.append(), 0));
-                    data.vmap_increment(byte::swrite<std::uint16_t>(data.append(), 0));
-                    data.vmap_increment(byte::swrite<std::uint64_t>(data.append(), source.digest()));
-                    data.vmap_increment(byte::swrite<std::uint64_t>(data.append(), value_index_offset));
+                    if (open)
+                        writer->end();
+                    // Versions of the partition in the other flushes bound its entries
+                    std::size_t entries = 0;
+                    for (const auto& it : cursors)
+                        entries += it.key == top->key ? it.partition_keys : 0;
+                    writer->begin(top->key, top->pkey.data(), entries, true);
+                    open = true;
+                    current = top->key;
                 }
-                // Compression and data
-                RDB_TRACE(mem, "C", _id, " F", id, " Writing B", blocks++, " ", source.size(), "b")
-                {
-                    const auto psize = source.size();
-                    StaticBufferSink sink(psize, compressed_block_pool);
-                    snappy::Compress(&source, &sink);
-                    const auto compsize = sink.size();
-                    const auto ratio = float(compsize) / psize;
-                    RDB_TRACE(mem, "C", _id, " F", id, " B", blocks - 1, " Compression ratio ", (std::round(ratio * 100) / 100) * 100, "%")
-
-                    if (ratio < _shared.cfg->cache.compression_ratio)
-                    {
-                        RDB_TRACE(mem, "C", _id, " F", id, " Writing B", blocks - 1, " Compressed")
-                        data.vmap_increment(byte::swrite<std::uint32_t>(data.append(), psize));
-                        data.vmap_increment(byte::swrite<std::uint32_t>(data.append(), sink.size()));
-                        data.vmap_increment(byte::swrite(data.append(), sink.data()));
-                    }
-                    else
-                    {
-                        RDB_TRACE(mem, "C", _id, " F", id, " Writing B", blocks - 1, " Raw")
-                        data.vmap_increment(byte::swrite<std::uint32_t>(data.append(), psize));
-                        data.vmap_increment(byte::swrite<std::uint32_t>(data.append(), psize));
-                        data.vmap_increment(byte::swrite(data.append(), source.block()));
-                    }
 
-                    source.clear();
-                    sink.clear();
+                if (top->type != DataType::FieldSequence || group.size() == 1)
+                {
+                    if (sorted) writer->write_raw(top->sort.data(), top->entry);
+                    else writer->write_raw(top->key, top->entry);
                 }
-                // Min key
+                else
                 {
-                    if (sorted)
-                    {
-                        if (!dynamic)
-                            data.vmap_increment(byte::swrite<std::uint64_t>(data.append(), value_index_offset));
-                    }
-                    else
-                    {
-                        data.vmap_increment(byte::swrite<key_type>(data.append(), value_index_offset));
-                    }
+                    // From the newest version that replaces everything below it (or the oldest one) up
+                    std::size_t base = 0;
+                    while (base < group.size() - 1 && group[base]->type == DataType::FieldSequence)
+                        base++;
+                    const auto part = _create_partition_if(*scratch, top->key, top->pkey);
+                    for (auto i = base + 1; i-- > 0;)
+                        _compaction_merge_impl(part, group[i]->sort, group[i]->type, group[i]->value);
+
+                    const auto* slot = _find_slot(part, top->sort);
+                    if (sorted) writer->write(top->sort.data(), slot);
+                    else writer->write(top->key, top->pkey.data(), slot, true);
+
+                    scratch->clear();
+                    if (scratch->arena.used() >= _shared.cfg->cache.block_size)
+                        scratch = std::make_unique<write_store>();
                 }
-            };
-            // Reserves a new partition
-            auto start_partition = [&]
-            {
-                partition_offset = data.size();
-                data.vmap_increment(partition_header_size - sizeof(key_type));
-                data.vmap_increment(byte::swrite<key_type>(data.append(), keys[idx]));
-                block_index_offset = 0;
-                partition_starting_block = 0;
-                partition_offset = 0;
-                partition_size = 0;
-                partition_keys = 0;
-            };
-            // Partition header
-            auto write_partition = [&]
-            {
-                std::size_t off = partition_offset;
-                off += byte::swrite<std::uint64_t>(data.memory(), off, data.size() - partition_offset - partition_header_size);
-                off += byte::swrite<std::uint64_t>(data.memory(), off, partition_size);
-                off += byte::swrite<std::uint64_t>(data.memory(), off, block_index_offset);
-                off += byte::swrite<std::uint64_t>(data.memory(), off, bloom_offset);
-                off += byte::swrite<std::uint32_t>(data.memory(), off, blocks - partition_starting_block);
-                byte::swrite<std::uint32_t>(data.memory(), off, bloom_offset);
-            };
+            }
 
-            if (sorted)
+            for (auto* it : group)
             {
-                for (idx = 0; idx < keys.size(); idx++)
-                {
-                    const auto part_iterator = map.find(keys[idx]);
-                    const auto& [ pkey, pdata ] = part_iterator->second;
-                    const auto& part = std::get<partition>(pdata);
-
-                    sort_block_indices.reserve(part.size() / _shared.cfg->cache.partition_sparse_index_ratio);
-                    sort_indices.reserve(sort_block_indices.capacity() / _shared.cfg->cache.block_sparse_index_ratio);
-
-                    // Reserve partition data and setup partition
-                    source.push({ .data = pkey });
-                    // Start bloom filter
-                    bloom_offset = bloom.size();
-                    bloom_bits = _bloom_intra_partition_begin_impl(part_iterator, bloom, id);
+                if (_compaction_next(*it))
+                    heap.push(it);
+                corrupt |= it->corrupt;
+            }
+        }
 
-                    start_partition();
-                    std::size_t j = 0;
-                    part.foreach([&](partition::const_key key, const Slot* value) {
-                        partition_keys++;
-                        partition_size += value->size + key.size();
+        // A partial merge keeps its lock, startup discards it if it is not removed here
+        if (corrupt || _shutdown)
+        {
+            RDB_WARN(mem, "C", _id, " Compaction F", first, "-F", last, corrupt ? " stopped on a corrupted block" : " abandoned")
+            writer.reset();
+            std::error_code ec;
+            std::filesystem::remove_all(merged, ec);
+            return std::nullopt;
+        }
+        if (!writer.has_value())
+        {
+            RDB_LOG(mem, "C", _id, " Compaction F", first, "-F", last, " left no data")
+            std::filesystem::create_directory(merged);
+            return false;
+        }
 
-                        // Bloom filter
+        if (open)
+            writer->end();
+        writer->close();
+        RDB_LOG(mem, "C", _id, " Compacted F", first, "-F", last)
+        return true;
+    }
+    void MemoryCache::_compaction_join_if(bool wait) noexcept
+    {
+        if (!_compaction_thread.joinable() ||
+            (!wait && !_compaction_done.load(std::memory_order::acquire)))
+            return;
+        _compaction_thread.join();
 
-                        _bloom_intra_partition_round_impl(part_iterator, View::view(key), bloom_bits, bloom, id);
+        // Flushes committed meanwhile were appended, the folded range did not move
+        const auto [ from, to ] = _compaction_fold;
+        const auto first = _segments[from];
+        const auto last = _segments[to - 1];
+        if (_compaction_result.has_value())
+        {
+            _segments.erase(_segments.begin() + from, _segments.begin() + to - *_compaction_result);
+            _compaction_range = { first, last };
+            _compaction_garbage = true;
+            _compaction_pending.store(true, std::memory_order::release);
+        }
+        // Pending is raised first, idle() reads these in the opposite order
+        _compaction_running.store(false, std::memory_order::release);
+    }
+    void MemoryCache::_compaction_if() noexcept
+    {
+        _compaction_join_if();
+        if (_compaction_running.load(std::memory_order::acquire) ||
+            _compaction_pending.load(std::memory_order::acquire))
+            return;
 
-                        // Writing data
+        if (_compaction_garbage)
+        {
+            const auto [ first, last ] = _compaction_range;
+            for (auto id = first; id <= last; id++)
+                std::filesystem::remove_all(_path/"flush"/std::format("g{}", id));
+            _compaction_garbage = false;
+        }
 
-                        const auto buffer = value->flush_buffer();
-                        if (j++ % _shared.cfg->cache.sort_sparse_index_ratio == 0)
-                        {
-                            if (dynamic)
-                            {
-                                sort_dynamic_indices.push_back({
-                                    sort_keyspace_offset,
-                                    source.size()
-                                });
-                                sort_keyspace.push_back(key);
-                                sort_keyspace_offset += key.size() + sizeof(std::uint16_t);
-                            }
-                            else
-                            {
-                                sort_indices.push_back({
-                                    key,
-                                    source.size()
-                                });
-                            }
-                        }
+        const auto fold = std::min(_shared.cfg->cache.compaction_fold_ratio, _segments.size());
+        if (fold < 2 || _segments.size() <= _shared.cfg->cache.compaction_pressure)
+            return;
 
-                        if (value->vtype == DataType::SchemaInstance)
-                        {
-                            source.push({
-                                .data = buffer
-                            });
-                        }
-                        else
-                        {
-                            source.push({
-                                .key = key,
-                                .data = buffer
-                            });
-                        }
+        // Fold the adjacent run with the least data so large segments are not rewritten over and over
+        std::vector<std::size_t> sizes(_segments.size());
+        for (std::size_t i = 0; i < _segments.size(); i++)
+        {
+            std::error_code ec;
+            const auto size = std::filesystem::file_size(_path/"flush"/std::format("f{}", _segments[i])/"data.dat", ec);
+            sizes[i] = ec ? 0 : size;
+        }
 
-                        if (source.size() >= _shared.cfg->cache.block_size)
-                        {
-                            RDB_TRACE(mem, "C", _id, " F", id, " B", blocks, " Pressure reached ", source.size())
-                            if (blocks % _shared.cfg->cache.block_sparse_index_ratio == 0)
-                            {
-                                sort_block_indices.push_back({
-                                    sort_indices[0].first,
-                                    data.size()
-                                });
-                            }
-                            index_value();
-                            write_block();
-                        }
-                        return true;
-                    });
-                    write_partition();
-
-                    // End bloom filter
-                    _bloom_intra_partition_end_impl(part_iterator, bloom_bits, bloom, id);
-                    if (idx % _shared.cfg->cache.partition_sparse_index_ratio)
-                        index();
-                    index_block();
-                    write_block();
-                }
-            }
-            else
+        std::size_t from = 0;
+        std::size_t best = ~0ull;
+        for (std::size_t i = 0; i + fold <= sizes.size(); i++)
+        {
+            const auto size = std::accumulate(sizes.begin() + i, sizes.begin() + i + fold, std::size_t(0));
+            if (size < best)
             {
-                start_partition();
-                for (idx = 0; idx < keys.size(); idx++)
-                {
-                    partition_starting_block = idx;
-                    for (; idx < keys.size() && source.size() <= _shared.cfg->cache.block_size; idx++)
-                    {
-                        const auto& [ pkey, pdata ] = map.at(keys[idx]);
-                        const auto buffer = std::get<single_slot>(pdata)->flush_buffer();
-                        source.push({ .data = pkey });
-                        if (!buffer.empty())
-                        {
-                            if (idx % _shared.cfg->cache.sort_sparse_index_ratio == 0)
-                            {
-                                indices.push_back({
-                                    keys[idx],
-                                    source.size()
-                                });
-                            }
-                            source.push({ .data = byte::tspan(keys[idx]) });
-                        }
-                        source.push({ .data = buffer });
-                    }
-                    if (idx % _shared.cfg->cache.block_sparse_index_ratio)
-                        index();
-                    index_value();
-                    write_block();
-                }
-                write_partition();
+                best = size;
+                from = i;
             }
         }
 
-        RDB_LOG(mem, "C", _id, " F", id, " Commit bloom ", bloom.size(), "b")
-        RDB_LOG(mem, "C", _id, " F", id, " Commit indexer ", indexer.size(), "b")
-        RDB_LOG(mem, "C", _id, " F", id, " Commit data ", data.size(), "b")
-    }
-
-    void MemoryCache::_data_close_impl(Mapper& data) noexcept
-    {
-        data.vmap_flush();
-        data.close();
-    }
-    void MemoryCache::_indexer_close_impl(Mapper& indexer) noexcept
-    {
-        indexer.vmap_flush();
-        indexer.close();
+        // The merge reads the folded flushes while new ones are written and committed
+        _compaction_fold = { from, from + fold };
+        _compaction_result.reset();
+        _compaction_done.store(false, std::memory_order::relaxed);
+        _compaction_running.store(true, std::memory_order::release);
+        _compaction_thread = std::jthread([this, flushes = ct::vector<std::size_t>(_segments.begin() + from, _segments.begin() + from + fold), drop = from == 0]()
+        {
+            if (_shared.cfg->mnt.numa)
+                util::bind_thread(_id);
+            _compaction_result = _compaction_impl(flushes, drop);
+            _compaction_done.store(true, std::memory_order::release);
+        });
     }
-    void MemoryCache::_bloom_close_impl(Mapper& bloom) noexcept
+    void MemoryCache::_compaction_commit_if() noexcept
     {
-        bloom.vmap_flush();
-        bloom.close();
-    }
-
-    void MemoryCache::_flush_impl(const write_store& map, int id) noexcept
-    {
-        std::filesystem::path fpath = _path/"flush"/std::format("f{}", std::to_string(id));
-        std::filesystem::create_directory(fpath);
+        [[ likely ]] if (!_compaction_pending.load(std::memory_order::acquire))
+            return;
 
-        Mapper data;
-        Mapper indexer;
-        Mapper bloom;
-        Mapper lock;
+        // Retire the folded flushes and swap the merged segment in under the id of the newest one
+        const auto [ first, last ] = _compaction_range;
+        const auto root = _path/"flush";
+        const auto merged = root/std::format("c{}_{}", first, last);
 
-        data.open(fpath/"data.dat");
-        indexer.open(fpath/"indexer.idx");
-        bloom.open(fpath/"filter.blx");
-        lock.open(fpath/"lock");
+        // Stolen reads keep the folded flushes they mapped, the others are retired before their files are renamed
+        const std::lock_guard lock(_shared_segments_lock);
+        auto segments = std::make_shared<shared_segments>();
+        for (decltype(auto) it : *_shared_segments)
+        {
+            if (it->flush < first || it->flush > last)
+                segments->push_back(it);
+            else
+                it->retired = true;
+        }
 
-        _bloom_impl(map, bloom, id);
-        _data_impl(map, data, indexer, bloom, id);
-        _data_close_impl(data);
-        _indexer_close_impl(indexer);
-        _bloom_close_impl(bloom);
+        std::error_code ec;
+        for (auto id = first; id <= last; id++)
+        {
+            _segment_index.erase(id);
+            _handle_close(id);
+            _disk_cache->erase(_schema, id);
+            _handle_cache[id].unlocked.store(false, std::memory_order::release);
+            std::filesystem::rename(root/std::format("f{}", id), root/std::format("g{}", id), ec);
+        }
+        if (std::filesystem::exists(merged/"data.dat"))
+        {
+            std::filesystem::rename(merged, root/std::format("f{}", last));
+            _handle_cache[last].unlocked.store(true, std::memory_order::release);
+            _shared_segment_insert(*segments, last);
+            // Otherwise picked up by the next sync
+            if (ct::vector<key_type> keys; last < _segment_indexed)
+            {
+                if (_segment_index_read(last, keys))
+                    _segment_index.insert(last, keys);
+                else
+                    _segment_index.insert_unindexed(last);
+            }
+        }
+        else
+            std::filesystem::remove(merged, ec);
+        _shared_segments = std::move(segments);
 
-        lock.remove();
-    }
-    void MemoryCache::_flush_if() noexcept
-    {
-        [[ unlikely ]] if (_pressure > _shared.cfg->cache.flush_pressure)
-            flush();
+        RDB_LOG(mem, "C", _id, " Swapped in compaction F", first, "-F", last)
+        _compaction_pending.store(false, std::memory_order::release);
     }
 
     void MemoryCache::sync() noexcept
@@ -2243,6 +3687,7 @@ namespace rdb
     {
         if (_map->empty())
             return;
+        _sync_pressure();
 
         [[ unlikely ]] if (!_flush_thread.joinable())
         {
@@ -2251,39 +3696,98 @@ namespace rdb
                 if (_shared.cfg->mnt.numa)
                     util::bind_thread(_id);
                 RDB_LOG(mem, "C", _id, " Launching flush thread")
-                while (!_shutdown)
+
+                // The blocks of a flush are compressed by the workers, which live as long as this thread
+                _flush_workers.resize(_shared.cfg->cache.flush_workers);
+                for (decltype(auto) it : _flush_workers)
                 {
-                    std::pair<std::shared_ptr<write_store>, std::size_t> flush_data;
-                    auto& [ map, id ] = flush_data;
-                    if (_flush_tasks.dequeue(flush_data) && flush_data.first != nullptr)
+                    it = std::make_unique<FlushWorker>();
+                    it->thread = std::jthread([this, worker = it.get()]()
+                    {
+                        if (_shared.cfg->mnt.numa)
+                            util::bind_thread(_id);
+                        FlushItem* item = nullptr;
+                        while (worker->tasks.dequeue(item) && item != nullptr)
+                            _data_compress_impl(*item);
+                    });
+                }
+
+                // Runs until the stop request, which is queued behind every pending flush
+                while (true)
+                {
+                    std::tuple<std::shared_ptr<write_store>, std::size_t, std::size_t> flush_data;
+                    auto& [ map, id, bytes ] = flush_data;
+                    // Wake up periodically if the scrubber has to run, and often to retire a running compaction
+                    const auto dequeued =
+                        _compaction_running.load() ?
+                        _flush_tasks.dequeue(flush_data, std::chrono::milliseconds(10)) :
+                        _shared.cfg->cache.scrub_interval.count() ?
+                        _flush_tasks.dequeue(flush_data, std::chrono::seconds(1)) :
+                        _flush_tasks.dequeue(flush_data);
+                    _compaction_join_if();
+                    // There is room for the memtables the core could not queue
+                    if (dequeued)
+                        _flush_requeue();
+                    if (dequeued && map == nullptr)
+                        break;
+                    if (dequeued)
                     {
                         RDB_LOG(mem, "C", _id, " F", id, " Dequeued")
-                        _flush_impl(*map, id);
-                        _disk_logs.mark(id);
-                        _handle_cache[id].unlocked.store(true, std::memory_order::release);
-                        --_flush_running;
-                        _flush_running.notify_all();
-                        RDB_LOG(mem, "C", _id, " F", id, " Commited")
+                        _flush_impl(*map, _path/"flush"/std::format("f{}", id), id);
+                        _flush_busy = true;
+                        _flush_commit_impl(id, bytes);
+                        // Readers find the flush from now on, so the memtable can go
+                        map = nullptr;
+                        _compaction_if();
+                        _flush_busy = false;
                     }
+                    _scrub_if();
                 }
+                // The stop request abandons a running compaction, a finished one is swapped in by the core
+                _compaction_join_if(true);
+                for (decltype(auto) it : _flush_workers)
+                    it->tasks.enqueue(nullptr);
+                _flush_workers.clear();
             });
         }
 
+        _compaction_commit_if();
+
         ++_flush_running;
-        _readonly_maps.push_back(_map);
         _disk_logs.snapshot(_flush_id);
         _handle_reserve();
         RDB_LOG(mem, "C", _id, " F", _flush_id.load(), " Queued ", _pressure, "b")
-        _flush_tasks.enqueue(_map, _flush_id++);
+        _flush_pressure += _pressure;
+        if (_shared.write_buffer != nullptr)
+            _shared.write_buffer->flush(_pressure);
+        _flush_queue(_map, _flush_id++, _pressure);
+        _shared.events->trigger<Event::MemoryPressure>(
+            _flush_pressure.load(), _map->size(), _stall
+        );
 
         _pressure = 0;
-        _map = std::make_shared<write_store>();
+        {
+            const auto lock = _map_exclusive();
+            // Expired maps are pruned here since readers may be scanning the list
+            std::erase_if(_readonly_maps, [](const auto& map) { return map.expired(); });
+            _readonly_maps.push_back(_map);
+            _map = std::make_shared<write_store>();
+        }
     }
     void MemoryCache::clear() noexcept
     {
         if (_map->empty())
             return;
+        if (_page_cache != nullptr)
+            _page_cache->clear(_schema);
+        if (_shared.write_buffer != nullptr)
+            _shared.write_buffer->charge(-static_cast<std::ptrdiff_t>(_pressure));
         _pressure = 0;
-        _map->clear();
+        const auto lock = _map_exclusive();
+        _map = std::make_shared<write_store>();
+    }
+    void MemoryCache::sync_logs() noexcept
+    {
+        _disk_logs.sync();
     }
 }
@@ -2,6 +2,8 @@
 #define RDB_MEMORY_HPP
 
 #include <bitset>
+#include <deque>
+#include <mutex>
 #include <filesystem>
 #include <rdb_reflect.hpp>
 #include <rdb_shared_buffer.hpp>
@@ -12,6 +14,10 @@
 #include <rdb_log.hpp>
 #include <rdb_containers.hpp>
 #include <rdb_task_ring.hpp>
+#include <rdb_disk_cache.hpp>
+#include <rdb_page_cache.hpp>
+#include <rdb_segment_index.hpp>
+#include <rdb_write_buffer.hpp>
 
 namespace rdb
 {
@@ -43,10 +49,21 @@ namespace rdb
             PK = 1 << 0,
             PK_F = 1 << 1,
             PK_SK = 1 << 2,
+            // Every probe of a key lands in a single block (cache line), see _bloom_blocked_round_impl
+            Blocked = 1 << 3,
         };
+        // Blocks of the blocked bloom filter (8 32-bit lanes, one bit set per lane)
+        static constexpr std::size_t bloom_block_size = 32;
+        static constexpr std::uint32_t bloom_salt[]{
+            0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d,
+            0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31
+        };
+
         enum BlockFlags : unsigned char
         {
             Encrypted = 1 << 0,
+            // The checksum is an XXH3 of the stored (possibly compressed) data
+            Checksummed = 1 << 1,
         };
 
         struct FlushHandle
@@ -81,10 +98,13 @@ namespace rdb
             static std::size_t allocation_size(DataType vtype, std::span<const unsigned char> data) noexcept;
             static std::size_t allocation_size(DataType vtype, std::size_t size) noexcept;
         };
+        // Slots of a memtable are placed in its arena and released together with it
         struct SlotDeleter
         {
-            static Slot* allocate(DataType vtype, std::span<const unsigned char> data) noexcept;
-            static Slot* allocate(DataType vtype, std::size_t size) noexcept;
+            ct::Arena* arena{ nullptr };
+
+            Slot* allocate(DataType vtype, std::span<const unsigned char> data) noexcept;
+            Slot* allocate(DataType vtype, std::size_t size) noexcept;
             void operator()(Slot* slot) noexcept;
         };
         struct alignas(std::atomic<std::chrono::system_clock::time_point>) LockData
@@ -127,22 +147,94 @@ namespace rdb
             std::uint64_t version{};
             std::uint64_t partition_sparse_index{};
             std::uint64_t intra_partition_sparse_index{};
+            std::uint64_t sort_sparse_index{};
             std::uint64_t block_size{};
         };
+        struct PartitionHeader
+        {
+            std::uint64_t size{};
+            std::uint64_t accumulated_size{};
+            std::uint64_t index_offset{};
+            std::uint64_t bloom_offset{};
+            std::uint32_t block_count{};
+            std::uint32_t key_count{};
+            key_type key{};
+            // Absolute offsets of the block sequence
+            std::size_t begin{};
+            std::size_t end{};
+        };
+        struct BlockHeader
+        {
+            std::uint16_t version{};
+            std::uint16_t flags{};
+            std::uint64_t checksum{};
+            std::uint64_t index_offset{};
+            std::uint32_t decompressed{};
+            std::uint32_t compressed{};
+            // Absolute offset of the (compressed) block data and the end of the block (including the min key)
+            std::size_t begin{};
+            std::size_t end{};
+        };
+
+        // A single sorted source of a paged partition, either a memory partition or a flushed partition
+        struct PageCursor
+        {
+            // Lower is newer, the newest version of a key wins
+            std::size_t age{ 0 };
+            View sort{ nullptr };
+            DataType type{};
+            std::span<const unsigned char> value{};
+
+            // Memory partitions are read in batches (the tree can't be iterated incrementally)
+            const ct::ordered_byte_map<Slot>* map{ nullptr };
+            ct::vector<std::pair<std::span<const unsigned char>, const Slot*>> batch{};
+            std::size_t batch_off{ 0 };
+            std::size_t limit{ 0 };
+
+            // Flushed partitions are streamed block by block
+            std::size_t flush{ 0 };
+            FlushHandle* handle{ nullptr };
+            std::size_t boff{ 0 };
+            std::size_t pbegin{ 0 };
+            std::size_t pend{ 0 };
+            DiskCache::block hold{};
+            std::span<const unsigned char> block{};
+            std::size_t off{ 0 };
+            // A block failed verification, the cursor stops and older sources must not be consulted
+            bool corrupt{ false };
+
+            // Compactions and stolen reads decompress blocks into the cursor and always verify them, a stolen read shares its handle
+            bool owned{ false };
+            ct::vector<unsigned char> buffer{};
+            key_type key{ 0 };
+            View pkey{ nullptr };
+            // Encoded entry, written to the merged flush as is
+            std::span<const unsigned char> entry{};
+            std::size_t partition_keys{ 0 };
+            std::size_t next{ 0 };
+        };
 
         using slot = Slot*;
         using const_slot = const Slot*;
         using single_slot = std::unique_ptr<Slot, SlotDeleter>;
         using partition = ct::ordered_byte_map<Slot>;
         using partition_variant = std::variant<single_slot, partition>;
-        using write_store =
+        struct write_store_arena
+        {
+            ct::Arena arena{};
+        };
+        // A memtable generation, owns the memory of its slots and partition keys
+        // The arena base is destroyed after the map
+        struct write_store :
+            write_store_arena,
             ct::hash_map<
-            key_type,
-            std::pair<
-                View,
-                partition_variant
+                key_type,
+                std::pair<
+                    View,
+                    partition_variant
+                >
             >
-        >;
+        {};
 
         using lock_type = LockData*;
         using single_lock = LockData;
@@ -156,52 +248,176 @@ namespace rdb
     private:
         std::filesystem::path _path{};
         std::atomic<std::size_t> _flush_running{ 0 };
+        // The flush thread is committing, compacting or scrubbing
+        std::atomic<bool> _flush_busy{ false };
+        // Memory held by memtables that are queued or being flushed
+        std::atomic<std::size_t> _flush_pressure{ 0 };
         std::atomic<std::size_t> _flush_id{ 0 };
         std::shared_ptr<write_store> _map{};
         ct::vector<std::weak_ptr<write_store>> _readonly_maps{};
+        // Guards the memtable and the readonly maps against readers from other threads (concurrent reads only)
+        mutable util::SharedSpinlock _map_lock{};
+
+        // A live flush as read by the cores that steal reads, mapped by the first one that needs it
+        // Its mappings are not counted against the descriptor and mapping limits, they go with the last reader once it is folded
+        struct SharedSegment
+        {
+            std::size_t flush{ 0 };
+            FlushHandle handle{ 0, true };
+            std::atomic<bool> mapped{ false };
+            // Folded by a compaction, it can no longer be mapped (guarded by the lock)
+            bool retired{ false };
+        };
+        using shared_segments = ct::vector<std::shared_ptr<SharedSegment>>;
+        // Flush ids in ascending order, replaced whenever a flush is committed or folded
+        std::shared_ptr<const shared_segments> _shared_segments{ std::make_shared<const shared_segments>() };
+        // Guards the list, the mapping of its segments and the renames of folded flushes
+        mutable std::mutex _shared_segments_lock{};
 
         mutable ct::vector<FlushHandle> _handle_cache{};
         mutable ct::vector<std::size_t> _handle_cache_tracker{};
         mutable std::size_t _mappings{ 0 };
         mutable std::size_t _descriptors{ 0 };
 
-        mutable RuntimeSchemaReflection::RTSI* _schema_info{ nullptr };
-        mutable std::size_t _schema_version{ 0 };
+        // Refreshed by whichever thread notices first (the core and the flush workers)
+        mutable std::atomic<RuntimeSchemaReflection::RTSI*> _schema_info{ nullptr };
+        mutable std::atomic<std::size_t> _schema_version{ 0 };
 
+        // Memory held by the current memtable (bytes)
         std::size_t _pressure{ 0 };
         std::size_t _id{ 0 };
         std::size_t _lock_cnt{ 0 };
         lock_store _locks{};
         schema_type _schema{};
         Log _disk_logs{};
+        // Shared by the schemas of the core, private if none was given
+        DiskCache* _disk_cache{ nullptr };
+        DiskCache::ptr _disk_cache_owned{};
+        // Shared by the schemas of the core, private if none was given (and pages are cached)
+        PageCache* _page_cache{ nullptr };
+        PageCache::ptr _page_cache_owned{};
+        SegmentIndex _segment_index{};
+        // Flushes below this id were added to the segment index
+        std::size_t _segment_indexed{ 0 };
+        ct::vector<SegmentIndex::Candidate> _segment_candidates{};
         Shared _shared{};
 
+        // A unit of a flush, written to the data in order by the flush thread
+        // Blocks are compressed by the flush workers until the flush thread reaches them
+        struct FlushItem
+        {
+            enum class Type
+            {
+                Block,
+                PartitionBegin,
+                PartitionEnd
+            };
+
+            Type type{ Type::Block };
+            // Raw block data, or the data following the blocks of a partition
+            std::vector<unsigned char> input{};
+            // Stored block
+            std::vector<unsigned char> output{};
+            // Secondary index offset and min key of a block
+            std::uint64_t index{ 0 };
+            std::optional<std::uint64_t> min_key{};
+            // Partition header (the key is written at the beginning, the rest at the end)
+            key_type key{ 0 };
+            std::uint64_t size{ 0 };
+            std::uint64_t block_index_offset{ 0 };
+            std::uint64_t bloom_offset{ 0 };
+            std::uint32_t blocks{ 0 };
+            std::uint32_t keys{ 0 };
+            std::atomic<bool> done{ false };
+        };
+        struct FlushWorker
+        {
+            ct::TaskRing<FlushItem*, 16> tasks{};
+            std::jthread thread{};
+        };
+        // Streams the partitions of a flush or a compaction to disk
+        class FlushWriter;
+
         std::atomic<bool> _shutdown{ false };
+        // Joined by the destructor, before any of the members it uses are destroyed
         std::jthread _flush_thread{};
-        ct::TaskRing<std::pair<std::shared_ptr<write_store>, std::size_t>, 4> _flush_tasks{};
+        // Owned by the flush thread, which joins them before it exits
+        std::vector<std::unique_ptr<FlushWorker>> _flush_workers{};
+        // Memtable | flush id | memory held by the memtable
+        ct::TaskRing<std::tuple<std::shared_ptr<write_store>, std::size_t, std::size_t>, 4> _flush_tasks{};
+        // Sealed memtables the ring had no room for, moved over by the flush thread in order (guarded by the lock)
+        std::deque<std::tuple<std::shared_ptr<write_store>, std::size_t, std::size_t>> _flush_backlog{};
+        std::mutex _flush_backlog_lock{};
+        WriteStall _stall{ WriteStall::None };
+
+        // Live flushes (owned by the flush thread once it is launched)
+        ct::vector<std::size_t> _segments{};
+        // Flushes folded by the last compaction, swapped in by the core thread
+        std::pair<std::size_t, std::size_t> _compaction_range{};
+        std::atomic<bool> _compaction_pending{ false };
+        bool _compaction_garbage{ false };
+        // Merges run on their own thread, the flush thread starts them and retires the folded flushes once they are done
+        std::jthread _compaction_thread{};
+        std::atomic<bool> _compaction_running{ false };
+        std::atomic<bool> _compaction_done{ false };
+        // Folded range of _segments | outcome (nothing if abandoned, whether a merged flush was written otherwise)
+        std::pair<std::size_t, std::size_t> _compaction_fold{};
+        std::optional<bool> _compaction_result{};
+        std::chrono::steady_clock::time_point _scrub_timestamp{ std::chrono::steady_clock::now() };
+        // Disk block reads since the last sampled verification
+        std::size_t _verify_counter{ 0 };
 
         RuntimeSchemaReflection::RTSI& _info() const noexcept;
         std::size_t _cpu() const noexcept;
-        void _push_bytes(int) noexcept;
+        void _sync_pressure() noexcept;
+        static std::size_t _memory(const write_store& map) noexcept;
+        std::unique_lock<util::SharedSpinlock> _map_exclusive() noexcept;
 
         FlushHandle& _handle_open(std::size_t flush) const noexcept;
         void _handle_reserve(bool ready = false) const noexcept;
         void _handle_close_soft(std::size_t flush) const noexcept;
         void _handle_close(std::size_t flush) const noexcept;
 
+        static void _shared_segment_insert(shared_segments& segments, std::size_t flush) noexcept;
+        void _shared_segment_commit(std::size_t flush) noexcept;
+        // Nothing if the segment was folded before it could be mapped
+        FlushHandle* _shared_segment_map(SharedSegment& segment) const noexcept;
+
         std::optional<std::size_t> _disk_find_partition(key_type key, FlushHandle& handle) noexcept;
         std::pair<std::size_t, MemoryCache::PartitionMetadata> _disk_read_partition_metadata(FlushHandle& handle) noexcept;
+        PartitionHeader _disk_read_partition(FlushHandle& handle, std::size_t off) noexcept;
+        std::optional<PartitionHeader> _disk_seek_partition(key_type key, FlushHandle& handle) noexcept;
+        std::size_t _disk_next_partition(const PartitionHeader& partition, FlushHandle& handle) noexcept;
+        BlockHeader _disk_read_block(FlushHandle& handle, std::size_t off) noexcept;
+        std::span<const unsigned char> _disk_read_block_data(FlushHandle& handle, const BlockHeader& block, StaticBufferSink& sink) noexcept;
+        std::span<const unsigned char> _disk_read_block_owned(std::size_t flush, FlushHandle& handle, const BlockHeader& block, ct::vector<unsigned char>& buffer) noexcept;
+        std::span<const unsigned char> _disk_read_block_cached(std::size_t flush, FlushHandle& handle, std::size_t off, std::size_t compressed, std::size_t decompressed,
+                                                               std::uint16_t flags, std::uint64_t checksum, DiskCache::block& hold) noexcept;
+        bool _disk_verify_block(std::size_t flush, std::size_t off, std::span<const unsigned char> stored, std::uint16_t flags, std::uint64_t checksum) noexcept;
+        bool _disk_verify_if() noexcept;
+        std::pair<DataType, std::span<const unsigned char>> _disk_read_sorted_entry(std::span<const unsigned char> block, std::size_t& off, View& sort) noexcept;
+        bool _disk_find_sorted_entry(PageCursor& cursor, key_type key, const View& sort) noexcept;
+        bool _disk_find_unary_entry(PageCursor& cursor, key_type key) noexcept;
 
         std::size_t _read_entry_size_impl(const View& view, DataType type) noexcept;
         std::size_t _read_entry_impl(const View& view, DataType type, field_bitmap& fields, const read_callback& callback) noexcept;
-        std::size_t _read_cache_impl(write_store& map, key_type key, const View& sort, field_bitmap& fields, const read_callback& callback) noexcept;
+        std::size_t _read_entry_impl(RuntimeSchemaReflection::RTSI& info, const View& view, DataType type, field_bitmap& fields,
+                                     const read_callback& callback) noexcept;
+        // Number of fields read, nullopt if the row was removed (older layers must not be searched)
+        std::optional<std::size_t> _read_cache_impl(write_store& map, key_type key, const View& sort, field_bitmap& fields, const read_callback& callback) noexcept;
+        std::optional<std::size_t> _read_cache_shared_impl(const write_store& map, RuntimeSchemaReflection::RTSI& info, key_type key, const View& sort,
+                                            field_bitmap& fields, const read_callback& callback) noexcept;
 
         bool _read_impl(key_type key, const View& sort, field_bitmap fields, const read_callback& callback) noexcept;
+        std::optional<bool> _read_shared_impl(key_type key, const View& sort, field_bitmap fields, const read_callback& callback, bool segments) noexcept;
 
-        std::tuple<std::size_t, View, View> _page_map(write_store::iterator map, key_type key, const View& sort, std::size_t count) noexcept;
-        std::tuple<std::size_t, View, View> _page_disk(key_type key, const View& sort, std::size_t count, FlushHandle& handle) noexcept;
+        bool _page_fill(PageCursor& cursor) noexcept;
+        std::uint64_t _page_load_block(PageCursor& cursor) noexcept;
+        bool _page_seek(PageCursor& cursor, key_type key, const View& sort) noexcept;
+        bool _page_seek(PageCursor& cursor, const PartitionHeader& partition, const View& sort) noexcept;
+        bool _page_next(PageCursor& cursor) noexcept;
 
-        write_store::iterator _create_partition_log_if(write_store& map, key_type key, const View& partition) noexcept;
+        void _log_partition_if(const write_store& map, key_type key, const View& partition) noexcept;
         write_store::iterator _create_partition_if(write_store& map, key_type key, const View& partition) noexcept;
         write_store::iterator _find_partition(write_store& map, key_type key) noexcept;
 
@@ -217,6 +433,8 @@ namespace rdb
         slot _find_unsorted_slot(write_store::iterator partition);
         slot _find_slot(write_store::iterator partition, const View& sort);
 
+        std::size_t _slot_capacity(std::size_t size) const noexcept;
+        slot _grow_slot(SlotDeleter alloc, slot ptr, std::size_t size) noexcept;
         slot _resize_sorted_slot(write_store::iterator partition, const View& sort, std::size_t size);
         slot _resize_unsorted_slot(write_store::iterator partition, std::size_t size);
         slot _resize_slot(write_store::iterator partition, const View& sort, std::size_t size);
@@ -225,6 +443,7 @@ namespace rdb
         lock_type _emplace_unsorted_lock_if(lock_store::iterator partition);
         lock_type _emplace_lock_if(key_type key, const View& sort);
 
+        slot _write_field_impl(write_store::iterator partition, const View& sort, slot slot, std::span<const unsigned char> data) noexcept;
         void _write_impl(write_store::iterator partition, WriteType type, const View& sort, std::span<const unsigned char> data) noexcept;
         void _reset_impl(write_store::iterator partition, const View& sort) noexcept;
         void _remove_impl(write_store::iterator partition, const View& sort) noexcept;
@@ -233,22 +452,48 @@ namespace rdb
         bool _bloom_may_contain(key_type key, std::size_t off, FlushHandle& handle) const noexcept;
         std::size_t _bloom_bits(std::size_t keys, float probability) const noexcept;
         std::size_t _bloom_hashes(std::size_t bits, std::size_t keys) const noexcept;
+        std::size_t _bloom_blocks(std::size_t bits) const noexcept;
         std::pair<key_type, key_type> _hash_pair(key_type key) const noexcept;
+        bool _bloom_blocked_may_contain(key_type key, const unsigned char* buffer, std::size_t blocks) const noexcept;
 
-        void _bloom_impl(const write_store& map, Mapper& bloom, int id) noexcept;
+        std::span<unsigned char> _bloom_impl(std::size_t keys, Mapper& bloom, int id) noexcept;
         void _bloom_round_impl(key_type key, unsigned char* buffer, std::size_t space, std::size_t bits) noexcept;
+        void _bloom_blocked_round_impl(key_type key, unsigned char* buffer, std::size_t blocks) noexcept;
+        void _bloom_align_impl(Mapper& bloom) noexcept;
 
-        std::size_t _bloom_intra_partition_begin_impl(write_store::const_iterator partition, Mapper& bloom, int id) noexcept;
-        void _bloom_intra_partition_round_impl(write_store::const_iterator part, const View& key, std::size_t bits, Mapper& bloom, int id) noexcept;
-        void _bloom_intra_partition_end_impl(write_store::const_iterator partition, std::size_t bits, Mapper& bloom, int id) noexcept;
-        void _data_impl(const write_store& map, Mapper& data, Mapper& indexer, Mapper& bloom, int id) noexcept;
+        std::size_t _bloom_intra_partition_begin_impl(std::size_t size, Mapper& bloom, int id) noexcept;
+        void _bloom_intra_partition_round_impl(const View& key, std::size_t bits, Mapper& bloom) noexcept;
+        void _bloom_intra_partition_end_impl(std::size_t bits, Mapper& bloom, int id) noexcept;
+        void _data_impl(const write_store& map, FlushWriter& writer, int id) noexcept;
+        void _data_compress_impl(FlushItem& item) noexcept;
+
+        bool _segment_index_read(std::size_t flush, ct::vector<key_type>& keys) noexcept;
+        void _segment_index_sync() noexcept;
+        const ct::vector<SegmentIndex::Candidate>& _segment_index_find(key_type key) noexcept;
 
         void _data_close_impl(Mapper& data) noexcept;
         void _indexer_close_impl(Mapper& indexer) noexcept;
         void _bloom_close_impl(Mapper& bloom) noexcept;
+        void _segment_index_close_impl(Mapper& keys) noexcept;
 
-        void _flush_impl(const write_store& data, int id) noexcept;
+        void _flush_impl(const write_store& data, const std::filesystem::path& path, int id) noexcept;
+        void _flush_commit_impl(std::size_t id, std::size_t pressure) noexcept;
+        void _flush_queue(std::shared_ptr<write_store> map, std::size_t id, std::size_t pressure) noexcept;
+        void _flush_requeue() noexcept;
+        void _flush_stop() noexcept;
         void _flush_if() noexcept;
+        float _stall_level() const noexcept;
+        float _stall_update() noexcept;
+
+        void _scrub_impl() noexcept;
+        void _scrub_if() noexcept;
+
+        void _compaction_merge_impl(write_store::iterator partition, const View& sort, DataType type, std::span<const unsigned char> data) noexcept;
+        bool _compaction_next(PageCursor& cursor) noexcept;
+        std::optional<bool> _compaction_impl(const ct::vector<std::size_t>& flushes, bool drop) noexcept;
+        void _compaction_join_if(bool wait = false) noexcept;
+        void _compaction_if() noexcept;
+        void _compaction_commit_if() noexcept;
 
         void _move(MemoryCache&& copy) noexcept;
     public:
@@ -257,7 +502,7 @@ namespace rdb
             return Origin();
         }
 
-        MemoryCache(Shared shared, std::size_t core, schema_type schema);
+        MemoryCache(Shared shared, std::size_t core, schema_type schema, DiskCache* disk_cache = nullptr, PageCache* page_cache = nullptr);
         MemoryCache(const MemoryCache&) = delete;
         MemoryCache(MemoryCache&& copy)
         {
@@ -266,18 +511,39 @@ namespace rdb
         ~MemoryCache();
 
         std::size_t core() const noexcept;
+        // Memory held by the current memtable, excluding memtables that are being flushed (bytes)
         std::size_t pressure() const noexcept;
+        // Memory held by the memtables that are being flushed (bytes)
+        std::size_t flush_pressure() const noexcept;
+        // Nothing is flushed, compacted or scrubbed and no compaction waits to be swapped in (a finished one is swapped in)
+        bool idle() noexcept;
+        WriteStall stall() const noexcept;
+        // Delay owed by the next write, zero admits it, one holds it until a pending flush is committed
+        float stall_level() noexcept;
         std::size_t descriptors() const noexcept;
+        // Number of held key locks
+        std::size_t locks() const noexcept;
+        const DiskCache& disk_cache() const noexcept;
+        const PageCache* page_cache() const noexcept;
+        const SegmentIndex& segment_index() const noexcept;
 
         View page(key_type key, std::size_t count) noexcept;
         View page_from(key_type key, const View& sort, std::size_t count) noexcept;
         bool read(key_type key, const View& sort, field_bitmap fields, const read_callback& callback) noexcept;
         bool exists(key_type key, const View& sort) noexcept;
+        // Reads the memtables from any thread (if concurrent reads are enabled)
+        // Returns nullopt without invoking the callback unless the memtables hold every field or removed the row, the owner core has to finish the read
+        std::optional<bool> read_shared(key_type key, const View& sort, field_bitmap fields, const read_callback& callback) noexcept;
+        std::optional<bool> exists_shared(key_type key, const View& sort) noexcept;
+        // Reads the memtables and the flushed segments from a core that stole the read (if concurrent reads are enabled)
+        // The disk and page caches of the owner core are bypassed, returns nullopt if the owner core has to run the read
+        std::optional<bool> read_stolen(key_type key, const View& sort, field_bitmap fields, const read_callback& callback) noexcept;
+        std::optional<bool> exists_stolen(key_type key, const View& sort) noexcept;
 
         void write(WriteType type, key_type key, const View& partition, const View& sort, std::span<const unsigned char> data,
                    Origin origin) noexcept;
         void reset(key_type key, const View& partition, const View& sort, Origin origin) noexcept;
-        void remove(key_type key, const View& sort, Origin origin) noexcept;
+        void remove(key_type key, const View& partition, const View& sort, Origin origin) noexcept;
 
         Lock lock(key_type key, const View& sort, Origin origin) noexcept;
         bool unlock(key_type key, const View& sort, Origin origin) noexcept;
@@ -286,6 +552,8 @@ namespace rdb
         void sync() noexcept;
         void flush() noexcept;
         void clear() noexcept;
+        // Syncs the log records of every write received so far
+        void sync_logs() noexcept;
 
         MemoryCache& operator=(const MemoryCache&) = delete;
         MemoryCache& operator=(MemoryCache&& copy)
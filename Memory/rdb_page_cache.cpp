@@ -0,0 +1,112 @@
+#include <rdb_page_cache.hpp>
+#include <rdb_locale.hpp>
+#include <algorithm>
+
+namespace rdb
+{
+    std::size_t PageCache::Entry::size() const noexcept
+    {
+        return sort.size() + data.size() + sizeof(Entry);
+    }
+
+    void PageCache::_erase(entry_list::iterator entry) noexcept
+    {
+        auto& list = _partitions[entry->partition];
+        list.erase(std::find(list.begin(), list.end(), entry));
+        if (list.empty())
+            _partitions.erase(entry->partition);
+        _volume -= entry->size();
+        _entries.erase(entry);
+    }
+    void PageCache::_evict(std::size_t required) noexcept
+    {
+        while (!_entries.empty() && _volume + required > _max_volume)
+            _erase(std::prev(_entries.end()));
+    }
+
+    std::size_t PageCache::volume() const noexcept
+    {
+        return _volume;
+    }
+    std::size_t PageCache::max_volume() const noexcept
+    {
+        return _max_volume;
+    }
+    std::size_t PageCache::hits() const noexcept
+    {
+        return _hits;
+    }
+    std::size_t PageCache::misses() const noexcept
+    {
+        return _misses;
+    }
+
+    std::optional<View> PageCache::find(schema_type schema, key_type key, const View& sort, std::size_t count) noexcept
+    {
+        if (const auto f = _partitions.find(PageCache::key(schema, key)); f != _partitions.end())
+        {
+            // Hot partitions only see a handful of distinct requests
+            for (const auto it : f->second)
+            {
+                if (it->count == count &&
+                    it->bounded == (sort != nullptr) &&
+                    (!it->bounded || byte::binary_compare(it->sort, sort) == 0))
+                {
+                    _entries.splice(_entries.begin(), _entries, it);
+                    _hits++;
+                    return it->data;
+                }
+            }
+        }
+        _misses++;
+        return std::nullopt;
+    }
+    void PageCache::insert(schema_type schema, key_type key, const View& sort, std::size_t count, const View& data) noexcept
+    {
+        Entry entry{
+            .partition = PageCache::key(schema, key),
+            .bounded = sort != nullptr,
+            .count = count,
+            .data = data
+        };
+        if (entry.bounded)
+            entry.sort.assign(sort.data().begin(), sort.data().end());
+
+        const auto size = entry.size();
+        if (size > _max_volume)
+            return;
+
+        _evict(size);
+        _volume += size;
+        _entries.push_front(std::move(entry));
+        _partitions[_entries.front().partition].push_back(_entries.begin());
+    }
+    void PageCache::invalidate(schema_type schema, key_type key) noexcept
+    {
+        if (const auto f = _partitions.find(PageCache::key(schema, key)); f != _partitions.end())
+        {
+            for (const auto it : f->second)
+            {
+                _volume -= it->size();
+                _entries.erase(it);
+            }
+            _partitions.erase(f);
+        }
+    }
+    void PageCache::clear(schema_type schema) noexcept
+    {
+        for (auto it = _entries.begin(); it != _entries.end();)
+        {
+            if (it->partition.first == schema)
+                _erase(it++);
+            else
+                ++it;
+        }
+    }
+    void PageCache::clear() noexcept
+    {
+        _entries.clear();
+        _partitions.clear();
+        _volume = 0;
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef RDB_PAGE_CACHE_HPP
+#define RDB_PAGE_CACHE_HPP
+
+#include <rdb_keytype.hpp>
+#include <rdb_containers.hpp>
+#include <rdb_utils.hpp>
+#include <optional>
+#include <memory>
+#include <list>
+
+namespace rdb
+{
+    // Caches the results of page requests for hot partitions
+    // Keyed by the schema, the partition, the starting sorting key and the count
+    // Every entry of a partition is dropped whenever the partition is written to
+    //
+    // It is owned by a core and shared by the memory caches of its schemas, it is therefore not synchronized
+    class PageCache
+    {
+    public:
+        using ptr = std::unique_ptr<PageCache>;
+    private:
+        // Schema | partition
+        using key = std::pair<schema_type, key_type>;
+
+        struct Entry
+        {
+            key partition{};
+            // Empty (and unbounded) for pages from the start of the partition
+            ct::vector<unsigned char> sort{};
+            bool bounded{ false };
+            std::size_t count{ 0 };
+            View data{ nullptr };
+
+            std::size_t size() const noexcept;
+        };
+        using entry_list = std::list<Entry>;
+
+        // Most recent first
+        entry_list _entries{};
+        ct::hash_map<key, ct::vector<entry_list::iterator>> _partitions{};
+
+        std::size_t _volume{ 0 };
+        std::size_t _max_volume{ 0 };
+        std::size_t _hits{ 0 };
+        std::size_t _misses{ 0 };
+
+        void _erase(entry_list::iterator entry) noexcept;
+        void _evict(std::size_t required) noexcept;
+    public:
+        explicit PageCache(std::size_t volume) noexcept
+            : _max_volume(volume) {}
+        PageCache(const PageCache&) = delete;
+        PageCache(PageCache&&) = delete;
+
+        std::size_t volume() const noexcept;
+        std::size_t max_volume() const noexcept;
+        std::size_t hits() const noexcept;
+        std::size_t misses() const noexcept;
+
+        std::optional<View> find(schema_type schema, key_type key, const View& sort, std::size_t count) noexcept;
+        void insert(schema_type schema, key_type key, const View& sort, std::size_t count, const View& data) noexcept;
+        void invalidate(schema_type schema, key_type key) noexcept;
+        // Drops every entry of the schema
+        void clear(schema_type schema) noexcept;
+        void clear() noexcept;
+
+        PageCache& operator=(const PageCache&) = delete;
+        PageCache& operator=(PageCache&&) = delete;
+    };
+}
+
+#endif // RDB_PAGE_CACHE_HPP
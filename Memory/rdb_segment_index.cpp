@@ -0,0 +1,109 @@
+#include <rdb_segment_index.hpp>
+#include <algorithm>
+
+namespace rdb
+{
+    SegmentIndex::SegmentIndex(std::size_t volume) noexcept :
+        _volume(volume)
+    {}
+
+    std::uint32_t SegmentIndex::_fingerprint(key_type key) noexcept
+    {
+        // Keys are already hashes, the multiplication only spreads sequential ones
+        return static_cast<std::uint32_t>((key * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+    std::size_t SegmentIndex::_footprint(const Segment& segment) noexcept
+    {
+        return sizeof(Segment) + segment.fingerprints.capacity() * sizeof(std::uint32_t);
+    }
+    void SegmentIndex::_insert_impl(Segment segment) noexcept
+    {
+        erase(segment.flush);
+        _memory += _footprint(segment);
+        _segments.insert(
+            std::upper_bound(_segments.begin(), _segments.end(), segment.flush,
+                [](std::size_t flush, const Segment& it) { return flush < it.flush; }),
+            std::move(segment)
+        );
+    }
+
+    std::size_t SegmentIndex::size() const noexcept
+    {
+        return _segments.size();
+    }
+    std::size_t SegmentIndex::memory() const noexcept
+    {
+        return _memory;
+    }
+
+    bool SegmentIndex::insert(std::size_t flush, std::span<const key_type> keys) noexcept
+    {
+        Segment segment;
+        segment.flush = flush;
+        if (keys.empty())
+        {
+            // Nothing can match
+            segment.max = 0;
+            segment.min = 1;
+            segment.filtered = true;
+            _insert_impl(std::move(segment));
+            return true;
+        }
+
+        // Older key lists were not written in order
+        const auto [ min, max ] = std::minmax_element(keys.begin(), keys.end());
+        segment.min = *min;
+        segment.max = *max;
+        if (_memory + sizeof(Segment) + keys.size() * sizeof(std::uint32_t) <= _volume)
+        {
+            segment.fingerprints.reserve(keys.size());
+            for (decltype(auto) key : keys)
+                segment.fingerprints.push_back(_fingerprint(key));
+            std::sort(segment.fingerprints.begin(), segment.fingerprints.end());
+            segment.fingerprints.erase(
+                std::unique(segment.fingerprints.begin(), segment.fingerprints.end()),
+                segment.fingerprints.end()
+            );
+            segment.fingerprints.shrink_to_fit();
+            segment.filtered = true;
+        }
+        const auto filtered = segment.filtered;
+        _insert_impl(std::move(segment));
+        return filtered;
+    }
+    void SegmentIndex::insert_unindexed(std::size_t flush) noexcept
+    {
+        Segment segment;
+        segment.flush = flush;
+        _insert_impl(std::move(segment));
+    }
+    void SegmentIndex::erase(std::size_t flush) noexcept
+    {
+        const auto it = std::lower_bound(_segments.begin(), _segments.end(), flush,
+            [](const Segment& it, std::size_t flush) { return it.flush < flush; });
+        if (it == _segments.end() || it->flush != flush)
+            return;
+        _memory -= _footprint(*it);
+        _segments.erase(it);
+    }
+    void SegmentIndex::clear() noexcept
+    {
+        _segments.clear();
+        _memory = 0;
+    }
+
+    void SegmentIndex::find(key_type key, ct::vector<Candidate>& out) const noexcept
+    {
+        out.clear();
+        const auto fingerprint = _fingerprint(key);
+        for (auto it = _segments.rbegin(); it != _segments.rend(); ++it)
+        {
+            if (key < it->min || key > it->max)
+                continue;
+            if (!it->filtered)
+                out.push_back({ it->flush, false });
+            else if (std::binary_search(it->fingerprints.begin(), it->fingerprints.end(), fingerprint))
+                out.push_back({ it->flush, true });
+        }
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef RDB_SEGMENT_INDEX_HPP
+#define RDB_SEGMENT_INDEX_HPP
+
+#include <rdb_keytype.hpp>
+#include <rdb_containers.hpp>
+#include <span>
+
+namespace rdb
+{
+    // Maps partition keys to the flushes that may contain them
+    // So that a lookup only opens the segments it needs (instead of probing every bloom filter)
+    //
+    // Every flush is summarized by its key range (fences) and the sorted 32-bit fingerprints of its keys
+    // Fingerprints are built from the key list persisted next to the data, as long as they fit in the volume
+    // A flush without them (missing key list or over the volume) is a candidate for every key within its fences
+    // It is owned by a single memory cache and is therefore not synchronized
+    class SegmentIndex
+    {
+    public:
+        struct Candidate
+        {
+            std::size_t flush{ 0 };
+            // The fingerprints matched, the bloom filter of the flush has nothing to add
+            bool filtered{ false };
+        };
+    private:
+        struct Segment
+        {
+            std::size_t flush{ 0 };
+            key_type min{ 0 };
+            key_type max{ ~key_type(0) };
+            ct::vector<std::uint32_t> fingerprints{};
+            bool filtered{ false };
+        };
+
+        // Flush ids in ascending order
+        ct::vector<Segment> _segments{};
+        std::size_t _volume{ 0 };
+        std::size_t _memory{ 0 };
+
+        static std::uint32_t _fingerprint(key_type key) noexcept;
+        static std::size_t _footprint(const Segment& segment) noexcept;
+        void _insert_impl(Segment segment) noexcept;
+    public:
+        explicit SegmentIndex(std::size_t volume = ~std::size_t(0)) noexcept;
+        SegmentIndex(const SegmentIndex&) = delete;
+        SegmentIndex(SegmentIndex&&) = default;
+
+        // Number of indexed flushes
+        std::size_t size() const noexcept;
+        // Memory held by the fences and fingerprints (bytes)
+        std::size_t memory() const noexcept;
+
+        // Returns whether the keys were fingerprinted (false when over the volume)
+        bool insert(std::size_t flush, std::span<const key_type> keys) noexcept;
+        void insert_unindexed(std::size_t flush) noexcept;
+        void erase(std::size_t flush) noexcept;
+        void clear() noexcept;
+
+        // Candidate flushes for the key, newest first
+        void find(key_type key, ct::vector<Candidate>& out) const noexcept;
+
+        SegmentIndex& operator=(const SegmentIndex&) = delete;
+        SegmentIndex& operator=(SegmentIndex&&) = default;
+    };
+}
+
+#endif // RDB_SEGMENT_INDEX_HPP
@@ -0,0 +1,66 @@
+#include <rdb_write_buffer.hpp>
+#include <algorithm>
+
+namespace rdb
+{
+    std::size_t WriteBuffer::budget() const noexcept
+    {
+        return _budget;
+    }
+    std::size_t WriteBuffer::active() const noexcept
+    {
+        return _active.load(std::memory_order::relaxed);
+    }
+    std::size_t WriteBuffer::flushing() const noexcept
+    {
+        return _flushing.load(std::memory_order::relaxed);
+    }
+    std::size_t WriteBuffer::usage() const noexcept
+    {
+        return active() + flushing();
+    }
+    std::size_t WriteBuffer::caches() const noexcept
+    {
+        return _caches.load(std::memory_order::relaxed);
+    }
+
+    void WriteBuffer::attach() noexcept
+    {
+        _caches.fetch_add(1, std::memory_order::relaxed);
+    }
+    void WriteBuffer::detach() noexcept
+    {
+        _caches.fetch_sub(1, std::memory_order::relaxed);
+    }
+    void WriteBuffer::charge(std::ptrdiff_t bytes) noexcept
+    {
+        _active.fetch_add(static_cast<std::size_t>(bytes), std::memory_order::relaxed);
+    }
+    void WriteBuffer::flush(std::size_t bytes) noexcept
+    {
+        _flushing.fetch_add(bytes, std::memory_order::relaxed);
+        _active.fetch_sub(bytes, std::memory_order::relaxed);
+    }
+    void WriteBuffer::commit(std::size_t bytes) noexcept
+    {
+        _flushing.fetch_sub(bytes, std::memory_order::relaxed);
+    }
+
+    bool WriteBuffer::exceeded() const noexcept
+    {
+        if (!_budget)
+            return false;
+        // Flushing memory only goes down by itself, act on the active part
+        const auto mutable_limit = _budget / 8 * 7;
+        const auto active = this->active();
+        return
+            active > mutable_limit ||
+            (usage() >= _budget && active >= _budget / 2);
+    }
+    bool WriteBuffer::candidate(std::size_t bytes) const noexcept
+    {
+        // At least the average active memtable, small memtables would only produce tiny flushes
+        const auto caches = std::max<std::size_t>(this->caches(), 1);
+        return bytes != 0 && bytes >= active() / caches;
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef RDB_WRITE_BUFFER_HPP
+#define RDB_WRITE_BUFFER_HPP
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+namespace rdb
+{
+    // Memory held by the memtables of every memory cache of a mount
+    // Memory caches report their usage, the cores flush their largest memtables once the budget is exceeded
+    class WriteBuffer
+    {
+    public:
+        using ptr = std::shared_ptr<WriteBuffer>;
+    private:
+        // Memtables receiving writes
+        std::atomic<std::size_t> _active{ 0 };
+        // Memtables queued or being flushed
+        std::atomic<std::size_t> _flushing{ 0 };
+        std::atomic<std::size_t> _caches{ 0 };
+        std::size_t _budget{ 0 };
+    public:
+        explicit WriteBuffer(std::size_t budget) noexcept
+            : _budget(budget) {}
+        WriteBuffer(const WriteBuffer&) = delete;
+        WriteBuffer(WriteBuffer&&) = delete;
+
+        std::size_t budget() const noexcept;
+        std::size_t active() const noexcept;
+        std::size_t flushing() const noexcept;
+        std::size_t usage() const noexcept;
+        std::size_t caches() const noexcept;
+
+        void attach() noexcept;
+        void detach() noexcept;
+        // Change in memory of an active memtable
+        void charge(std::ptrdiff_t bytes) noexcept;
+        // An active memtable was queued for a flush
+        void flush(std::size_t bytes) noexcept;
+        // A flush was committed and its memtable released
+        void commit(std::size_t bytes) noexcept;
+
+        // Whether the active memtables should be flushed
+        bool exceeded() const noexcept;
+        // Whether a memtable is large enough to be worth flushing to relieve the budget
+        bool candidate(std::size_t bytes) const noexcept;
+
+        WriteBuffer& operator=(const WriteBuffer&) = delete;
+        WriteBuffer& operator=(WriteBuffer&&) = delete;
+    };
+}
+
+#endif // RDB_WRITE_BUFFER_HPP
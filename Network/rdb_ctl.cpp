@@ -105,6 +105,31 @@ namespace rdb
 				std::accumulate(pressures.begin(), pressures.end(), 0)
 			);
 
+			return str;
+		}));
+		expose_procedure<string>("cache.disk", std::function([this](const string& schema) {
+			std::vector<std::array<std::size_t, 3>> stats;
+			std::string str;
+			std::atomic<std::size_t> ctr;
+
+			stats.resize(mnt()->cores());
+			str.reserve(stats.size() * 48);
+
+			mnt()->run(uuid::hash<schema_type>(schema), [&](rdb::MemoryCache* ptr) {
+				const auto& cache = ptr->disk_cache();
+				stats[ptr->core()] = { cache.volume(), cache.hits(), cache.misses() };
+				++ctr;
+			});
+
+			while (ctr != stats.size()) util::spinlock_yield();
+
+			for (std::size_t i = 0; i < stats.size(); i++)
+				str += std::format("Core{}: {}b {} hits {} misses\n", i, stats[i][0], stats[i][1], stats[i][2]);
+			str += std::format(
+				"Total: {}b",
+				std::accumulate(stats.begin(), stats.end(), std::size_t(0), [](std::size_t acc, const auto& it) { return acc + it[0]; })
+			);
+
 			return str;
 		}));
 	}
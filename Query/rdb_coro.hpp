@@ -0,0 +1,311 @@
+#ifndef RDB_CORO_HPP
+#define RDB_CORO_HPP
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <new>
+#include <atomic>
+#include <array>
+#include <rdb_task_ring.hpp>
+
+namespace rdb::coro
+{
+	// Coroutine frames are recycled through thread local free lists (per size class)
+	// Frames freed on another thread simply migrate to its lists
+	class FramePool
+	{
+	private:
+		static constexpr auto _granularity = 64;
+		static constexpr auto _classes = 32;
+		static constexpr auto _max_cached = 1024;
+
+		struct Node
+		{
+			Node* next{ nullptr };
+		};
+		struct Lists
+		{
+			std::array<Node*, _classes> heads{};
+			std::array<std::size_t, _classes> counts{};
+
+			~Lists()
+			{
+				for (auto head : heads)
+				{
+					while (head)
+					{
+						auto next = head->next;
+						::operator delete(head);
+						head = next;
+					}
+				}
+			}
+		};
+
+		static Lists& _lists() noexcept
+		{
+			thread_local Lists lists{};
+			return lists;
+		}
+		static constexpr std::size_t _class(std::size_t size) noexcept
+		{
+			return (size + _granularity - 1) / _granularity - 1;
+		}
+	public:
+		// Throws std::bad_alloc like the default frame allocation
+		static void* allocate(std::size_t size)
+		{
+			const auto cls = _class(size);
+			[[ unlikely ]] if (cls >= _classes)
+				return ::operator new(size);
+
+			auto& lists = _lists();
+			if (auto node = lists.heads[cls]; node)
+			{
+				lists.heads[cls] = node->next;
+				lists.counts[cls]--;
+				return node;
+			}
+			return ::operator new((cls + 1) * _granularity);
+		}
+		static void deallocate(void* ptr, std::size_t size) noexcept
+		{
+			const auto cls = _class(size);
+			auto& lists = _lists();
+			[[ unlikely ]] if (cls >= _classes || lists.counts[cls] >= _max_cached)
+			{
+				::operator delete(ptr);
+				return;
+			}
+			auto node = new (ptr) Node{ lists.heads[cls] };
+			lists.heads[cls] = node;
+			lists.counts[cls]++;
+		}
+	};
+
+	class Loop;
+
+	template<typename Type = void>
+	class Task;
+
+	namespace impl
+	{
+		struct PromiseBase
+		{
+			std::coroutine_handle<> continuation{ nullptr };
+			// Set for detached tasks, the frame is destroyed once it finishes
+			Loop* loop{ nullptr };
+
+			struct FinalAwaiter
+			{
+				bool await_ready() const noexcept { return false; }
+				template<typename Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept;
+				void await_resume() const noexcept {}
+			};
+
+			static void* operator new(std::size_t size)
+			{
+				return FramePool::allocate(size);
+			}
+			static void operator delete(void* ptr, std::size_t size) noexcept
+			{
+				FramePool::deallocate(ptr, size);
+			}
+
+			std::suspend_always initial_suspend() const noexcept { return {}; }
+			FinalAwaiter final_suspend() const noexcept { return {}; }
+			void unhandled_exception() const noexcept { std::terminate(); }
+		};
+	}
+
+	// Resumes coroutines whose queries completed on the thread that runs it
+	// Queries can only be awaited by coroutines running on a loop
+	class Loop
+	{
+	private:
+		friend struct impl::PromiseBase;
+
+		ct::TaskRing<std::coroutine_handle<>, 1024> _ready{};
+		std::atomic<std::size_t> _tasks{ 0 };
+
+		static Loop*& _current() noexcept
+		{
+			thread_local Loop* loop{ nullptr };
+			return loop;
+		}
+		// Tasks finish on the loop thread, no need to wake it up
+		void _finish() noexcept
+		{
+			--_tasks;
+		}
+	public:
+		Loop() = default;
+		Loop(const Loop&) = delete;
+		Loop(Loop&&) = delete;
+
+		static Loop* current() noexcept
+		{
+			return _current();
+		}
+
+		// Starts a task owned by the loop (must be called on the loop thread)
+		inline void spawn(Task<void> task) noexcept;
+		void post(std::coroutine_handle<> handle) noexcept
+		{
+			_ready.enqueue(handle);
+		}
+		// Runs until every spawned task finishes
+		void run() noexcept
+		{
+			auto* prev = std::exchange(_current(), this);
+			std::coroutine_handle<> handle{};
+			while (_tasks.load() && _ready.dequeue(handle))
+				handle.resume();
+			_current() = prev;
+		}
+
+		Loop& operator=(const Loop&) = delete;
+		Loop& operator=(Loop&&) = delete;
+	};
+
+	template<typename Type>
+	class Task
+	{
+	public:
+		struct promise_type : impl::PromiseBase
+		{
+			std::optional<Type> value{};
+
+			Task get_return_object() noexcept
+			{
+				return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+			template<typename Value>
+			void return_value(Value&& result) noexcept
+			{
+				value.emplace(std::forward<Value>(result));
+			}
+		};
+	private:
+		friend class Loop;
+
+		std::coroutine_handle<promise_type> _handle{ nullptr };
+	public:
+		Task() = default;
+		explicit Task(std::coroutine_handle<promise_type> handle) noexcept
+			: _handle(handle) {}
+		Task(const Task&) = delete;
+		Task(Task&& copy) noexcept
+			: _handle(std::exchange(copy._handle, nullptr)) {}
+		~Task()
+		{
+			if (_handle)
+				_handle.destroy();
+		}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle) noexcept
+		{
+			_handle.promise().continuation = handle;
+			return _handle;
+		}
+		Type await_resume() noexcept
+		{
+			return std::move(*_handle.promise().value);
+		}
+
+		Task& operator=(const Task&) = delete;
+		Task& operator=(Task&& copy) noexcept
+		{
+			if (this != &copy)
+			{
+				if (_handle)
+					_handle.destroy();
+				_handle = std::exchange(copy._handle, nullptr);
+			}
+			return *this;
+		}
+	};
+	template<>
+	class Task<void>
+	{
+	public:
+		struct promise_type : impl::PromiseBase
+		{
+			Task get_return_object() noexcept
+			{
+				return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+			void return_void() const noexcept {}
+		};
+	private:
+		friend class Loop;
+
+		std::coroutine_handle<promise_type> _handle{ nullptr };
+	public:
+		Task() = default;
+		explicit Task(std::coroutine_handle<promise_type> handle) noexcept
+			: _handle(handle) {}
+		Task(const Task&) = delete;
+		Task(Task&& copy) noexcept
+			: _handle(std::exchange(copy._handle, nullptr)) {}
+		~Task()
+		{
+			if (_handle)
+				_handle.destroy();
+		}
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<> handle) noexcept
+		{
+			_handle.promise().continuation = handle;
+			return _handle;
+		}
+		void await_resume() const noexcept {}
+
+		Task& operator=(const Task&) = delete;
+		Task& operator=(Task&& copy) noexcept
+		{
+			if (this != &copy)
+			{
+				if (_handle)
+					_handle.destroy();
+				_handle = std::exchange(copy._handle, nullptr);
+			}
+			return *this;
+		}
+	};
+
+	template<typename Promise>
+	std::coroutine_handle<> impl::PromiseBase::FinalAwaiter::await_suspend(std::coroutine_handle<Promise> handle) noexcept
+	{
+		auto& promise = handle.promise();
+		if (promise.continuation)
+			return promise.continuation;
+		if (auto* loop = promise.loop; loop)
+		{
+			handle.destroy();
+			loop->_finish();
+		}
+		return std::noop_coroutine();
+	}
+
+	inline void Loop::spawn(Task<void> task) noexcept
+	{
+		auto handle = std::exchange(task._handle, nullptr);
+		handle.promise().loop = this;
+		++_tasks;
+		post(handle);
+	}
+}
+
+#endif // RDB_CORO_HPP
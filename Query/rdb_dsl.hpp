@@ -9,6 +9,7 @@
 #include <rdb_reflect.hpp>
 #include <rdb_utils.hpp>
 #include <rdb_qop.hpp>
+#include <rdb_coro.hpp>
 
 namespace rdb
 {
@@ -16,6 +17,8 @@ namespace rdb
 	{
 		Async = 1 << 0,
 		Atomic = 1 << 1,
+		// Returns an awaitable resumed once the query completes, it has to be awaited on a coro::Loop
+		Await = 1 << 2,
 	};
 
 	template<typename Schema>
@@ -449,6 +452,113 @@ namespace rdb
 			}
 		};
 
+		// Batches
+
+		template<typename Schema, cmp::ConstString... Fields>
+		struct MultiFetch : EvalTrait, Operand<qOp::MultiFetch>
+		{
+			static constexpr std::array<unsigned char, sizeof...(Fields)> fields{
+				static_cast<unsigned char>(Schema::template index_of<Fields>())...
+			};
+
+			// Key index | field | value (missing keys and fields are skipped)
+			std::function<void(std::size_t, std::size_t, View)> callback{};
+			std::span<const compound_key> keys{};
+
+			constexpr auto extract()
+			{
+				return [op = *this](std::size_t, std::span<const unsigned char> buffer) {
+					op.eval(buffer);
+				};
+			}
+			constexpr auto size() const noexcept
+			{
+				std::size_t size =
+					sizeof(schema_type) +
+					sizeof(std::uint8_t) +
+					fields.size() +
+					sizeof(std::uint32_t);
+				for (decltype(auto) it : keys)
+					size += it.first.size() + it.second.size();
+				return size;
+			}
+			constexpr auto fill(std::span<unsigned char> buffer) noexcept
+			{
+				std::size_t off = 0;
+				off += byte::swrite<schema_type>(buffer, off, Schema::ucode);
+				buffer[off++] = static_cast<unsigned char>(fields.size());
+				for (const auto field : fields)
+					buffer[off++] = field;
+				off += byte::swrite<std::uint32_t>(buffer, off, keys.size());
+				for (decltype(auto) it : keys)
+				{
+					off += byte::swrite(buffer, off, it.first.data());
+					off += byte::swrite(buffer, off, it.second.data());
+				}
+				return off;
+			}
+			// Results of a single core, laid out contiguously
+			constexpr auto eval(std::span<const unsigned char> buffer) const noexcept
+			{
+				RuntimeSchemaReflection::RTSI& info =
+					RuntimeSchemaReflection::info(Schema::ucode);
+				std::size_t off = 0;
+				while (off < buffer.size())
+				{
+					const auto idx = byte::sread<std::uint32_t>(buffer, off);
+					const auto field = buffer[off++];
+					const auto len = info.reflect(field).storage(buffer.data() + off);
+					callback(idx, field, View::view(buffer.subspan(off, len)));
+					off += len;
+				}
+				return off;
+			}
+		};
+
+		template<typename Schema, cmp::ConstString Field, typename Value>
+		struct MultiWrite : ExtractNothing, Operand<qOp::MultiWrite>
+		{
+			using type = Schema::template interface<Field>;
+
+			static constexpr auto field = *Field;
+
+			std::span<const compound_key> keys{};
+			std::span<const Value> values{};
+
+			constexpr auto size() const noexcept
+			{
+				static_assert(Schema::data::template has<Field>, "Cannot write to a key field");
+				std::size_t size =
+					sizeof(schema_type) +
+					sizeof(std::uint32_t);
+				for (std::size_t i = 0; i < keys.size(); i++)
+				{
+					size +=
+						keys[i].first.size() +
+						keys[i].second.size() +
+						sizeof(std::uint32_t) +
+						sizeof(std::uint8_t) +
+						type::mstorage(values[i]);
+				}
+				return size;
+			}
+			constexpr auto fill(std::span<unsigned char> buffer) noexcept
+			{
+				std::size_t off = 0;
+				off += byte::swrite<schema_type>(buffer, off, Schema::ucode);
+				off += byte::swrite<std::uint32_t>(buffer, off, keys.size());
+				for (std::size_t i = 0; i < keys.size(); i++)
+				{
+					off += byte::swrite(buffer, off, keys[i].first.data());
+					off += byte::swrite(buffer, off, keys[i].second.data());
+					off += byte::swrite<std::uint32_t>(buffer, off, type::mstorage(values[i]));
+					buffer[off++] = static_cast<std::uint8_t>(Schema::template index_of<Field>());
+					off += type::minline(buffer.subspan(off), values[i]);
+				}
+				return off;
+			}
+		};
+
 		// Mutants
 
 		template<typename Op>
@@ -860,6 +970,27 @@ namespace rdb
 		};
 	}
 
+	// Reads the fields of many keys, dispatched as a single task per core
+	template<typename Schema, cmp::ConstString... Fields, typename Func>
+	constexpr auto multi_fetch(std::span<const cmd::compound_key> keys, Func&& func) noexcept
+	{
+		return cmd::MultiFetch<Schema, Fields...>{
+			.callback = std::forward<Func>(func),
+			.keys = keys
+		};
+	}
+
+	// Writes a field of many keys (one value per key), dispatched as a single task per core
+	template<typename Schema, cmp::ConstString Field, typename Values>
+	constexpr auto multi_write(std::span<const cmd::compound_key> keys, const Values& values) noexcept
+	{
+		using value = std::decay_t<decltype(*std::data(values))>;
+		return cmd::MultiWrite<Schema, Field, value>{
+			.keys = keys.first(std::min(keys.size(), std::size(values))),
+			.values = std::span<const value>(std::data(values), std::size(values))
+		};
+	}
+
 	template<typename Schema, typename... Argv>
 	constexpr auto page(TableList<Schema>* out, std::size_t count, Argv&&... args) noexcept
 	{
@@ -1102,15 +1233,58 @@ namespace rdb
 			std::pmr::monotonic_buffer_resource handler_resource{ &handler_pool, sizeof(handler_pool) };
 			std::pmr::vector<func_type> handlers{ &handler_resource };
 		};
-	private:
-		static void _sync(std::future<bool> fut = {}) noexcept
+		class Awaitable
 		{
-			thread_local std::future<bool> task{};
-			if (fut.valid())
-				task = std::move(fut);
-			else if (task.valid())
-				task.wait();
-		}
+		private:
+			using state_type = typename Base::AsyncParserState;
+			using qid_type = typename Base::query_log_id;
+
+			Base* _base{ nullptr };
+			state_type* _state{ nullptr };
+			coro::Loop* _loop{ nullptr };
+			std::coroutine_handle<> _handle{ nullptr };
+			std::optional<qid_type> _qid{};
+			bool _result{ false };
+		public:
+			Awaitable(Base* base, state_type* state, std::optional<qid_type> qid) noexcept
+				: _base(base), _state(state), _qid(qid) {}
+			Awaitable(const Awaitable&) = delete;
+			Awaitable(Awaitable&&) = delete;
+			~Awaitable()
+			{
+				// Never awaited
+				if (_state)
+					_base->_query_async_recycle(_state);
+			}
+
+			bool await_ready() const noexcept
+			{
+				return false;
+			}
+			void await_suspend(std::coroutine_handle<> handle) noexcept
+			{
+				_handle = handle;
+				_loop = coro::Loop::current();
+				// Resuming on the core that completes the query would deadlock on a blocking query to that core
+				[[ unlikely ]] if (_loop == nullptr)
+					std::terminate();
+				_base->_query_async_launch(std::exchange(_state, nullptr), [this](bool result)
+				{
+					if (result && _qid.has_value())
+						_base->_resolve_query(*_qid);
+					_result = result;
+					_loop->post(_handle);
+				});
+			}
+			bool await_resume() const noexcept
+			{
+				return _result;
+			}
+
+			Awaitable& operator=(const Awaitable&) = delete;
+			Awaitable& operator=(Awaitable&&) = delete;
+		};
+	private:
 		static std::span<unsigned char> _qbuffer(std::size_t require) noexcept
 		{
 			thread_local std::unique_ptr<unsigned char[]> dynamic_buffer{ nullptr };
@@ -1164,21 +1338,54 @@ namespace rdb
 		{
 			if constexpr (std::is_same_v<std::decay_t<Type>, cmd::Flush>)
 			{
-				_sync();
 				_qbuffer(0);
 				return *this;
 			}
 			else if constexpr (std::is_base_of_v<cmd::ExecuteTrait, std::decay_t<Type>>)
 			{
 				constexpr auto flags = std::decay_t<Type>::flags;
-				if constexpr (flags & unsigned(Policy::Async))
+				if constexpr (flags & unsigned(Policy::Await))
 				{
-					// auto f = static_cast<Base*>(this)->query_async(
-					// 	_qbuffer(~0ull), _build_store(nullptr)
-					// );
-					// _qbuffer(0);
-					// _sync(f);
-					// return f;
+					// Launched once awaited, the packet is copied so the buffer can be reused right away
+					auto* base = static_cast<Base*>(this);
+					std::optional<typename Base::query_log_id> qid{};
+					if constexpr (flags & unsigned(Policy::Atomic))
+						qid = base->_log_query(_qbuffer(~0ull));
+					auto* state = base->_query_async_prepare(
+						_qbuffer(~0ull), _build_store(nullptr)
+					);
+					_qbuffer(0);
+					return Awaitable(base, state, qid);
+				}
+				else if constexpr (flags & unsigned(Policy::Async))
+				{
+					// The packet is copied by the engine so the buffer can be reused right away
+					if constexpr (flags & unsigned(Policy::Atomic))
+					{
+						auto* base = static_cast<Base*>(this);
+						auto promise = std::make_shared<std::promise<bool>>();
+						auto result = promise->get_future();
+						const auto qid = base->_log_query(_qbuffer(~0ull));
+						base->query_async(
+							_qbuffer(~0ull), _build_store(nullptr),
+							[base, qid, promise = std::move(promise)](bool value)
+							{
+								if (value)
+									base->_resolve_query(qid);
+								promise->set_value(value);
+							}
+						);
+						_qbuffer(0);
+						return result;
+					}
+					else
+					{
+						auto result = static_cast<Base*>(this)->query_async(
+							_qbuffer(~0ull), _build_store(nullptr)
+						);
+						_qbuffer(0);
+						return result;
+					}
 				}
 				else
 				{
@@ -1212,7 +1419,6 @@ namespace rdb
 
 				// Writes
 
-				_sync();
 				const auto base_size = cmd::size(cmd);
 				const auto size = base_size +
 					sizeof(OperandFlags) +
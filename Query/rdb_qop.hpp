@@ -43,6 +43,12 @@ namespace rdb::cmd
 		// Mutants
 
 		Invert,
+
+		// Batches (keys grouped per core)
+		// Appended so that the values of logged atomic queries stay stable
+
+		MultiFetch,
+		MultiWrite,
 	};
 }
 
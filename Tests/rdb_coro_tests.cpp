@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include <rdb_coro.hpp>
+#include <vector>
+
+namespace rdb::test
+{
+    // Frame address of the awaiting coroutine, without suspending it
+    struct FrameAddress
+    {
+        void** out{ nullptr };
+
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle) const noexcept
+        {
+            *out = handle.address();
+            return false;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    coro::Task<int> square(int value)
+    {
+        co_return value * value;
+    }
+    coro::Task<void> sum(int count, int& out)
+    {
+        for (int i = 0; i < count; i++)
+            out += co_await square(i);
+    }
+    coro::Task<void> frame(void*& out)
+    {
+        co_await FrameAddress{ &out };
+    }
+
+    TEST(FramePoolTest, ReusesFreedBlocksOfSizeClass)
+    {
+        auto* first = coro::FramePool::allocate(100);
+        coro::FramePool::deallocate(first, 100);
+        // Same size class
+        auto* second = coro::FramePool::allocate(120);
+        EXPECT_EQ(second, first);
+        // Another size class is not served from the freed block
+        auto* other = coro::FramePool::allocate(300);
+        EXPECT_NE(other, first);
+        coro::FramePool::deallocate(other, 300);
+        coro::FramePool::deallocate(second, 120);
+
+        // Oversized frames bypass the lists
+        auto* large = coro::FramePool::allocate(1 << 20);
+        coro::FramePool::deallocate(large, 1 << 20);
+    }
+
+    TEST(FramePoolTest, ReusesFramesOfFinishedCoroutines)
+    {
+        std::vector<void*> frames(3);
+        for (decltype(auto) it : frames)
+        {
+            coro::Loop loop;
+            loop.spawn(frame(it));
+            loop.run();
+        }
+        EXPECT_NE(frames[0], nullptr);
+        EXPECT_EQ(frames[1], frames[0]);
+        EXPECT_EQ(frames[2], frames[0]);
+    }
+
+    TEST(LoopTest, RunsUntilSpawnedTasksFinish)
+    {
+        coro::Loop loop;
+        EXPECT_EQ(coro::Loop::current(), nullptr);
+        int first = 0;
+        int second = 0;
+        loop.spawn(sum(4, first));
+        loop.spawn(sum(6, second));
+        loop.run();
+        EXPECT_EQ(first, 0 + 1 + 4 + 9);
+        EXPECT_EQ(second, 0 + 1 + 4 + 9 + 16 + 25);
+        EXPECT_EQ(coro::Loop::current(), nullptr);
+    }
+}
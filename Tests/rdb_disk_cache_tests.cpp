@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <rdb_disk_cache.hpp>
+
+namespace rdb::test
+{
+    // Every block has the same size, the volume holds three of them
+    class DiskCacheTest : public ::testing::Test
+    {
+    protected:
+        static constexpr std::size_t size = 16;
+        static constexpr schema_type schema = 1;
+
+        static DiskCache::key key(std::size_t off, schema_type owner = schema, std::size_t flush = 0)
+        {
+            return DiskCache::key(owner, flush, off * size);
+        }
+        static DiskCache::block block()
+        {
+            return std::make_shared<const ct::vector<unsigned char>>(size);
+        }
+        static DiskCache::ptr make(Config::Cache::Type type)
+        {
+            return DiskCache::make(type, size * 3);
+        }
+        static void insert(DiskCache& cache, std::initializer_list<std::size_t> offs)
+        {
+            for (const auto off : offs)
+                cache.insert(key(off), block());
+        }
+        // Lookups count as accesses, only check blocks that are no longer used by the test
+        static void expect_cached(DiskCache& cache, std::initializer_list<std::size_t> cached, std::initializer_list<std::size_t> evicted)
+        {
+            for (const auto off : evicted)
+                EXPECT_EQ(cache.find(key(off)), nullptr) << off;
+            for (const auto off : cached)
+                EXPECT_NE(cache.find(key(off)), nullptr) << off;
+        }
+    };
+
+    TEST_F(DiskCacheTest, LeastRecentlyUsedEvictsTheOldestAccess)
+    {
+        auto cache = make(Config::Cache::Type::LRU);
+        insert(*cache, { 0, 1, 2 });
+        ASSERT_NE(cache->find(key(0)), nullptr);
+        insert(*cache, { 3 });
+
+        EXPECT_EQ(cache->volume(), size * 3);
+        expect_cached(*cache, { 0, 2, 3 }, { 1 });
+    }
+
+    TEST_F(DiskCacheTest, LeastFrequentlyUsedEvictsTheFewestAccesses)
+    {
+        auto cache = make(Config::Cache::Type::LFU);
+        insert(*cache, { 0, 1, 2 });
+        ASSERT_NE(cache->find(key(0)), nullptr);
+        ASSERT_NE(cache->find(key(0)), nullptr);
+        ASSERT_NE(cache->find(key(2)), nullptr);
+        insert(*cache, { 3 });
+        // The newcomer is the least frequent block
+        insert(*cache, { 4 });
+
+        EXPECT_EQ(cache->volume(), size * 3);
+        expect_cached(*cache, { 0, 2, 4 }, { 1, 3 });
+    }
+
+    TEST_F(DiskCacheTest, LeastFrequentlyUsedBreaksTiesByRecency)
+    {
+        auto cache = make(Config::Cache::Type::LFU);
+        insert(*cache, { 0, 1, 2, 3 });
+
+        expect_cached(*cache, { 1, 2, 3 }, { 0 });
+    }
+
+    TEST_F(DiskCacheTest, AdaptiveLayeredKeepsRepeatedBlocksThroughScans)
+    {
+        auto cache = make(Config::Cache::Type::ALC);
+        insert(*cache, { 0 });
+        ASSERT_NE(cache->find(key(0)), nullptr);
+        // A scan of blocks seen once only cycles the recent layer
+        insert(*cache, { 1, 2, 3, 4, 5 });
+
+        EXPECT_EQ(cache->volume(), size * 3);
+        expect_cached(*cache, { 0, 4, 5 }, { 1, 2, 3 });
+    }
+
+    TEST_F(DiskCacheTest, AdaptiveLayeredPromotesRecentGhosts)
+    {
+        auto cache = make(Config::Cache::Type::ALC);
+        insert(*cache, { 0 });
+        ASSERT_NE(cache->find(key(0)), nullptr);
+        insert(*cache, { 1, 2, 3 });
+        ASSERT_EQ(cache->find(key(1)), nullptr);
+
+        // The evicted block is remembered, reinserting it promotes it and evicts the oldest recent block instead
+        insert(*cache, { 1 });
+        EXPECT_EQ(cache->volume(), size * 3);
+        expect_cached(*cache, { 0, 1, 3 }, { 2 });
+    }
+
+    TEST_F(DiskCacheTest, AdaptiveLayeredShrinksTheRecentLayerOnFrequentGhostHits)
+    {
+        auto cache = make(Config::Cache::Type::ALC);
+        insert(*cache, { 0, 1 });
+        ASSERT_NE(cache->find(key(0)), nullptr);
+        ASSERT_NE(cache->find(key(1)), nullptr);
+        insert(*cache, { 2, 3 });
+        ASSERT_EQ(cache->find(key(2)), nullptr);
+        // A recent ghost hit grows the target of the recent layer, the room is made in the frequent layer
+        insert(*cache, { 2 });
+        ASSERT_EQ(cache->find(key(0)), nullptr);
+
+        // A frequent ghost hit shrinks the target back, the recent layer gives way again
+        insert(*cache, { 0 });
+        EXPECT_EQ(cache->volume(), size * 3);
+        expect_cached(*cache, { 0, 1, 2 }, { 3 });
+    }
+
+    class DiskCacheTypeTest : public DiskCacheTest, public ::testing::WithParamInterface<Config::Cache::Type> {};
+
+    TEST_P(DiskCacheTypeTest, ErasesBlocksOfAFlushOrSchema)
+    {
+        auto cache = DiskCache::make(GetParam(), size * 8);
+        for (std::size_t off = 0; off < 2; off++)
+        {
+            cache->insert(key(off, 1, 0), block());
+            cache->insert(key(off, 1, 1), block());
+            cache->insert(key(off, 2, 0), block());
+        }
+        ASSERT_EQ(cache->volume(), size * 6);
+
+        cache->erase(1, 0);
+        EXPECT_EQ(cache->volume(), size * 4);
+        EXPECT_EQ(cache->find(key(0, 1, 0)), nullptr);
+        EXPECT_NE(cache->find(key(0, 1, 1)), nullptr);
+        EXPECT_NE(cache->find(key(0, 2, 0)), nullptr);
+
+        cache->erase(2);
+        EXPECT_EQ(cache->volume(), size * 2);
+        EXPECT_EQ(cache->find(key(1, 2, 0)), nullptr);
+        EXPECT_NE(cache->find(key(1, 1, 1)), nullptr);
+    }
+
+    INSTANTIATE_TEST_SUITE_P(Types, DiskCacheTypeTest,
+        ::testing::Values(Config::Cache::Type::LRU, Config::Cache::Type::LFU, Config::Cache::Type::ALC),
+        [](const auto& info) {
+            switch (info.param)
+            {
+            case Config::Cache::Type::LRU: return "LRU";
+            case Config::Cache::Type::LFU: return "LFU";
+            default: return "ALC";
+            }
+        });
+}
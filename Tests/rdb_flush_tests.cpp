@@ -0,0 +1,488 @@
+#include "rdb_test_env.hpp"
+#include <fstream>
+
+namespace rdb::test
+{
+    using FlushPartition = Topology<Field<"id", rdbt::Uint64>>;
+    using FlushWide = Schema<"test_flush_wide", FlushPartition, Topology<
+        Field<"ts", rdbt::Uint64, FieldType::Sort>,
+        Field<"value", rdbt::Uint64>,
+        Field<"name", rdbt::String>>>;
+    using FlushUnary = Schema<"test_flush_unary", FlushPartition, Topology<
+        Field<"value", rdbt::Uint64>,
+        Field<"name", rdbt::String>>>;
+
+    // Rows are written as field sequences, either one per partition (unary) or a few per partition (wide)
+    class FlushTest : public Environment, public ::testing::WithParamInterface<bool>
+    {
+    protected:
+        static constexpr std::uint64_t partitions = 48;
+        static constexpr std::uint64_t rows = 3;
+
+        void SetUp() override
+        {
+            Environment::SetUp();
+            FlushWide::require();
+            FlushUnary::require();
+            // Small blocks so that partitions span several blocks and the sparse indices are used
+            cfg->cache.block_size = 256;
+            cfg->cache.compaction_fold_ratio = 2;
+            cfg->cache.compaction_pressure = 1;
+        }
+
+        static bool wide() { return GetParam(); }
+        static schema_type schema() { return wide() ? FlushWide::ucode : FlushUnary::ucode; }
+        static std::uint64_t row_count() { return wide() ? rows : 1; }
+        static unsigned char value_field() { return wide() ? 1 : 0; }
+        static unsigned char name_field() { return wide() ? 2 : 1; }
+        static View sort(std::uint64_t row) { return wide() ? sort_key(row * 10) : View(); }
+
+        static View value(std::uint64_t v) { return rdbt::Uint64::make(v); }
+        static View name(std::uint64_t key, std::uint64_t row)
+        {
+            // Long enough to not be stored inline and to vary in size
+            const auto str = std::format("partition {} row {} {}", key, row, std::string(key % 7 * 5, '.'));
+            return rdbt::String::make(std::string_view(str));
+        }
+
+        void write(MemoryCache& cache, std::uint64_t key, std::uint64_t row, unsigned char field, const View& data)
+        {
+            cache.write(WriteType::Field, key, FlushPartition::make(key), sort(row), test::field(field, data), MemoryCache::origin());
+        }
+        static bool equal(const View& lhs, const View& rhs)
+        {
+            return std::ranges::equal(lhs.data(), rhs.data());
+        }
+    };
+
+    TEST_P(FlushTest, RoundTripsFieldSequencesThroughCompaction)
+    {
+        auto expect = [&](MemoryCache& cache, const char* stage)
+        {
+            for (std::uint64_t key = 0; key < partitions; key++)
+            {
+                for (std::uint64_t row = 0; row < row_count(); row++)
+                {
+                    const auto values = read(cache, key, sort(row), { value_field(), name_field() });
+                    if (key % 5 == 0 && row == 0)
+                    {
+                        EXPECT_TRUE(values.empty()) << stage << " removed " << key;
+                        continue;
+                    }
+                    ASSERT_EQ(values.size(), 2) << stage << " " << key << ":" << row;
+                    EXPECT_TRUE(equal(values.at(value_field()), value(key % 2 ? key : key + 1000))) << stage << " " << key << ":" << row;
+                    EXPECT_TRUE(equal(values.at(name_field()), name(key, row))) << stage << " " << key << ":" << row;
+                }
+            }
+        };
+
+        {
+            MemoryCache cache(shared, 0, schema());
+            // First flush, complete rows written field by field
+            for (std::uint64_t key = 0; key < partitions; key++)
+            {
+                for (std::uint64_t row = 0; row < row_count(); row++)
+                {
+                    write(cache, key, row, value_field(), value(key));
+                    write(cache, key, row, name_field(), name(key, row));
+                }
+            }
+            cache.flush();
+            cache.sync();
+
+            // Second flush, a single field of some rows and removals
+            for (std::uint64_t key = 0; key < partitions; key++)
+            {
+                for (std::uint64_t row = 0; row < row_count(); row++)
+                {
+                    if (key % 2 == 0)
+                        write(cache, key, row, value_field(), value(key + 1000));
+                }
+                if (key % 5 == 0)
+                    cache.remove(key, FlushPartition::make(key), sort(0), MemoryCache::origin());
+            }
+            cache.flush();
+            cache.sync();
+            expect(cache, "flushed");
+
+            // Both flushes fold into the second one, the first one is retired once a read swaps the result in
+            ASSERT_TRUE(wait_for([&]() {
+                cache.exists(1, sort(1));
+                return std::filesystem::exists(flush_path(schema())/"g0");
+            }));
+            EXPECT_FALSE(std::filesystem::exists(flush_path(schema())/"f0"));
+            EXPECT_TRUE(std::filesystem::exists(flush_path(schema())/"f1"));
+            expect(cache, "compacted");
+        }
+
+        MemoryCache cache(shared, 0, schema());
+        expect(cache, "reopened");
+    }
+
+    TEST_P(FlushTest, LayersFieldsOfEveryFoldedFlush)
+    {
+        cfg->cache.compaction_fold_ratio = 3;
+        cfg->cache.compaction_pressure = 2;
+        auto expect = [&](MemoryCache& cache, const char* stage)
+        {
+            for (std::uint64_t key = 0; key < partitions; key++)
+            {
+                for (std::uint64_t row = 0; row < row_count(); row++)
+                {
+                    const auto values = read(cache, key, sort(row), { value_field(), name_field() });
+                    if (key % 5 == 0 && row == 0)
+                    {
+                        EXPECT_TRUE(values.empty()) << stage << " removed " << key;
+                        continue;
+                    }
+                    ASSERT_EQ(values.size(), 2) << stage << " " << key << ":" << row;
+                    EXPECT_TRUE(equal(values.at(value_field()), value(key % 2 ? key + 1000 : key))) << stage << " " << key << ":" << row;
+                    EXPECT_TRUE(equal(values.at(name_field()), name(key, row))) << stage << " " << key << ":" << row;
+                }
+            }
+        };
+
+        {
+            MemoryCache cache(shared, 0, schema());
+            // Every flush holds a different field of the rows, the last one also removes some
+            for (std::uint64_t flush = 0; flush < 3; flush++)
+            {
+                for (std::uint64_t key = 0; key < partitions; key++)
+                {
+                    for (std::uint64_t row = 0; row < row_count(); row++)
+                    {
+                        if (flush == 0)
+                            write(cache, key, row, value_field(), value(key));
+                        else if (flush == 1)
+                            write(cache, key, row, name_field(), name(key, row));
+                        else if (key % 2)
+                            write(cache, key, row, value_field(), value(key + 1000));
+                    }
+                    if (flush == 2 && key % 5 == 0)
+                        cache.remove(key, FlushPartition::make(key), sort(0), MemoryCache::origin());
+                }
+                cache.flush();
+                cache.sync();
+            }
+
+            // A single merge folds the three flushes into the last one
+            ASSERT_TRUE(wait_for([&]() {
+                cache.exists(1, sort(1));
+                return std::filesystem::exists(flush_path(schema())/"g1");
+            }));
+            EXPECT_TRUE(std::filesystem::exists(flush_path(schema())/"g0"));
+            EXPECT_TRUE(std::filesystem::exists(flush_path(schema())/"f2"));
+            expect(cache, "compacted");
+        }
+
+        MemoryCache cache(shared, 0, schema());
+        expect(cache, "reopened");
+    }
+
+    TEST_P(FlushTest, WritesPendingFlushesOnShutdown)
+    {
+        cfg->cache.compaction_pressure = 64;
+        {
+            MemoryCache cache(shared, 0, schema());
+            // More flushes than can be queued, none of them waited for
+            for (std::uint64_t flush = 0; flush < 6; flush++)
+            {
+                for (std::uint64_t key = flush * 8; key < flush * 8 + 8; key++)
+                {
+                    write(cache, key, 0, value_field(), value(key));
+                    write(cache, key, 0, name_field(), name(key, 0));
+                }
+                cache.flush();
+            }
+        }
+        for (std::uint64_t flush = 0; flush < 6; flush++)
+            EXPECT_TRUE(std::filesystem::exists(flush_path(schema())/std::format("f{}", flush)/"data.dat")) << flush;
+
+        MemoryCache cache(shared, 0, schema());
+        for (std::uint64_t key = 0; key < 48; key++)
+        {
+            const auto values = read(cache, key, sort(0), { value_field(), name_field() });
+            ASSERT_EQ(values.size(), 2) << key;
+            EXPECT_TRUE(equal(values.at(value_field()), value(key))) << key;
+            EXPECT_TRUE(equal(values.at(name_field()), name(key, 0))) << key;
+        }
+    }
+
+    TEST_P(FlushTest, QueuesFlushesBeyondTheRing)
+    {
+        cfg->cache.compaction_pressure = 64;
+        cfg->cache.stall_hard_flushes = 0;
+        cfg->cache.stall_hard_pressure = 0;
+        MemoryCache cache(shared, 0, schema());
+        // The flushes that do not fit in the ring are kept aside and written in order
+        for (std::uint64_t flush = 0; flush < 12; flush++)
+        {
+            for (std::uint64_t key = flush * 4; key < flush * 4 + 8; key++)
+                write(cache, key, 0, value_field(), value(key + flush));
+            cache.flush();
+        }
+        cache.sync();
+        EXPECT_EQ(cache.flush_pressure(), 0);
+        for (std::uint64_t flush = 0; flush < 12; flush++)
+            EXPECT_TRUE(std::filesystem::exists(flush_path(schema())/std::format("f{}", flush)/"data.dat")) << flush;
+        // Every key but the first four is written by two flushes, the later one wins
+        for (std::uint64_t key = 0; key < 52; key++)
+        {
+            const auto values = read(cache, key, sort(0), { value_field() });
+            ASSERT_EQ(values.size(), 1) << key;
+            EXPECT_TRUE(equal(values.at(value_field()), value(key + std::min<std::uint64_t>(key / 4, 11)))) << key;
+        }
+    }
+
+    TEST_P(FlushTest, ReadsRowsWhileTheirFlushIsWritten)
+    {
+        cfg->cache.compaction_pressure = 64;
+        // Blocks compressed by several workers and by the flush thread itself
+        for (const std::size_t workers : { 3, 0 })
+        {
+            cfg->cache.flush_workers = workers;
+            MemoryCache cache(shared, 0, schema());
+            for (std::uint64_t key = 0; key < partitions; key++)
+            {
+                for (std::uint64_t row = 0; row < row_count(); row++)
+                {
+                    write(cache, key, row, value_field(), value(key + workers));
+                    write(cache, key, row, name_field(), name(key, row));
+                }
+            }
+            cache.flush();
+            // Either the memtable or the flush holds every row, not waited for
+            for (const auto stage : { "flushing", "flushed" })
+            {
+                for (std::uint64_t key = 0; key < partitions; key++)
+                {
+                    for (std::uint64_t row = 0; row < row_count(); row++)
+                    {
+                        const auto values = read(cache, key, sort(row), { value_field(), name_field() });
+                        ASSERT_EQ(values.size(), 2) << stage << " " << workers << " " << key << ":" << row;
+                        EXPECT_TRUE(equal(values.at(value_field()), value(key + workers))) << stage << " " << workers << " " << key;
+                        EXPECT_TRUE(equal(values.at(name_field()), name(key, row))) << stage << " " << workers << " " << key;
+                    }
+                }
+                cache.sync();
+            }
+        }
+    }
+
+    TEST_P(FlushTest, IdlesOnceCompactionIsSwappedIn)
+    {
+        MemoryCache cache(shared, 0, schema());
+        EXPECT_TRUE(cache.idle());
+        for (std::uint64_t flush = 0; flush < 2; flush++)
+        {
+            for (std::uint64_t key = flush * 8; key < flush * 8 + 8; key++)
+                write(cache, key, 0, value_field(), value(key));
+            cache.flush();
+            EXPECT_FALSE(cache.idle()) << flush;
+            cache.sync();
+        }
+
+        // The second commit starts a compaction, the cache is only idle once its result is swapped in
+        ASSERT_TRUE(wait_for([&]() { return cache.idle(); }));
+        EXPECT_TRUE(std::filesystem::exists(flush_path(schema())/"g0"));
+        EXPECT_FALSE(std::filesystem::exists(flush_path(schema())/"f0"));
+        for (std::uint64_t key = 0; key < 16; key++)
+        {
+            const auto values = read(cache, key, sort(0), { value_field() });
+            ASSERT_EQ(values.size(), 1) << key;
+            EXPECT_TRUE(equal(values.at(value_field()), value(key))) << key;
+        }
+    }
+
+    INSTANTIATE_TEST_SUITE_P(Partitions, FlushTest, ::testing::Values(true, false),
+        [](const auto& info) { return info.param ? "Wide" : "Unary"; });
+
+    class PageTest : public Environment
+    {
+    protected:
+        static constexpr std::uint64_t key = 7;
+
+        void SetUp() override
+        {
+            Environment::SetUp();
+            FlushWide::require();
+            cfg->cache.block_size = 256;
+        }
+
+        static void write(MemoryCache& cache, std::uint64_t ts, unsigned char field, const View& data)
+        {
+            cache.write(WriteType::Field, key, FlushPartition::make(key), sort_key(ts), test::field(field, data), MemoryCache::origin());
+        }
+        // Field sequence of a row as it is paged, the field count followed by the fields in write order
+        static std::vector<unsigned char> row(std::initializer_list<std::pair<unsigned char, View>> fields)
+        {
+            std::vector<unsigned char> out{ static_cast<unsigned char>(fields.size()) };
+            for (decltype(auto) it : fields)
+            {
+                out.push_back(it.first);
+                out.insert(out.end(), it.second.data().begin(), it.second.data().end());
+            }
+            return out;
+        }
+    };
+
+    TEST_F(PageTest, PagesFlushedPartialRows)
+    {
+        MemoryCache cache(shared, 0, FlushWide::ucode);
+        auto value = [](std::uint64_t ts) { return rdbt::Uint64::make(ts); };
+        auto name = [](std::uint64_t ts) {
+            const auto str = std::format("row {} {}", ts, std::string(ts % 9 * 3, '-'));
+            return rdbt::String::make(std::string_view(str));
+        };
+
+        // Rows with one or the other field only, or both, spanning several blocks
+        std::map<std::uint64_t, std::vector<unsigned char>> expected;
+        for (std::uint64_t ts = 0; ts < 400; ts += 10)
+        {
+            if (ts % 30 != 10)
+                write(cache, ts, 1, value(ts));
+            if (ts % 30 != 0)
+                write(cache, ts, 2, name(ts));
+            if (ts % 30 == 0)
+                expected[ts] = row({ { 1, value(ts) } });
+            else if (ts % 30 == 10)
+                expected[ts] = row({ { 2, name(ts) } });
+            else
+                expected[ts] = row({ { 1, value(ts) }, { 2, name(ts) } });
+        }
+        cache.flush();
+        cache.sync();
+        // Rows still in memory are merged in between
+        for (const std::uint64_t ts : { 105, 255 })
+        {
+            write(cache, ts, 2, name(ts));
+            expected[ts] = row({ { 2, name(ts) } });
+        }
+
+        auto concat = [&](std::uint64_t from, std::size_t count)
+        {
+            std::vector<unsigned char> out;
+            for (auto it = expected.lower_bound(from); it != expected.end() && count--; ++it)
+                out.insert(out.end(), it->second.begin(), it->second.end());
+            return out;
+        };
+        auto bytes = [](const View& view)
+        {
+            return std::vector<unsigned char>(view.data().begin(), view.data().end());
+        };
+
+        // Point reads seek through the same block and value indices
+        for (decltype(auto) it : expected)
+            EXPECT_EQ(read(cache, key, sort_key(it.first), { 1, 2 }).size(), it.second[0]) << it.first;
+
+        EXPECT_EQ(bytes(cache.page(key, expected.size())), concat(0, expected.size()));
+        EXPECT_EQ(bytes(cache.page(key, 3)), concat(0, 3));
+        EXPECT_EQ(bytes(cache.page_from(key, sort_key(200), 8)), concat(200, 8));
+        EXPECT_EQ(bytes(cache.page_from(key, sort_key(101), 4)), concat(101, 4));
+        EXPECT_EQ(bytes(cache.page_from(key, sort_key(370), 10)), concat(370, 10));
+    }
+
+    class ChecksumTest : public Environment
+    {
+    protected:
+        void SetUp() override
+        {
+            Environment::SetUp();
+            FlushWide::require();
+            // Raw blocks, so that the stored rows can be found in the flush
+            cfg->cache.block_size = 256;
+            cfg->cache.compression_ratio = 0.f;
+            cfg->cache.verify_checksums = Config::Cache::Verify::Always;
+        }
+
+        static View name(std::uint64_t key)
+        {
+            const auto str = std::format("checksummed row {} {}", key, std::string(key % 5 * 9, '='));
+            return rdbt::String::make(std::string_view(str));
+        }
+        static View stale(std::uint64_t key)
+        {
+            return rdbt::String::make(std::string_view(std::format("stale row {}", key)));
+        }
+        // Flips a byte of the stored name of a key
+        void corrupt(std::size_t flush, std::uint64_t key)
+        {
+            const auto path = flush_path(FlushWide::ucode)/std::format("f{}", flush)/"data.dat";
+            std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+            std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            const auto needle = std::format("checksummed row {} ", key);
+            const auto off = data.find(needle);
+            ASSERT_NE(off, std::string::npos);
+            file.seekp(off + needle.size() - 2);
+            file.put(data[off + needle.size() - 2] ^ 0x5a);
+        }
+    };
+
+    TEST_F(ChecksumTest, ReportsCorruptedBlocks)
+    {
+        cfg->cache.scrub_interval = std::chrono::seconds(1);
+        std::mutex mtx;
+        std::vector<std::pair<std::size_t, std::size_t>> failures;
+        const auto handle = shared.events->listen<Event::ChecksumFailure>([&](std::size_t flush, std::size_t off) {
+            std::lock_guard lock(mtx);
+            failures.emplace_back(flush, off);
+        });
+        auto failed = [&]() {
+            std::lock_guard lock(mtx);
+            return failures;
+        };
+        std::vector<std::pair<ReadType, key_type>> reads;
+        const auto read_handle = shared.events->listen<Event::ReadFailure>([&](ReadType type, std::span<const unsigned char> key) {
+            key_type value;
+            std::memcpy(&value, key.data(), sizeof(value));
+            reads.emplace_back(type, value);
+        });
+
+        MemoryCache cache(shared, 0, FlushWide::ucode);
+        // Superseded versions in an older flush
+        for (std::uint64_t key = 0; key < 16; key++)
+            cache.write(WriteType::Field, key, FlushPartition::make(key), sort_key(0), field(2, stale(key)), MemoryCache::origin());
+        cache.flush();
+        cache.sync();
+        for (std::uint64_t key = 0; key < 16; key++)
+            cache.write(WriteType::Field, key, FlushPartition::make(key), sort_key(0), field(2, name(key)), MemoryCache::origin());
+        cache.flush();
+        cache.sync();
+        for (std::uint64_t key = 0; key < 16; key++)
+        {
+            const auto values = read(cache, key, sort_key(0), { 2 });
+            ASSERT_EQ(values.size(), 1) << key;
+            EXPECT_TRUE(std::ranges::equal(values.at(2).data(), name(key).data())) << key;
+        }
+        ASSERT_TRUE(failed().empty());
+
+        // The corrupted block fails the read instead of falling back to the older flush
+        // The blocks of other partitions are not affected
+        corrupt(1, 7);
+        for (std::uint64_t key = 0; key < 16; key++)
+        {
+            const auto values = read(cache, key, sort_key(0), { 2 });
+            if (key == 7)
+            {
+                EXPECT_TRUE(values.empty());
+                EXPECT_FALSE(cache.exists(key, sort_key(0)));
+                EXPECT_TRUE(cache.page(key, 4) == nullptr);
+                continue;
+            }
+            ASSERT_EQ(values.size(), 1) << key;
+            EXPECT_TRUE(std::ranges::equal(values.at(2).data(), name(key).data())) << key;
+        }
+        const auto reported = failed();
+        ASSERT_FALSE(reported.empty());
+        EXPECT_EQ(reported.front().first, 1);
+        // Read, existence check and page
+        ASSERT_EQ(reads.size(), 3);
+        EXPECT_EQ(reads[0], std::make_pair(ReadType::Field, key_type(7)));
+        EXPECT_EQ(reads[1], std::make_pair(ReadType::Field, key_type(7)));
+        EXPECT_EQ(reads[2], std::make_pair(ReadType::Page, key_type(7)));
+
+        // The scrubber finds the same block without any read
+        ASSERT_TRUE(wait_for([&]() { return failed().size() > reported.size(); }, std::chrono::seconds(5)));
+        EXPECT_EQ(failed().back(), reported.front());
+    }
+}
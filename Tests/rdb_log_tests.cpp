@@ -0,0 +1,214 @@
+#include "rdb_test_env.hpp"
+#include <rdb_log_tail.hpp>
+#include <fstream>
+#include <unordered_map>
+
+namespace rdb::test
+{
+    using LogPartition = Topology<Field<"id", rdbt::Uint64>>;
+    using LogWide = Schema<"test_log_wide", LogPartition, Topology<
+        Field<"ts", rdbt::Uint64, FieldType::Sort>,
+        Field<"value", rdbt::Uint64>,
+        Field<"name", rdbt::String>>>;
+
+    class LogTest : public Environment
+    {
+    protected:
+        void SetUp() override
+        {
+            Environment::SetUp();
+            LogWide::require();
+            // Small shards so that a few writes roll over into pooled shards
+            cfg->logs.log_shard_size = 4096;
+            cfg->logs.log_pool_size = 4;
+            shared.tails = std::make_shared<LogTailRegistry>();
+        }
+
+        std::filesystem::path cache_path() const
+        {
+            return flush_path(LogWide::ucode).parent_path();
+        }
+        static key_type key(std::uint64_t id)
+        {
+            return partition_key(LogWide::ucode, LogPartition::make(id));
+        }
+        static View name(std::uint64_t id)
+        {
+            const auto str = std::format("record {} {}", id, std::string(id % 13 * 7, '+'));
+            return rdbt::String::make(std::string_view(str));
+        }
+        static void write(MemoryCache& cache, std::uint64_t id, const View& value)
+        {
+            cache.write(WriteType::Field, key(id), LogPartition::make(id), sort_key(id), field(2, value), MemoryCache::origin());
+        }
+        void write(MemoryCache& cache, std::uint64_t id)
+        {
+            _ids.emplace(key(id), id);
+            write(cache, id, name(id));
+        }
+        // Ids and names of the field writes read by the tail
+        LogTail::Status poll(LogTail& tail, std::vector<std::uint64_t>& ids, std::size_t max = ~0ull)
+        {
+            return tail.poll([&](const LogTail::Cursor&, WriteType type, key_type key, View, View data) {
+                if (type != WriteType::Field)
+                    return;
+                const auto id = _ids.at(key);
+                ids.push_back(id);
+                EXPECT_TRUE(std::ranges::equal(data.data().subspan(1), name(id).data())) << id;
+            }, max);
+        }
+
+    private:
+        std::unordered_map<key_type, std::uint64_t> _ids;
+    };
+
+    TEST_F(LogTest, HoldsShardsOfAttachedTails)
+    {
+        auto recycled = [&]() { return shared.tails->recycle([]() { return true; }); };
+        EXPECT_TRUE(recycled());
+        {
+            LogTail tail(cache_path(), LogWide::ucode, {}, shared.tails);
+            LogTail moved(std::move(tail));
+            EXPECT_EQ(shared.tails->tails(), 1);
+            EXPECT_FALSE(recycled());
+        }
+        EXPECT_EQ(shared.tails->tails(), 0);
+        EXPECT_TRUE(recycled());
+    }
+
+    TEST_F(LogTest, TailsShardsReleasedWhileMapped)
+    {
+        MemoryCache cache(shared, 0, LogWide::ucode);
+        LogTail tail(cache_path(), LogWide::ucode, {}, shared.tails);
+        std::vector<std::uint64_t> keys;
+
+        std::uint64_t key = 0;
+        for (; key < 64; key++)
+            write(cache, key);
+        ASSERT_EQ(poll(tail, keys, 2), LogTail::Status::Ok);
+
+        // The shards are released by the flushes while the first one is mapped, later writes take shards from the pool
+        for (std::size_t round = 0; round < 3; round++)
+        {
+            cache.flush();
+            cache.sync();
+            for (const auto end = key + 64; key < end; key++)
+                write(cache, key);
+        }
+        cache.sync_logs();
+
+        // The mapped shard is still read in full, the ones released before they were mapped are a gap
+        EXPECT_EQ(poll(tail, keys), LogTail::Status::Gap);
+        ASSERT_GT(keys.size(), 2);
+        ASSERT_LT(keys.size(), 64);
+        for (std::uint64_t i = 0; i < keys.size(); i++)
+            ASSERT_EQ(keys[i], i);
+
+        tail.rewind();
+        keys.clear();
+        EXPECT_EQ(poll(tail, keys), LogTail::Status::Pending);
+        ASSERT_FALSE(keys.empty());
+        EXPECT_EQ(keys.back(), key - 1);
+        for (std::uint64_t i = 1; i < keys.size(); i++)
+            ASSERT_EQ(keys[i], keys[i - 1] + 1);
+    }
+
+    TEST_F(LogTest, PreparesShardsOfEveryPoolFromOneWorker)
+    {
+        auto worker = std::make_shared<LogShardWorker>();
+        std::vector<std::unique_ptr<LogShardPool>> pools;
+        for (std::size_t i = 0; i < 3; i++)
+            pools.push_back(std::make_unique<LogShardPool>(cfg->root/std::format("pool{}", i), 4096, 2, worker));
+
+        // Waits for a ready shard of the pool
+        auto acquire = [&](LogShardPool& pool, const std::filesystem::path& to) {
+            for (std::size_t i = 0; i < 1000; i++)
+            {
+                if (pool.acquire(to))
+                    return true;
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            }
+            return false;
+        };
+        for (std::size_t i = 0; i < pools.size(); i++)
+        {
+            const auto shard = cfg->root/std::format("s{}", i);
+            ASSERT_TRUE(acquire(*pools[i], shard)) << i;
+            EXPECT_EQ(std::filesystem::file_size(shard), 4096) << i;
+            // Taken shards are replaced, retired ones are zeroed again
+            ASSERT_TRUE(pools[i]->retire(shard)) << i;
+            EXPECT_FALSE(std::filesystem::exists(shard)) << i;
+            ASSERT_TRUE(acquire(*pools[i], shard)) << i;
+        }
+
+        // Pools leave while the worker may still be preparing their shards
+        pools.erase(pools.begin());
+        ASSERT_TRUE(acquire(*pools.back(), cfg->root/"last"));
+        pools.clear();
+    }
+
+    TEST_F(LogTest, ReplaysFramedRecords)
+    {
+        cfg->logs.log_shard_size = 1 << 16;
+        // Large records are stored compressed
+        const auto large = [](std::uint64_t id) {
+            const auto str = std::format("record {} {}", id, std::string(3000, 'x'));
+            return rdbt::String::make(std::string_view(str));
+        };
+        {
+            MemoryCache cache(shared, 0, LogWide::ucode);
+            for (std::uint64_t id = 0; id < 40; id++)
+            {
+                if (id % 4 == 0)
+                    write(cache, id, large(id));
+                else
+                    write(cache, id);
+            }
+            cache.remove(key(5), LogPartition::make(5), sort_key(5), MemoryCache::origin());
+            cache.sync_logs();
+        }
+
+        std::ifstream file(cache_path()/"logs"/"s0", std::ios::binary);
+        const std::string shard((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        EXPECT_NE(shard.find("record 1 "), std::string::npos);
+        // Neither the large records nor their raw tails are left in the shard
+        EXPECT_EQ(shard.find(std::string(64, 'x')), std::string::npos);
+
+        MemoryCache cache(shared, 0, LogWide::ucode);
+        for (std::uint64_t id = 0; id < 40; id++)
+        {
+            const auto values = read(cache, key(id), sort_key(id), { 2 });
+            if (id == 5)
+            {
+                EXPECT_TRUE(values.empty());
+                continue;
+            }
+            ASSERT_EQ(values.size(), 1) << id;
+            EXPECT_TRUE(std::ranges::equal(values.at(2).data(), (id % 4 == 0 ? large(id) : name(id)).data())) << id;
+        }
+    }
+
+    TEST_F(LogTest, StopsReplayAtCorruptedFrame)
+    {
+        cfg->logs.log_shard_size = 1 << 16;
+        {
+            MemoryCache cache(shared, 0, LogWide::ucode);
+            for (std::uint64_t id = 0; id < 20; id++)
+                write(cache, id);
+            cache.sync_logs();
+        }
+        {
+            std::fstream file(cache_path()/"logs"/"s0", std::ios::in | std::ios::out | std::ios::binary);
+            const std::string shard((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            const auto off = shard.find("record 10 ");
+            ASSERT_NE(off, std::string::npos);
+            file.seekp(off);
+            file.put(shard[off] ^ 0x5a);
+        }
+
+        // Records are applied up to the first frame that fails its checksum
+        MemoryCache cache(shared, 0, LogWide::ucode);
+        for (std::uint64_t id = 0; id < 20; id++)
+            EXPECT_EQ(read(cache, key(id), sort_key(id), { 2 }).size(), id < 10) << id;
+    }
+}
@@ -0,0 +1,295 @@
+#include "rdb_test_env.hpp"
+
+namespace rdb::test
+{
+    using MemoryPartition = Topology<Field<"id", rdbt::Uint64>>;
+    using MemoryWide = Schema<"test_memory_wide", MemoryPartition, Topology<
+        Field<"ts", rdbt::Uint64, FieldType::Sort>,
+        Field<"value", rdbt::Uint64>,
+        Field<"name", rdbt::String>>>;
+    using MemoryUnary = Schema<"test_memory_unary", MemoryPartition, Topology<
+        Field<"value", rdbt::Uint64>,
+        Field<"name", rdbt::String>>>;
+
+    class MemoryCacheTest : public Environment
+    {
+    protected:
+        void SetUp() override
+        {
+            Environment::SetUp();
+            MemoryWide::require();
+            MemoryUnary::require();
+        }
+
+        static bool equal(const View& lhs, const View& rhs)
+        {
+            return std::ranges::equal(lhs.data(), rhs.data());
+        }
+    };
+
+    TEST_F(MemoryCacheTest, OverwritesFieldInMemory)
+    {
+        MemoryCache cache(shared, 0, MemoryWide::ucode);
+        const auto pkey = MemoryPartition::make(std::uint64_t(1));
+        const auto sort = sort_key(10);
+
+        cache.write(WriteType::Field, 1, pkey, sort, field(1, rdbt::Uint64::make(std::uint64_t(5))), MemoryCache::origin());
+        auto values = read(cache, 1, sort, { 1 });
+        ASSERT_EQ(values.size(), 1);
+        EXPECT_TRUE(equal(values[1], rdbt::Uint64::make(std::uint64_t(5))));
+
+        cache.write(WriteType::Field, 1, pkey, sort, field(1, rdbt::Uint64::make(std::uint64_t(7))), MemoryCache::origin());
+        values = read(cache, 1, sort, { 1 });
+        ASSERT_EQ(values.size(), 1);
+        EXPECT_TRUE(equal(values[1], rdbt::Uint64::make(std::uint64_t(7))));
+
+        EXPECT_FALSE(cache.exists(1, sort_key(11)));
+        EXPECT_FALSE(cache.exists(2, sort));
+    }
+
+    TEST_F(MemoryCacheTest, ReadsEveryFieldOfSequence)
+    {
+        for (const auto schema : { MemoryWide::ucode, MemoryUnary::ucode })
+        {
+            MemoryCache cache(shared, 0, schema);
+            const auto wide = schema == MemoryWide::ucode;
+            const auto pkey = MemoryPartition::make(std::uint64_t(1));
+            const auto sort = wide ? sort_key(10) : View();
+            const std::size_t value = wide ? 1 : 0;
+            const std::size_t name = wide ? 2 : 1;
+
+            const auto first = rdbt::String::make(std::string_view("first name"));
+            const auto second = rdbt::String::make(std::string_view("second, longer name"));
+            cache.write(WriteType::Field, 1, pkey, sort, field(name, first), MemoryCache::origin());
+            cache.write(WriteType::Field, 1, pkey, sort, field(value, rdbt::Uint64::make(std::uint64_t(5))), MemoryCache::origin());
+            cache.write(WriteType::Field, 1, pkey, sort, field(name, second), MemoryCache::origin());
+
+            const auto values = read(cache, 1, sort, { value, name });
+            ASSERT_EQ(values.size(), 2) << wide;
+            EXPECT_TRUE(equal(values.at(value), rdbt::Uint64::make(std::uint64_t(5)))) << wide;
+            EXPECT_TRUE(equal(values.at(name), second)) << wide;
+        }
+    }
+
+    TEST_F(MemoryCacheTest, GrowsRowInPlace)
+    {
+        MemoryCache cache(shared, 0, MemoryWide::ucode);
+        const auto pkey = MemoryPartition::make(std::uint64_t(1));
+        const auto sort = sort_key(10);
+
+        // Growth past the capacity moves the slot, growth within the slack does not
+        for (const auto length : { 1, 8, 40, 41, 100, 300, 20, 301 })
+        {
+            const std::string value(length, char('a' + length % 26));
+            const auto name = rdbt::String::make(std::string_view(value));
+            cache.write(WriteType::Field, 1, pkey, sort, field(2, name), MemoryCache::origin());
+
+            const auto values = read(cache, 1, sort, { 2 });
+            ASSERT_EQ(values.size(), 1) << length;
+            EXPECT_TRUE(equal(values.at(2), name)) << length;
+        }
+    }
+
+    TEST_F(MemoryCacheTest, CachesPagesUntilWritten)
+    {
+        cfg->cache.cache_page = true;
+        MemoryCache cache(shared, 0, MemoryWide::ucode);
+        const auto pkey = MemoryPartition::make(std::uint64_t(1));
+        auto write = [&](std::uint64_t ts, std::uint64_t value) {
+            cache.write(WriteType::Field, 1, pkey, sort_key(ts), field(1, rdbt::Uint64::make(value)), MemoryCache::origin());
+        };
+        auto bytes = [](const View& view) {
+            return std::vector<unsigned char>(view.data().begin(), view.data().end());
+        };
+        for (std::uint64_t ts = 0; ts < 5; ts++)
+            write(ts * 10, ts);
+
+        // Requests are keyed by what was asked for, not by what is left over once the page is filled
+        const auto first = bytes(cache.page(1, 3));
+        const auto from = bytes(cache.page_from(1, sort_key(20), 2));
+        const auto all = bytes(cache.page(1, 10));
+        ASSERT_EQ(cache.page_cache()->hits(), 0);
+        EXPECT_EQ(bytes(cache.page(1, 3)), first);
+        EXPECT_EQ(bytes(cache.page_from(1, sort_key(20), 2)), from);
+        EXPECT_EQ(bytes(cache.page(1, 10)), all);
+        EXPECT_EQ(cache.page_cache()->hits(), 3);
+        EXPECT_EQ(cache.page_cache()->misses(), 3);
+
+        // Writing to the partition drops its pages
+        write(10, 100);
+        const auto updated = bytes(cache.page(1, 3));
+        EXPECT_EQ(cache.page_cache()->hits(), 3);
+        EXPECT_EQ(cache.page_cache()->misses(), 4);
+        EXPECT_NE(updated, first);
+        EXPECT_EQ(bytes(cache.page(1, 3)), updated);
+        EXPECT_EQ(cache.page_cache()->hits(), 4);
+    }
+
+    TEST_F(MemoryCacheTest, SharesPagesBetweenSchemasOfACore)
+    {
+        using MemoryWideOther = Schema<"test_memory_wide_other", MemoryPartition, Topology<
+            Field<"ts", rdbt::Uint64, FieldType::Sort>,
+            Field<"value", rdbt::Uint64>>>;
+        MemoryWideOther::require();
+
+        cfg->cache.cache_page = true;
+        PageCache pages(cfg->cache.max_page_cache_volume);
+        MemoryCache wide(shared, 0, MemoryWide::ucode, nullptr, &pages);
+        const auto pkey = MemoryPartition::make(std::uint64_t(1));
+        auto bytes = [](const View& view) {
+            return std::vector<unsigned char>(view.data().begin(), view.data().end());
+        };
+        wide.write(WriteType::Field, 1, pkey, sort_key(0), field(1, rdbt::Uint64::make(std::uint64_t(5))), MemoryCache::origin());
+        const auto first = bytes(wide.page(1, 1));
+        const auto volume = pages.volume();
+        {
+            // Same partition key under another schema
+            MemoryCache other(shared, 0, MemoryWideOther::ucode, nullptr, &pages);
+            other.write(WriteType::Field, 1, pkey, sort_key(0), field(1, rdbt::Uint64::make(std::uint64_t(7))), MemoryCache::origin());
+            const auto second = bytes(other.page(1, 1));
+            EXPECT_NE(second, first);
+            EXPECT_EQ(bytes(other.page(1, 1)), second);
+            EXPECT_EQ(bytes(wide.page(1, 1)), first);
+            EXPECT_EQ(pages.hits(), 2);
+            EXPECT_GT(pages.volume(), volume);
+
+            // Writes only drop the pages of their own schema
+            other.write(WriteType::Field, 1, pkey, sort_key(0), field(1, rdbt::Uint64::make(std::uint64_t(8))), MemoryCache::origin());
+            EXPECT_EQ(pages.volume(), volume);
+            other.page(1, 1);
+        }
+        // Unloading a cache drops the pages of its schema
+        EXPECT_EQ(pages.volume(), volume);
+        EXPECT_EQ(bytes(wide.page(1, 1)), first);
+        EXPECT_EQ(pages.hits(), 3);
+    }
+
+    TEST_F(MemoryCacheTest, ReplaysRemovalOfFlushedRow)
+    {
+        const auto pkey = MemoryPartition::make(std::uint64_t(1));
+        const auto sort = sort_key(10);
+        {
+            MemoryCache cache(shared, 0, MemoryWide::ucode);
+            cache.write(WriteType::Field, 1, pkey, sort, field(1, rdbt::Uint64::make(std::uint64_t(5))), MemoryCache::origin());
+            cache.flush();
+            cache.sync();
+            // The partition is only on disk, the removal creates it in the memtable again
+            cache.remove(1, pkey, sort, MemoryCache::origin());
+            EXPECT_FALSE(cache.exists(1, sort));
+        }
+
+        // The removal is only in the log, replay restores the tombstone over the flushed row
+        MemoryCache cache(shared, 0, MemoryWide::ucode);
+        EXPECT_FALSE(cache.exists(1, sort));
+        EXPECT_TRUE(read(cache, 1, sort, { 1 }).empty());
+    }
+
+    TEST_F(MemoryCacheTest, StolenReadsFindFlushedRows)
+    {
+        cfg->cache.concurrent_reads = true;
+        for (const auto schema : { MemoryWide::ucode, MemoryUnary::ucode })
+        {
+            MemoryCache cache(shared, 0, schema);
+            const auto wide = schema == MemoryWide::ucode;
+            const auto pkey = MemoryPartition::make(std::uint64_t(1));
+            const auto sort = wide ? sort_key(10) : View();
+            const std::size_t value = wide ? 1 : 0;
+            cache.write(WriteType::Field, 1, pkey, sort, field(value, rdbt::Uint64::make(std::uint64_t(5))), MemoryCache::origin());
+            cache.write(WriteType::Field, 2, pkey, sort, field(value, rdbt::Uint64::make(std::uint64_t(6))), MemoryCache::origin());
+            cache.flush();
+            cache.sync();
+
+            MemoryCache::field_bitmap fields;
+            fields.set(value);
+            std::map<std::size_t, View> values;
+            auto collect = [&](std::size_t field, View data) {
+                values.emplace(field, View::copy(data.data()));
+            };
+            // Only the owner core reads the disk for the query threads
+            EXPECT_FALSE(cache.read_shared(1, sort, fields, collect).has_value()) << wide;
+
+            // Another core reads the flushed segment on its own, a removal in the memtable hides it
+            cache.remove(2, pkey, sort, MemoryCache::origin());
+            std::optional<bool> found, removed, missing;
+            std::thread([&]() {
+                found = cache.read_stolen(1, sort, fields, collect);
+                removed = cache.exists_stolen(2, sort);
+                missing = cache.exists_stolen(3, sort);
+            }).join();
+            ASSERT_EQ(found, std::optional(true)) << wide;
+            ASSERT_EQ(values.size(), 1) << wide;
+            EXPECT_TRUE(equal(values.at(value), rdbt::Uint64::make(std::uint64_t(5)))) << wide;
+            EXPECT_EQ(removed, std::optional(false)) << wide;
+            EXPECT_EQ(missing, std::optional(false)) << wide;
+        }
+    }
+
+    TEST_F(MemoryCacheTest, ReportsStallTransitions)
+    {
+        cfg->cache.stall_hard_flushes = 0;
+        cfg->cache.stall_soft_pressure = 1 << 20;
+        cfg->cache.stall_hard_pressure = 2 << 20;
+        cfg->cache.stall_max_delay = std::chrono::seconds(10);
+        struct Pressure
+        {
+            std::size_t memory;
+            std::size_t partitions;
+            WriteStall stall;
+        };
+        std::vector<Pressure> events;
+        const auto handle = shared.events->listen<Event::MemoryPressure>(
+            [&](std::size_t memory, std::size_t partitions, WriteStall stall) {
+                events.push_back({ memory, partitions, stall });
+            }
+        );
+
+        MemoryCache cache(shared, 0, MemoryWide::ucode);
+        const auto value = rdbt::String::make(std::string_view(std::string(1000, 'v')));
+        std::uint64_t key = 0;
+        auto write_until = [&](WriteStall stall)
+        {
+            // Writes never wait, the delay is left to the core
+            // The state is updated ahead of each write, it reports the partitions written before
+            const auto beg = std::chrono::steady_clock::now();
+            while (cache.stall() != stall && key < 10'000)
+            {
+                key++;
+                cache.write(WriteType::Field, key, MemoryPartition::make(key), sort_key(0), field(2, value), MemoryCache::origin());
+            }
+            EXPECT_LT(std::chrono::steady_clock::now() - beg, cfg->cache.stall_max_delay);
+            ASSERT_EQ(cache.stall(), stall);
+        };
+
+        write_until(WriteStall::Slowdown);
+        ASSERT_EQ(events.size(), 1);
+        EXPECT_EQ(events[0].stall, WriteStall::Slowdown);
+        EXPECT_EQ(events[0].partitions, key - 1);
+        EXPECT_GE(events[0].memory, cfg->cache.stall_soft_pressure);
+        EXPECT_LT(events[0].memory, cfg->cache.stall_hard_pressure);
+        const auto level = cache.stall_level();
+        EXPECT_GT(level, 0.f);
+        EXPECT_LT(level, 1.f);
+
+        write_until(WriteStall::Stop);
+        ASSERT_EQ(events.size(), 2);
+        EXPECT_EQ(events[1].stall, WriteStall::Stop);
+        EXPECT_EQ(events[1].partitions, key - 1);
+        EXPECT_GE(events[1].memory, cfg->cache.stall_hard_pressure);
+        // Without a pending flush the memtable alone is over the limit and the write that flushes it is admitted
+        EXPECT_EQ(cache.stall_level(), 0.f);
+        EXPECT_EQ(cache.stall(), WriteStall::Stop);
+
+        // Queuing the flush reports the pressure it holds, committing it lifts the stall
+        cache.flush();
+        cache.sync();
+        ASSERT_EQ(events.size(), 3);
+        EXPECT_EQ(events[2].stall, WriteStall::Stop);
+        EXPECT_EQ(events[2].partitions, key);
+        EXPECT_EQ(cache.stall_level(), 0.f);
+        EXPECT_EQ(cache.stall(), WriteStall::None);
+        ASSERT_EQ(events.size(), 4);
+        EXPECT_EQ(events[3].stall, WriteStall::None);
+        EXPECT_LT(events[3].memory, cfg->cache.stall_soft_pressure);
+        EXPECT_EQ(events[3].partitions, 0);
+    }
+}
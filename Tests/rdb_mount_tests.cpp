@@ -0,0 +1,162 @@
+#include "rdb_test_env.hpp"
+#include <rdb_mount.hpp>
+
+namespace rdb::test
+{
+    using MountPartition = Topology<Field<"id", rdbt::Uint64>>;
+    using MountWide = Schema<"test_mount_wide", MountPartition, Topology<
+        Field<"ts", rdbt::Uint64, FieldType::Sort>,
+        Field<"value", rdbt::Uint64>,
+        Field<"name", rdbt::String>>>;
+
+    // Queries go through a running mount, keys are spread over a few cores
+    class MountTest : public Environment
+    {
+    protected:
+        std::shared_ptr<Mount> mnt{};
+
+        void SetUp() override
+        {
+            Environment::SetUp();
+            MountWide::require();
+            cfg->mnt.cores = 3;
+        }
+        void TearDown() override
+        {
+            mnt = nullptr;
+            Environment::TearDown();
+        }
+
+        Mount& start()
+        {
+            mnt = Mount::make(*cfg);
+            mnt->start();
+            return *mnt;
+        }
+        static bool equal(const View& lhs, const View& rhs)
+        {
+            return std::ranges::equal(lhs.data(), rhs.data());
+        }
+    };
+
+    coro::Task<void> write_then_read(Mount& mount, std::uint64_t id, std::uint64_t value, View& out, std::thread::id& thread)
+    {
+        std::uint64_t ts = 0;
+        const auto written = co_await (mount.query << (fetch<MountWide>(id, ts) | write<"value">(value)) << execute<Policy::Await>);
+        EXPECT_TRUE(written);
+        co_await (mount.query << (fetch<MountWide>(id, ts) | read<"value">(&out)) << execute<Policy::Await>);
+        thread = std::this_thread::get_id();
+    }
+
+    TEST_F(MountTest, ResumesAwaitedQueriesOnLoop)
+    {
+        auto& mount = start();
+        coro::Loop loop;
+        std::vector<View> values(8, nullptr);
+        std::vector<std::thread::id> threads(values.size());
+        for (std::uint64_t id = 0; id < values.size(); id++)
+            loop.spawn(write_then_read(mount, id, id + 500, values[id], threads[id]));
+        loop.run();
+
+        for (std::uint64_t id = 0; id < values.size(); id++)
+        {
+            EXPECT_TRUE(equal(values[id], rdbt::Uint64::make(id + 500))) << id;
+            // Completed on a core, resumed by the loop
+            EXPECT_EQ(threads[id], std::this_thread::get_id()) << id;
+        }
+    }
+
+    TEST_F(MountTest, RoundTripsBatches)
+    {
+        auto& mount = start();
+        std::vector<cmd::compound_key> keys;
+        std::vector<std::uint64_t> values;
+        for (std::uint64_t id = 0; id < 32; id++)
+        {
+            keys.push_back(cmd::keyset<MountWide>(id, id * 10));
+            values.push_back(id + 1000);
+        }
+        // Written keys only, the rest is fetched as missing
+        const auto written = std::span<const cmd::compound_key>(keys).first(24);
+        mount.query << multi_write<MountWide, "value">(written, values) << execute<>;
+
+        std::map<std::size_t, View> fetched;
+        mount.query << multi_fetch<MountWide, "value">(std::span<const cmd::compound_key>(keys),
+            [&](std::size_t idx, std::size_t field, View value) {
+                EXPECT_EQ(field, MountWide::index_of<"value">());
+                EXPECT_TRUE(fetched.emplace(idx, View::copy(value.data())).second) << idx;
+            }) << execute<>;
+
+        ASSERT_EQ(fetched.size(), written.size());
+        for (std::size_t idx = 0; idx < written.size(); idx++)
+        {
+            ASSERT_TRUE(fetched.contains(idx)) << idx;
+            EXPECT_TRUE(equal(fetched.at(idx), rdbt::Uint64::make(values[idx]))) << idx;
+        }
+    }
+
+    TEST_F(MountTest, CompletesAsyncQueriesAfterBarrier)
+    {
+        auto& mount = start();
+        std::uint64_t id = 3;
+        std::uint64_t ts = 30;
+        std::uint64_t first = 7;
+        std::uint64_t second = 8;
+
+        // The read follows the barrier, the future is only ready once its handler ran
+        View value = nullptr;
+        auto result = mount.query
+            << (fetch<MountWide>(id, ts) | write<"value">(first))
+            << barrier
+            << (fetch<MountWide>(id, ts) | read<"value">(&value))
+            << execute<Policy::Async>;
+        ASSERT_EQ(result.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+        EXPECT_TRUE(result.get());
+        EXPECT_TRUE(equal(value, rdbt::Uint64::make(first)));
+
+        // Atomic queries complete through the callback, which resolves the logged query before the future
+        View updated = nullptr;
+        auto atomic = mount.query
+            << (fetch<MountWide>(id, ts) | write<"value">(second))
+            << barrier
+            << (fetch<MountWide>(id, ts) | read<"value">(&updated))
+            << execute<Policy::Async, Policy::Atomic>;
+        ASSERT_EQ(atomic.wait_for(std::chrono::seconds(10)), std::future_status::ready);
+        EXPECT_TRUE(atomic.get());
+        EXPECT_TRUE(equal(updated, rdbt::Uint64::make(second)));
+    }
+
+    TEST_F(MountTest, AcknowledgesGroupCommitsAfterSync)
+    {
+        cfg->logs.group_commit = true;
+        cfg->logs.group_commit_latency = std::chrono::milliseconds(5);
+        auto& mount = start();
+
+        std::atomic<std::size_t> synced{ 0 };
+        const auto handle = mount.events()->listen<Event::GroupCommit>([&](std::size_t, std::size_t writes) {
+            // Delays the acknowledgement, a write released ahead of the sync would return before this
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            synced += writes;
+        });
+
+        for (std::uint64_t id = 0; id < 16; id++)
+        {
+            std::uint64_t ts = 0;
+            mount.query << (fetch<MountWide>(id, ts) | write<"value">(id)) << execute<>;
+            // Every write before this one was synced as a part of some group
+            EXPECT_GE(synced.load(), id + 1) << id;
+        }
+
+        // Writes of a single query across cores are acknowledged once every core synced
+        std::vector<cmd::compound_key> keys;
+        std::vector<std::uint64_t> values;
+        for (std::uint64_t id = 16; id < 48; id++)
+        {
+            keys.push_back(cmd::keyset<MountWide>(id, std::uint64_t(0)));
+            values.push_back(id);
+        }
+        const auto before = synced.load();
+        mount.query << multi_write<MountWide, "value">(std::span<const cmd::compound_key>(keys), values) << execute<>;
+        EXPECT_GE(synced.load(), before + cfg->mnt.cores);
+    }
+}
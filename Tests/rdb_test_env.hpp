@@ -0,0 +1,95 @@
+#ifndef RDB_TEST_ENV_HPP
+#define RDB_TEST_ENV_HPP
+
+#include <gtest/gtest.h>
+#include <rdb_memory.hpp>
+#include <rdb_schema.hpp>
+#include <rdb_types.hpp>
+#include <filesystem>
+#include <thread>
+#include <map>
+
+namespace rdb::test
+{
+    // Every test runs against its own root directory which is removed once the test ends
+    // The config can be adjusted before the first memory cache (or mount) is created
+    class Environment : public ::testing::Test
+    {
+    protected:
+        std::shared_ptr<Config> cfg{ std::make_shared<Config>() };
+        Shared shared{};
+
+        void SetUp() override
+        {
+            const auto* test = ::testing::UnitTest::GetInstance()->current_test_info();
+            cfg->root = std::filesystem::temp_directory_path()/"rdb_tests"/test->test_suite_name()/test->name();
+            std::filesystem::remove_all(cfg->root);
+            std::filesystem::create_directories(cfg->root/"C0");
+            cfg->mnt.numa = false;
+            cfg->mnt.logs.root = cfg->root/"logs";
+            cfg->mnt.logs.handle_signals = false;
+
+            shared.cfg = cfg;
+            shared.logs = rs::RuntimeLogs::make(cfg->mnt.logs);
+            shared.events = std::make_shared<EventStore>();
+        }
+        void TearDown() override
+        {
+            std::error_code ec;
+            std::filesystem::remove_all(cfg->root, ec);
+        }
+
+        // Directory of the flushes of a memory cache on the first core
+        std::filesystem::path flush_path(schema_type schema) const
+        {
+            return cfg->root/"C0"/std::format("[{}]", uuid::encode(schema, uuid::table_alnum))/"flush";
+        }
+        // Waits (with a timeout) until a condition observed through the memory cache holds
+        template<typename Func>
+        static bool wait_for(Func&& func, std::chrono::milliseconds timeout = std::chrono::seconds(10))
+        {
+            const auto until = std::chrono::steady_clock::now() + timeout;
+            while (!func())
+            {
+                if (std::chrono::steady_clock::now() > until)
+                    return false;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return true;
+        }
+    };
+
+    // Key of a partition as the mount derives it, replay of created partitions hashes it the same way
+    inline key_type partition_key(schema_type schema, const View& partition)
+    {
+        return RuntimeSchemaReflection::info(schema).hash_partition(partition.data().data());
+    }
+    // Sorting key of an ascending unsigned field
+    inline View sort_key(std::uint64_t value)
+    {
+        auto key = View::copy(rdbt::Uint64::mpstorage(Order::Ascending, value));
+        rdbt::Uint64::mpinline(key.mutate(), Order::Ascending, value);
+        return key;
+    }
+    // Payload of a field write, the field index followed by the value
+    inline std::vector<unsigned char> field(unsigned char index, const View& value)
+    {
+        std::vector<unsigned char> out{ index };
+        out.insert(out.end(), value.data().begin(), value.data().end());
+        return out;
+    }
+    // Reads a set of fields, values are copied out of the callback
+    inline std::map<std::size_t, View> read(MemoryCache& cache, key_type key, const View& sort, std::initializer_list<std::size_t> fields)
+    {
+        MemoryCache::field_bitmap bitmap;
+        for (const auto it : fields)
+            bitmap.set(it);
+        std::map<std::size_t, View> result;
+        cache.read(key, sort, bitmap, [&](std::size_t field, View value) {
+            result.emplace(field, View::copy(value.data()));
+        });
+        return result;
+    }
+}
+
+#endif // RDB_TEST_ENV_HPP
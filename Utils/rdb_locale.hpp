@@ -334,60 +334,24 @@ namespace rdb::byte
 	template<typename Key, typename Value>
 	std::optional<Value> search_partition(const Key& key, std::span<const unsigned char> data, std::size_t cells, bool closest = false) noexcept
 	{
-		std::size_t off = 0;
-		std::size_t partition_left = 0;
-		std::size_t partition_right = cells - 1;
-		std::size_t optimal = ~0ull;
-		bool has_optimal = false;
-
-		do
+		// Cells are sorted in ascending order, the closest cell is the last one below the key
+		constexpr auto cell = sizeof(Key) + sizeof(Value);
+		std::size_t left = 0;
+		std::size_t right = cells;
+		while (left < right)
 		{
-			const auto idx = (
-				partition_left + (
-					(partition_right - partition_left) / 2
-				)
-			);
-
-			const auto v = byte::sread<Key>(
-				data.subspan(off + idx *
-					(sizeof(Key) + sizeof(Value))
-				)
-			);
-
-			if (v > key)
-			{
-				partition_left = idx + 1;
-			}
-			else if (v < key)
-			{
-				partition_right = idx - 1;
-				optimal = idx;
-				has_optimal = true;
-			}
+			const auto idx = left + (right - left) / 2;
+			const auto v = byte::sread<Key>(data.subspan(idx * cell));
+			if (v == key)
+				return byte::sread<Value>(data.subspan(idx * cell + sizeof(Key)));
+			if (v < key)
+				left = idx + 1;
 			else
-			{
-				return byte::sread<Value>(
-					data.subspan(idx *
-						(sizeof(Key) + sizeof(Value)) +
-						sizeof(Key)
-					)
-				);
-			}
-		} while (partition_left <= partition_right);
-
-		if (closest)
-		{
-			if (!has_optimal)
-				return std::nullopt;
-			return byte::sread<Value>(
-				data.subspan(optimal *
-					(sizeof(Key) + sizeof(Value)) +
-					sizeof(Key)
-				)
-			);
+				right = idx;
 		}
-		else
+		if (!closest || left == 0)
 			return std::nullopt;
+		return byte::sread<Value>(data.subspan((left - 1) * cell + sizeof(Key)));
 	}
 
 	template<typename Value>
@@ -451,6 +415,26 @@ namespace rdb::byte
 			return std::nullopt;
 	}
 
+	// Index of the last cell whose key is not greater than the searched key (cells sorted in byte order)
+	template<typename Value>
+	std::optional<std::size_t> search_floor(std::span<const unsigned char> key, std::span<const unsigned char> data, std::size_t prefix, std::size_t cells) noexcept
+	{
+		std::size_t left = 0;
+		std::size_t right = cells;
+		while (left < right)
+		{
+			const auto idx = left + (right - left) / 2;
+			const auto v = data.subspan(idx * (prefix + sizeof(Value)), prefix);
+			if (binary_compare(v, key) <= 0)
+				left = idx + 1;
+			else
+				right = idx;
+		}
+		if (left == 0)
+			return std::nullopt;
+		return left - 1;
+	}
+
 	template<typename Offset, typename Value, typename Size>
 	std::optional<Value> search_partition_binary_indirect(std::span<const unsigned char> key, std::span<const unsigned char> data, std::span<const unsigned char> storage, std::size_t cells, bool ascending, bool closest = false) noexcept
 	{
@@ -59,9 +59,12 @@ namespace rdb
 #		ifdef __unix__
         if (_memory != nullptr && !_vmap)
         {
+            // msync requires a page aligned address
+            static const auto page = std::size_t(sysconf(_SC_PAGESIZE));
+            const auto base = pos - pos % page;
             msync(
-                static_cast<char*>(_memory) + pos,
-                size,
+                static_cast<char*>(_memory) + base,
+                size + (pos - base),
                 MS_SYNC
             );
         }
@@ -1,5 +1,4 @@
 #include <rdb_shared_buffer.hpp>
-#include <XXHash/xxhash.hpp>
 
 namespace rdb
 {
@@ -11,10 +10,6 @@ namespace rdb
 	{
 		return _size;
 	}
-	std::uint64_t BlockSourceMultiplexer::digest() const noexcept
-	{
-		return _digest;
-	}
 	bool BlockSourceMultiplexer::empty() const noexcept
 	{
 		return _size == 0;
@@ -29,7 +24,6 @@ namespace rdb
 	}
 	void BlockSourceMultiplexer::flush() noexcept
 	{
-		xxh::hash_state_t<64> state;
 		_block.resize(_size);
 		std::size_t idx = 0;
 		for (decltype(auto) it : _input)
@@ -37,19 +31,16 @@ namespace rdb
 			_block[idx++] = it.data[0];
 			if (!it.key.empty())
 			{
-				state.update(it.key.begin(), it.key.end());
 				const std::uint16_t len = it.key.size();
 				std::memcpy(_block.data() + idx, &len, sizeof(len));
 				idx += sizeof(len);
 				std::memcpy(_block.data() + idx, it.key.data(), it.key.size());
 				idx += it.key.size();
 			}
-			state.update(it.data.begin(), it.data.end());
 			std::memcpy(_block.data() + idx, it.data.data() + 1, it.data.size() - 1);
 			idx += it.data.size() - 1;
 		}
 		_input.clear();
-		_digest = state.digest();
 	}
 	void BlockSourceMultiplexer::clear() noexcept
 	{
@@ -26,7 +26,6 @@ namespace rdb
 		std::pmr::vector<unsigned char> _block{ &_block_pool };
 		std::size_t _size{ 0 };
 		std::size_t _pos{ 0 };
-		std::uint64_t _digest{};
 	public:
 		BlockSourceMultiplexer(std::span<unsigned char> block, std::span<Node> fragments) :
 			_pool(fragments.data(), fragments.size() * sizeof(Node)),
@@ -40,7 +39,6 @@ namespace rdb
 
 		std::size_t fragments() const noexcept;
 		std::size_t size() const noexcept;
-		std::uint64_t digest() const noexcept;
 		bool empty() const noexcept;
 
 		void push(Node node) noexcept;
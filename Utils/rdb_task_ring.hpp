@@ -52,15 +52,16 @@ namespace rdb::ct
             _available.release();
             return true;
         }
-        std::size_t _dequeue_impl(Type& value) noexcept
+        // Returns false (and the observed head to wait on) if there is nothing to dequeue
+        bool _dequeue_impl(Type& value, std::size_t& head) noexcept
         {
             std::size_t tail = _tail.load();
-            if (const auto head = _head_check.load();
-                head <= tail)
-                return head;
+            head = _head_check.load();
+            if (head <= tail)
+                return false;
             value = std::move(_ring[tail & _mask]);
             _tail.fetch_add(1);
-            return 0;
+            return true;
         }
     public:
         TaskRing() = default;
@@ -80,25 +81,44 @@ namespace rdb::ct
 
         bool try_dequeue(Type& value) noexcept
         {
-            return !_dequeue_impl(value);
+            std::size_t head = 0;
+            return _dequeue_impl(value, head);
+        }
+        // Safe with any number of consumers (the dequeues assume a single one), never blocks
+        // A slot copied by a consumer that loses the race for it is discarded
+        bool try_steal(Type& value) noexcept
+        {
+            std::size_t tail = _tail.load();
+            while (tail < _head_check.load())
+            {
+                Type copy = _ring[tail & _mask];
+                if (_tail.compare_exchange_weak(tail, tail + 1))
+                {
+                    (void)_available.try_acquire();
+                    value = std::move(copy);
+                    return true;
+                }
+            }
+            return false;
         }
         bool dequeue(Type& value) noexcept
         {
             std::size_t head = 0;
-            while ((head = _dequeue_impl(value)))
+            while (!_dequeue_impl(value, head))
                 _head_check.wait(head);
             return true;
         }
         bool dequeue(Type& value, std::chrono::microseconds max) noexcept
         {
             const auto beg = std::chrono::steady_clock::now();
+            std::size_t head = 0;
             do
             {
                 if (std::chrono::steady_clock::now() - beg > max ||
                         !_available.try_acquire_for(max))
                     return false;
             }
-            while (_dequeue_impl(value));
+            while (!_dequeue_impl(value, head));
             return true;
         }
 
@@ -735,6 +735,44 @@ namespace rdb
 		void spinlock_yield() noexcept;
 		void bind_thread(std::size_t core) noexcept;
 
+		// Reader-writer spinlock for short critical sections, readers never block each other
+		// A waiting writer keeps new readers out
+		class SharedSpinlock
+		{
+		private:
+			static constexpr std::uint32_t _writer = 1u << 31;
+
+			std::atomic<std::uint32_t> _state{ 0 };
+		public:
+			void lock() noexcept
+			{
+				while (_state.fetch_or(_writer, std::memory_order::acquire) & _writer)
+					util::spinlock_yield();
+				while (_state.load(std::memory_order::acquire) != _writer)
+					util::spinlock_yield();
+			}
+			void unlock() noexcept
+			{
+				_state.fetch_and(~_writer, std::memory_order::release);
+			}
+			void lock_shared() noexcept
+			{
+				auto state = _state.load(std::memory_order::relaxed);
+				while (true)
+				{
+					if (!(state & _writer) &&
+						_state.compare_exchange_weak(state, state + 1, std::memory_order::acquire, std::memory_order::relaxed))
+						return;
+					util::spinlock_yield();
+					state = _state.load(std::memory_order::relaxed);
+				}
+			}
+			void unlock_shared() noexcept
+			{
+				_state.fetch_sub(1, std::memory_order::release);
+			}
+		};
+
 		template<typename Type>
         void nano_wait_for(const std::atomic<Type>& var, const Type& value, std::memory_order order = std::memory_order::seq_cst) noexcept
 		{
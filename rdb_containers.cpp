@@ -1,3 +1,72 @@
 #include <rdb_containers.hpp>
 
-namespace rdb::ct::impl {}
+namespace rdb::ct
+{
+	Arena::Arena(Arena&& copy) noexcept :
+		_chunks(std::exchange(copy._chunks, nullptr)),
+		_ptr(std::exchange(copy._ptr, nullptr)),
+		_end(std::exchange(copy._end, nullptr)),
+		_used(std::exchange(copy._used, 0)),
+		_reserved(std::exchange(copy._reserved, 0))
+	{}
+	Arena::~Arena()
+	{
+		release();
+	}
+
+	void* Arena::_allocate_slow(std::size_t size, std::size_t align) noexcept
+	{
+		const auto required = size + align;
+		if (required > _large_size)
+		{
+			// Linked behind the current chunk so the bump region stays usable
+			auto* chunk = new (operator new(sizeof(Chunk) + required)) Chunk{ nullptr, sizeof(Chunk) + required };
+			if (_chunks == nullptr)
+				_chunks = chunk;
+			else
+			{
+				chunk->next = _chunks->next;
+				_chunks->next = chunk;
+			}
+			_reserved += chunk->size;
+			_used += required;
+			const auto addr = reinterpret_cast<std::uintptr_t>(chunk + 1);
+			return reinterpret_cast<void*>((addr + align - 1) & ~(align - 1));
+		}
+
+		auto* chunk = new (operator new(_chunk_size)) Chunk{ _chunks, _chunk_size };
+		_chunks = chunk;
+		_reserved += _chunk_size;
+		_ptr = reinterpret_cast<unsigned char*>(chunk + 1);
+		_end = reinterpret_cast<unsigned char*>(chunk) + _chunk_size;
+		return allocate(size, align);
+	}
+
+	void Arena::release() noexcept
+	{
+		while (_chunks != nullptr)
+		{
+			auto* next = _chunks->next;
+			operator delete(_chunks);
+			_chunks = next;
+		}
+		_ptr = nullptr;
+		_end = nullptr;
+		_used = 0;
+		_reserved = 0;
+	}
+
+	Arena& Arena::operator=(Arena&& copy) noexcept
+	{
+		if (this != &copy)
+		{
+			release();
+			_chunks = std::exchange(copy._chunks, nullptr);
+			_ptr = std::exchange(copy._ptr, nullptr);
+			_end = std::exchange(copy._end, nullptr);
+			_used = std::exchange(copy._used, 0);
+			_reserved = std::exchange(copy._reserved, 0);
+		}
+		return *this;
+	}
+}
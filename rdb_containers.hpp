@@ -5,11 +5,88 @@
 #include <LibART/src/art.h>
 #include <jemalloc/jemalloc.h>
 #include <span>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
 #include <vector>
 #include <string>
 
 namespace rdb::ct
 {
+	// Bump allocator that releases all of its memory at once
+	// Not synchronized, meant to be owned by a single writer
+	class Arena
+	{
+	private:
+		static constexpr std::size_t _chunk_size = 64 * 1024;
+		// Larger allocations get a dedicated chunk instead of wasting the current one
+		static constexpr std::size_t _large_size = _chunk_size / 4;
+
+		struct alignas(std::max_align_t) Chunk
+		{
+			Chunk* next{ nullptr };
+			std::size_t size{ 0 };
+		};
+
+		Chunk* _chunks{ nullptr };
+		unsigned char* _ptr{ nullptr };
+		unsigned char* _end{ nullptr };
+		std::size_t _used{ 0 };
+		std::size_t _reserved{ 0 };
+
+		void* _allocate_slow(std::size_t size, std::size_t align) noexcept;
+	public:
+		Arena() = default;
+		Arena(const Arena&) = delete;
+		Arena(Arena&& copy) noexcept;
+		~Arena();
+
+		void* allocate(std::size_t size, std::size_t align) noexcept
+		{
+			const auto addr = (reinterpret_cast<std::uintptr_t>(_ptr) + align - 1) & ~(align - 1);
+			auto* ptr = reinterpret_cast<unsigned char*>(addr);
+			[[ unlikely ]] if (_ptr == nullptr || ptr + size > _end)
+				return _allocate_slow(size, align);
+			_used += ptr + size - _ptr;
+			_ptr = ptr + size;
+			return ptr;
+		}
+		// Grows the most recent allocation if the current chunk has room
+		bool extend(void* ptr, std::size_t size, std::size_t nsize) noexcept
+		{
+			auto* beg = static_cast<unsigned char*>(ptr);
+			if (beg + size != _ptr || beg + nsize > _end)
+				return false;
+			_used += nsize - size;
+			_ptr = beg + nsize;
+			return true;
+		}
+		std::span<unsigned char> copy(std::span<const unsigned char> data) noexcept
+		{
+			auto* ptr = static_cast<unsigned char*>(allocate(data.size(), 1));
+			std::memcpy(ptr, data.data(), data.size());
+			return std::span(ptr, data.size());
+		}
+
+		// Bytes handed out (including alignment padding)
+		std::size_t used() const noexcept
+		{
+			return _used;
+		}
+		// Bytes held by the chunks
+		std::size_t reserved() const noexcept
+		{
+			return _reserved;
+		}
+
+		void release() noexcept;
+
+		Arena& operator=(const Arena&) = delete;
+		Arena& operator=(Arena&& copy) noexcept;
+	};
+
 	namespace impl
 	{
 		template<typename Type>
@@ -71,6 +148,47 @@ namespace rdb::ct
 			using const_pointer = const Node*;
 		private:
 			mutable art_tree _tree{};
+			// Nodes and the tree itself are placed in the arena (if any) and released together with it
+			Arena* _arena{ nullptr };
+
+			void _init() noexcept
+			{
+				if (_arena == nullptr)
+				{
+					art_tree_init(&_tree);
+					return;
+				}
+				art_tree_init_alloc(&_tree, +[](void* arena, std::uint64_t size) -> void* {
+					return static_cast<Arena*>(arena)->allocate(size, alignof(void*));
+				}, nullptr, _arena);
+			}
+
+			template<typename... Argv>
+			pointer _make_node(Argv&&... args) noexcept
+			{
+				if (_arena != nullptr)
+					return arena_node(*_arena, std::forward<Argv>(args)...);
+				return allocate_node(std::forward<Argv>(args)...);
+			}
+			void* _insert_impl(const_key key, void* node, bool replace) noexcept
+			{
+				return replace ?
+					art_insert(&_tree, key.data(), key.size(), node) :
+					art_insert_no_replace(&_tree, key.data(), key.size(), node);
+			}
+			void* _delete_impl(const_key key) noexcept
+			{
+				return art_delete(&_tree, key.data(), key.size());
+			}
+			void _free_node(pointer ptr) noexcept
+			{
+				if (ptr == nullptr)
+					return;
+				if (_arena != nullptr)
+					ptr->~Node();
+				else
+					delete_node(ptr);
+			}
 		public:
 			template<typename... Argv>
 			static pointer allocate_node(Argv&&... args) noexcept
@@ -82,6 +200,16 @@ namespace rdb::ct
 				new (buffer) Node{ std::forward<Argv>(args)... };
 				return buffer;
 			}
+			template<typename... Argv>
+			static pointer arena_node(Arena& arena, Argv&&... args) noexcept
+			{
+				auto* buffer = static_cast<pointer>(arena.allocate(
+					Node::allocation_size(args...),
+					alignof(Node)
+				));
+				new (buffer) Node{ std::forward<Argv>(args)... };
+				return buffer;
+			}
 			static void delete_node(pointer ptr) noexcept
 			{
 				ptr->~Node();
@@ -90,11 +218,17 @@ namespace rdb::ct
 		public:
 			ArtWrapper()
 			{
-				art_tree_init(&_tree);
+				_init();
+			}
+			explicit ArtWrapper(Arena* arena)
+				: _arena(arena)
+			{
+				_init();
 			}
 			ArtWrapper(ArtWrapper&& copy)
 			{
 				_tree = copy._tree;
+				_arena = copy._arena;
 				copy._tree = art_tree();
 			}
 			~ArtWrapper()
@@ -106,46 +240,35 @@ namespace rdb::ct
 			{
 				return art_size(&_tree);
 			}
+			Arena* arena() const noexcept
+			{
+				return _arena;
+			}
 
 			template<typename... Argv>
 			pointer insert(const_key key, Argv&&... args) noexcept
 			{
-				auto* buffer = allocate_node(std::forward<Argv>(args)...);
-				if (auto* ptr = art_insert(
-						&_tree,
-						key.data(),
-						key.size(),
-						buffer
-					); ptr != nullptr)
+				auto* buffer = _make_node(std::forward<Argv>(args)...);
+				if (auto* ptr = _insert_impl(key, buffer, true); ptr != nullptr)
 				{
-					delete_node(static_cast<pointer>(ptr));
+					_free_node(static_cast<pointer>(ptr));
 				}
 				return buffer;
 			}
 			template<typename... Argv>
 			pointer insert(const_key key, Node* node) noexcept
 			{
-				if (auto* ptr = art_insert(
-						&_tree,
-						key.data(),
-						key.size(),
-						node
-					); ptr != nullptr)
+				if (auto* ptr = _insert_impl(key, node, true); ptr != nullptr)
 				{
-					delete_node(static_cast<pointer>(ptr));
+					_free_node(static_cast<pointer>(ptr));
 				}
 				return node;
 			}
 			template<typename... Argv>
 			pointer emplace(const_key key, Argv&&... args) noexcept
 			{
-				auto* buffer = allocate_node(std::forward<Argv>(args)...);
-				if (auto* ptr = art_insert(
-						&_tree,
-						key.data(),
-						key.size(),
-						buffer
-					); ptr != nullptr)
+				auto* buffer = _make_node(std::forward<Argv>(args)...);
+				if (auto* ptr = _insert_impl(key, buffer, true); ptr != nullptr)
 				{
 					return ptr;
 				}
@@ -154,12 +277,7 @@ namespace rdb::ct
 			template<typename... Argv>
 			pointer emplace(const_key key, Node* node) noexcept
 			{
-				if (auto* ptr = art_insert_no_replace(
-						&_tree,
-						key.data(),
-						key.size(),
-						node
-					); ptr != nullptr)
+				if (auto* ptr = _insert_impl(key, node, false); ptr != nullptr)
 				{
 					return ptr;
 				}
@@ -191,9 +309,9 @@ namespace rdb::ct
 			}
 			void remove(const_key key) noexcept
 			{
-				delete_node(
+				_free_node(
 					static_cast<pointer>(
-						art_delete(&_tree, key.data(), key.size())
+						_delete_impl(key)
 					)
 				);
 			}
@@ -219,12 +337,16 @@ namespace rdb::ct
 			{
 				if (_tree.root != nullptr)
 				{
-					art_iter(&_tree, +[](void*, const unsigned char* key, unsigned int, void* value) -> int {
-						delete_node(static_cast<pointer>(value));
-						return 0;
-					}, nullptr);
+					// Arena nodes without destructors are released with the arena
+					if (_arena == nullptr || !std::is_trivially_destructible_v<Node>)
+					{
+						art_iter(&_tree, +[](void* self, const unsigned char* key, unsigned int, void* value) -> int {
+							static_cast<ArtWrapper*>(self)->_free_node(static_cast<pointer>(value));
+							return 0;
+						}, this);
+					}
 					art_tree_destroy(&_tree);
-					art_tree_init(&_tree);
+					_init();
 				}
 			}
 
@@ -252,11 +374,12 @@ namespace rdb::ct
 				}
 			}
 
+			// Visits keys greater or equal to start in byte order
 			void foreach(const_key start, std::function<bool(const_key, const_pointer)> callback) const noexcept
 			{
 				if (_tree.root != nullptr)
 				{
-					art_iter_prefix(&_tree, start.data(), start.size(), +[](void* dat, const unsigned char* key, unsigned int len, void* value) -> int {
+					art_iter_from(&_tree, start.data(), start.size(), +[](void* dat, const unsigned char* key, unsigned int len, void* value) -> int {
 						return !(*static_cast<std::function<bool(const_key, const_pointer)>*>(dat))
 							(const_key(key, len),
 							 static_cast<const_pointer>(value));
@@ -267,7 +390,7 @@ namespace rdb::ct
 			{
 				if (_tree.root != nullptr)
 				{
-					art_iter_prefix(&_tree, start.data(), start.size(), +[](void* dat, const unsigned char* key, unsigned int len, void* value) -> int {
+					art_iter_from(&_tree, start.data(), start.size(), +[](void* dat, const unsigned char* key, unsigned int len, void* value) -> int {
 						return !(*static_cast<std::function<bool(const_key, pointer)>*>(dat))
 							(const_key(key, len),
 							 static_cast<pointer>(value));
@@ -279,6 +402,7 @@ namespace rdb::ct
 			ArtWrapper& operator=(ArtWrapper&& copy) noexcept
 			{
 				_tree = copy._tree;
+				_arena = copy._arena;
 				copy._tree = art_tree();
 				return *this;
 			}
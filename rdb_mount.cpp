@@ -2,8 +2,13 @@
 #include <rdb_mount.hpp>
 #include <rdb_reflect.hpp>
 #include <rdb_locale.hpp>
+#include <rdb_write_buffer.hpp>
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <limits>
 #include <format>
+#include <shared_mutex>
 
 namespace rdb
 {
@@ -28,12 +33,25 @@ namespace rdb
         lcfg.root = _shared.cfg->root/"logs";
         _shared.logs = rs::RuntimeLogs::make(std::move(lcfg));
         _shared.events = std::make_shared<EventStore>();
+        _shared.write_buffer = std::make_shared<WriteBuffer>(_shared.cfg->cache.write_buffer);
+        _shared.tails = std::make_shared<LogTailRegistry>();
+        if (_shared.cfg->logs.log_pool_size)
+            _shared.shard_worker = std::make_shared<LogShardWorker>();
     }
 
     std::size_t Mount::cores() const noexcept
     {
         return _threads.size();
     }
+    Mount::CoreLoad Mount::load(std::size_t core) const noexcept
+    {
+        const auto& load = _threads[core].load;
+        return CoreLoad{
+            .depth = load.depth.load(std::memory_order::relaxed),
+            .executed = load.executed.load(std::memory_order::relaxed),
+            .latency = std::chrono::nanoseconds(load.latency.load(std::memory_order::relaxed))
+        };
+    }
     rs::RuntimeLogs::ptr Mount::logs() const noexcept
     {
         return _shared.logs;
@@ -51,7 +69,39 @@ namespace rdb
             util::bind_thread(core);
         }
 
-        ct::hash_map<schema_type, MemoryCache> schemas;
+        // Blocks and pages read by every schema of the core share one cache each (outlive the memory caches)
+        const auto disk_cache = DiskCache::make(_shared.cfg->cache.cache_type, _shared.cfg->cache.max_cache_volume);
+        const auto page_cache = _shared.cfg->cache.cache_page ?
+            std::make_unique<PageCache>(_shared.cfg->cache.max_page_cache_volume) : nullptr;
+
+        // Caches have stable addresses, they are published to readers on other threads
+        struct Schema
+        {
+            std::unique_ptr<MemoryCache> cache{ nullptr };
+            // Tasks since the last idle sweep
+            std::size_t tasks{ 0 };
+            // Earliest admission of the next write while the cache is slowed down
+            std::chrono::steady_clock::time_point admit{};
+        };
+        ct::hash_map<schema_type, Schema> schemas;
+        auto publish = [&](schema_type schema, MemoryCache* cache)
+        {
+            auto& caches = _threads[core].caches;
+            std::lock_guard lock(caches.lock);
+            if (cache == nullptr)
+                caches.map.clear();
+            else
+                caches.map[schema] = cache;
+        };
+        auto unpublish = [&](schema_type schema)
+        {
+            auto& caches = _threads[core].caches;
+            std::lock_guard lock(caches.lock);
+            caches.map.erase(schema);
+        };
+
+        _core_mount = this;
+        _core_id = core;
 
         // Replay all logs
 
@@ -63,11 +113,11 @@ namespace rdb
                     s.substr(1, s.size() - 2),
                     uuid::table_alnum
                 );
-            schemas.emplace(
-                std::piecewise_construct,
-                std::forward_as_tuple(schema),
-                std::forward_as_tuple(_shared, core, schema)
+            const auto f = schemas.emplace(
+                schema,
+                Schema{ .cache = std::make_unique<MemoryCache>(_shared, core, schema, disk_cache.get(), page_cache.get()) }
             );
+            publish(schema, f.first->second.cache.get());
         }
 
         // Wait for requests
@@ -78,33 +128,265 @@ namespace rdb
         std::size_t spin_ctr = 0;
         std::size_t yield_ctr = 0;
 
+        // Group commit, a single log sync per drained batch of writes
+        auto commit = [&](Thread& t)
+        {
+            for (auto& [ _, entry ] : schemas)
+                entry.cache->sync_logs();
+            if (!t.commit_group.empty())
+                _shared.events->trigger<Event::GroupCommit>(core, t.commit_group.size());
+            for (decltype(auto) it : t.commit_group)
+                it->release();
+            t.commit_group.clear();
+        };
+        // Once the mount is over its write buffer the largest memtable of the core is flushed
+        // Cores holding only small memtables leave it to the others, stalled caches are already behind on their flushes
+        auto relieve = [&]()
+        {
+            MemoryCache* largest = nullptr;
+            for (auto& [ _, entry ] : schemas)
+                if ((largest == nullptr || entry.cache->pressure() > largest->pressure()) &&
+                    entry.cache->stall_level() <= 0.f)
+                    largest = entry.cache.get();
+            if (largest != nullptr && _shared.write_buffer->candidate(largest->pressure()))
+            {
+                RDB_TRACE(mnt, "C", core, " Write buffer exceeded (", _shared.write_buffer->usage(), " bytes)")
+                largest->flush();
+            }
+        };
+        // Writes to a stalled cache are held by the core instead of parking it, in arrival order
+        // Later tasks of a query with held tasks are held behind them so that its reads follow its writes
+        struct Deferred
+        {
+            Task task;
+            std::chrono::steady_clock::time_point ready;
+        };
+        std::deque<Deferred> deferred;
+        auto is_write = [](Task::Op op)
+        {
+            return
+                op == Task::Op::Create || op == Task::Op::Remove || op == Task::Op::Reset ||
+                op == Task::Op::Write || op == Task::Op::WProc || op == Task::Op::MultiWrite;
+        };
+        auto schema_of = [&](schema_type schema) -> Schema&
+        {
+            auto f = schemas.find(schema);
+            [[ unlikely ]] if (f == schemas.end())
+            {
+                f = schemas.emplace(
+                        schema,
+                        Schema{ .cache = std::make_unique<MemoryCache>(_shared, core, schema, disk_cache.get(), page_cache.get()) }
+                    ).first;
+                publish(schema, f->second.cache.get());
+            }
+            return f->second;
+        };
+        auto run = [&](Thread& t, Schema& entry, const Task& task)
+        {
+            entry.tasks++;
+            _dispatch(t, entry.cache.get(), task);
+            [[ unlikely ]] if (_shared.write_buffer->exceeded())
+                relieve();
+        };
+        // Zero runs the task, otherwise the time it has to be held until
+        auto hold = [&](Schema& entry, const Task& task, std::chrono::steady_clock::time_point now)
+        {
+            using time_point = std::chrono::steady_clock::time_point;
+            if (task.state != nullptr &&
+                std::ranges::any_of(deferred, [&](const auto& it) { return it.task.state == task.state; }))
+                return now;
+            if (!is_write(task.op))
+                return time_point();
+            const auto level = entry.cache->stall_level();
+            [[ likely ]] if (level <= 0.f)
+                return time_point();
+            const auto delay = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                _shared.cfg->cache.stall_max_delay * std::min(level, 1.f)
+            );
+            // Stopped writes are retried after the longest delay, slowed down writes are spaced out
+            if (level >= 1.f)
+                return now + delay;
+            entry.admit = std::max(now, entry.admit) + delay;
+            return entry.admit;
+        };
+        auto resume = [&](Thread& t, std::chrono::steady_clock::time_point now)
+        {
+            while (!deferred.empty() && deferred.front().ready <= now)
+            {
+                auto& front = deferred.front();
+                auto& entry = schema_of(front.task.schema);
+                if (is_write(front.task.op) && entry.cache->stall_level() >= 1.f)
+                {
+                    front.ready = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                        _shared.cfg->cache.stall_max_delay
+                    );
+                    break;
+                }
+                const auto task = front.task;
+                deferred.pop_front();
+                run(t, entry, task);
+                t.load.depth.fetch_sub(1, std::memory_order::relaxed);
+            }
+        };
+
+        // Caches without tasks since the last sweep are flushed, and unloaded by the sweep once nothing runs in their background
+        auto last_sweep = std::chrono::steady_clock::now();
+        auto sweep = [&](std::chrono::steady_clock::time_point now)
+        {
+            const auto interval = _shared.cfg->cache.idle_unload;
+            if (!interval.count() || now - last_sweep < interval)
+                return;
+            last_sweep = now;
+            for (auto it = schemas.begin(); it != schemas.end();)
+            {
+                auto& [ schema, entry ] = *it;
+                if (entry.tasks == 0 && entry.cache->locks() == 0 &&
+                    std::ranges::none_of(deferred, [&](const auto& it) { return it.task.schema == schema; }))
+                {
+                    if (entry.cache->pressure() != 0)
+                    {
+                        if (entry.cache->stall_level() <= 0.f)
+                            entry.cache->flush();
+                    }
+                    else if (entry.cache->idle())
+                    {
+                        RDB_LOG(mnt, "C", core, " Unloading idle memory cache")
+                        unpublish(schema);
+                        schemas.erase(it++);
+                        continue;
+                    }
+                }
+                entry.tasks = 0;
+                ++it;
+            }
+        };
+
         while (true)
         {
             auto& t = _threads[core];
-            Thread::task task;
-            if (_shared.cfg->mnt.cpu_profile == Config::Mount::CPUProfile::OptimizeUsage ?
-                    t.queue.dequeue(task) :
-                    t.queue.try_dequeue(task))
+            [[ unlikely ]] if (!deferred.empty())
+                resume(t, std::chrono::steady_clock::now());
+            // Held writes are resumed on time even if nothing else arrives
+            const auto until = deferred.empty() ?
+                std::chrono::microseconds(0) :
+                std::max(
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        deferred.front().ready - std::chrono::steady_clock::now()
+                    ),
+                    std::chrono::microseconds(1)
+                );
+            Task task;
+            // Never block while writes wait for their sync
+            // Idle sweeps need the core to wake up on its own
+            if ((!t.commit_group.empty() ||
+                    _shared.cfg->mnt.cpu_profile == Config::Mount::CPUProfile::OptimizeSpeed) ?
+                    t.queue.try_dequeue(task) :
+                 until.count() ?
+                    t.queue.dequeue(task, until) :
+                 _shared.cfg->cache.idle_unload.count() ?
+                    t.queue.dequeue(task, _shared.cfg->cache.idle_unload) :
+                    t.queue.dequeue(task))
             {
-                [[ unlikely ]] if (task.second == nullptr)
+                [[ unlikely ]] if (task.op == Task::Op::Stop)
+                {
+                    // Held writes are admitted regardless of the stall
+                    for (decltype(auto) it : deferred)
+                    {
+                        run(t, schema_of(it.task.schema), it.task);
+                        t.load.depth.fetch_sub(1, std::memory_order::relaxed);
+                    }
+                    deferred.clear();
+                    // Reads nobody stole are run before the caches go
+                    for (Task read; t.reads.try_steal(read);)
+                        run(t, schema_of(read.schema), read);
+                    commit(t);
+                    publish(0, nullptr);
                     break;
+                }
+
+                // Every 16th task is timed for the load estimate
+                const auto sample = (t.load.executed.fetch_add(1, std::memory_order::relaxed) & 15) == 0;
+                const auto beg = sample ?
+                    std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+
+                // Held tasks stay counted in the depth of the core until they run
+                bool held = false;
+                [[ unlikely ]] if (task.op == Task::Op::Complete)
+                {
+                    _query_async_complete(static_cast<AsyncParserState*>(task.state), false);
+                }
+                else if (task.op == Task::Op::Steal)
+                {
+                    auto& victim = _threads[task.size];
+                    if (Task read; victim.reads.try_steal(read))
+                        _run_stolen(victim, read);
+                }
+                else
+                {
+                    auto& entry = schema_of(task.schema);
+                    const auto ready = hold(entry, task, std::chrono::steady_clock::now());
+                    held = ready != std::chrono::steady_clock::time_point();
+                    if (held)
+                        deferred.push_back({ .task = task, .ready = ready });
+                    else
+                        run(t, entry, task);
+                }
 
-                auto f = schemas.find(task.first);
-                [[ unlikely ]] if (f == schemas.end())
+                if (sample)
                 {
-                    f = schemas.emplace(
-                            std::piecewise_construct,
-                            std::forward_as_tuple(task.first),
-                            std::forward_as_tuple(_shared, core, task.first)
-                        ).first;
+                    const auto now = std::chrono::steady_clock::now();
+                    const std::uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        now - beg
+                    ).count();
+                    const auto prev = t.load.latency.load(std::memory_order::relaxed);
+                    t.load.latency.store(prev - prev / 8 + ns / 8, std::memory_order::relaxed);
+                    if (t.commit_group.empty())
+                        sweep(now);
                 }
-                task.second(&f->second);
+                if (!held)
+                    t.load.depth.fetch_sub(1, std::memory_order::relaxed);
+
+                [[ unlikely ]] if (!t.commit_group.empty() &&
+                        std::chrono::steady_clock::now() - t.commit_group_begin >= _shared.cfg->logs.group_commit_latency)
+                    commit(t);
 
                 spin_ctr = 0;
                 yield_ctr = 0;
 
                 continue;
             }
+            // The queue is drained
+            if (!t.commit_group.empty())
+            {
+                commit(t);
+                continue;
+            }
+            // Reads left for stealing, the owner takes its own back before it helps the others
+            if (Task read; t.reads.try_steal(read))
+            {
+                run(t, schema_of(read.schema), read);
+                continue;
+            }
+            if (_shared.cfg->mnt.steal_depth)
+            {
+                Task read;
+                std::size_t victim = 0;
+                while (victim < _threads.size() &&
+                       (victim == core || _threads[victim].stop || !_threads[victim].reads.try_steal(read)))
+                    victim++;
+                if (victim < _threads.size())
+                {
+                    _run_stolen(_threads[victim], read);
+                    spin_ctr = 0;
+                    yield_ctr = 0;
+                    continue;
+                }
+            }
+            // The timed dequeue already waited for the held writes
+            if (!deferred.empty() &&
+                _shared.cfg->mnt.cpu_profile != Config::Mount::CPUProfile::OptimizeSpeed)
+                continue;
+            sweep(std::chrono::steady_clock::now());
 
             if (++spin_ctr < spin_iters)
                 util::spinlock_yield();
@@ -161,7 +443,7 @@ namespace rdb
             for (decltype(auto) it : _threads)
             {
                 it.stop = true;
-                it.launch(0, nullptr);
+                it.launch(Task{ .op = Task::Op::Stop });
                 if (it.thread.joinable())
                     it.thread.join();
                 events()->trigger<Event::CoreStop>(i++);
@@ -286,16 +568,299 @@ namespace rdb
             _shard_id = shards.back();
     }
 
+    LogTail Mount::tail(schema_type schema, LogTail::Cursor cursor) const noexcept
+    {
+        return LogTail(
+            _shared.cfg->root/
+            std::format("C{}", cursor.core)/
+            std::format("[{}]", uuid::encode(schema, uuid::table_alnum)),
+            schema, cursor, _shared.tails
+        );
+    }
+    std::size_t Mount::_idlest_core(std::size_t core) const noexcept
+    {
+        auto load_of = [&](std::size_t i)
+        {
+            const auto& load = _threads[i].load;
+            return std::pair<std::size_t, std::size_t>{
+                load.depth.load(std::memory_order::relaxed),
+                std::size_t(load.latency.load(std::memory_order::relaxed))
+            };
+        };
+        std::size_t result = core;
+        auto best = load_of(core);
+        for (std::size_t i = 0; i < _threads.size(); i++)
+        {
+            // Stopping cores won't run anything queued after their stop task
+            if (_threads[i].stop)
+                continue;
+            if (const auto cur = load_of(i); cur < best)
+            {
+                best = cur;
+                result = i;
+            }
+        }
+        return result;
+    }
     std::size_t Mount::_vcpu(key_type key) const noexcept
     {
         return key % _shared.cfg->mnt.cores;
     }
+    void Mount::_acknowledge_write(Thread& core, ParserState& state) noexcept
+    {
+        // Runs on the core thread, the group is released by the core loop after the logs are synced
+        if (_shared.cfg->logs.group_commit)
+        {
+            if (core.commit_group.empty())
+                core.commit_group_begin = std::chrono::steady_clock::now();
+            core.commit_group.push_back(&state);
+        }
+        else
+            state.release();
+    }
 
-    bool Mount::query_sync(std::span<const unsigned char> packet, QueryEngine::ReadChainStore::ptr store) noexcept
+    void Mount::_read_fields(const Task& task, MemoryCache::field_bitmap& fields, field_operator_map& map) noexcept
+    {
+        // Read operator | field
+        const auto ops = task.data();
+        for (std::size_t i = 0; i + 1 < ops.size(); i += 2)
+        {
+            fields.set(ops[i + 1]);
+            map[ops[i + 1]] = task.operator_idx + i / 2;
+        }
+    }
+    bool Mount::_dispatch_shared(Thread& core, const Task& task, bool stolen) noexcept
+    {
+        if (!_shared.cfg->cache.concurrent_reads)
+            return false;
+
+        std::shared_lock lock(core.caches.lock);
+        const auto f = core.caches.map.find(task.schema);
+        if (f == core.caches.map.end())
+            return false;
+        auto* cache = f->second;
+        auto* state = task.state;
+
+        if (task.op == Task::Op::Read)
+        {
+            MemoryCache::field_bitmap fields{};
+            field_operator_map map{};
+            _read_fields(task, fields, map);
+            // A removed row is a definite miss, nothing is pushed like a miss on the owner core
+            const auto push = [&](std::size_t field, View data)
+            {
+                state->push(View::copy(data), ParserInfo
+                {
+                    .operand_idx = task.operand_idx,
+                    .operator_idx = map[field]
+                });
+            };
+            return (stolen ?
+                cache->read_stolen(task.key, task.sort(), fields, push) :
+                cache->read_shared(task.key, task.sort(), fields, push)).has_value();
+        }
+        else if (task.op == Task::Op::Exists)
+        {
+            // Only resolved here if it doesn't have to wait for earlier filters
+            auto& cfi = task.get<ControlFlowInfo>();
+            if (!cfi.ready(task.size))
+                return false;
+            const auto result = stolen ?
+                cache->exists_stolen(task.key, task.sort()) :
+                cache->exists_shared(task.key, task.sort());
+            if (!result.has_value())
+                return false;
+            auto v = View::copy(1);
+            v.mutate()[0] = cfi.set(result.value(), task.size);
+            state->push(std::move(v), ParserInfo
+            {
+                .operand_idx = task.operand_idx,
+                .operator_idx = task.operator_idx
+            });
+            return true;
+        }
+        return false;
+    }
+    void Mount::_launch_read(Thread& core, const Task& task) noexcept
+    {
+        // Existence checks waiting for earlier filters stay with the owner, like reads of a core that keeps up
+        const auto depth = _shared.cfg->mnt.steal_depth;
+        if (depth && _shared.cfg->cache.concurrent_reads &&
+            core.load.depth.load(std::memory_order::relaxed) >= depth &&
+            (task.op != Task::Op::Exists || task.get<ControlFlowInfo>().ready(task.size)))
+        {
+            const std::size_t victim = &core - _threads.data();
+            const auto target = _idlest_core(victim);
+            if (target != victim &&
+                _threads[target].load.depth.load(std::memory_order::relaxed) < depth &&
+                core.reads.try_enqueue(task))
+            {
+                // Whoever gets to the read first runs it, the wake up then finds nothing
+                _threads[target].launch(Task{
+                    .op = Task::Op::Steal,
+                    .size = std::uint32_t(victim)
+                });
+                return;
+            }
+        }
+        core.launch(task);
+    }
+    void Mount::_run_stolen(Thread& core, const Task& task) noexcept
+    {
+        if (_dispatch_shared(core, task, true))
+            task.state->release();
+        else
+            core.launch(task);
+    }
+    void Mount::_dispatch(Thread& core, MemoryCache* cache, const Task& task) noexcept
+    {
+        auto* state = task.state;
+        switch (task.op)
+        {
+        case Task::Op::Call:
+        {
+            auto* func = &task.get<std::function<void(MemoryCache*)>>();
+            (*func)(cache);
+            delete func;
+            break;
+        }
+        case Task::Op::Create:
+            cache->write(
+                WriteType::Table,
+                task.key, task.partition(), nullptr,
+                task.data(), task.origin
+            );
+            _acknowledge_write(core, *state);
+            break;
+        case Task::Op::Remove:
+            cache->remove(task.key, task.partition(), task.sort(), task.origin);
+            _acknowledge_write(core, *state);
+            break;
+        case Task::Op::Reset:
+            cache->reset(task.key, task.partition(), task.sort(), task.origin);
+            _acknowledge_write(core, *state);
+            break;
+        case Task::Op::Write:
+        case Task::Op::WProc:
+            cache->write(
+                task.op == Task::Op::Write ? WriteType::Field : WriteType::WProc,
+                task.key, task.partition(), task.sort(),
+                task.data(), task.origin
+            );
+            _acknowledge_write(core, *state);
+            break;
+        case Task::Op::Read:
+        {
+            MemoryCache::field_bitmap fields{};
+            field_operator_map map{};
+            _read_fields(task, fields, map);
+            cache->read(task.key, task.sort(), fields, [&](std::size_t field, View data)
+            {
+                state->push(View::copy(data), ParserInfo
+                {
+                    .operand_idx = task.operand_idx,
+                    .operator_idx = map[field]
+                });
+            });
+            state->release();
+            break;
+        }
+        case Task::Op::Page:
+            state->push(cache->page(task.key, task.size), ParserInfo
+            {
+                .operand_idx = task.operand_idx,
+                .operator_idx = 0
+            });
+            state->release();
+            break;
+        case Task::Op::PageFrom:
+            state->push(cache->page_from(task.key, task.sort(), task.size), ParserInfo
+            {
+                .operand_idx = task.operand_idx,
+                .operator_idx = 0
+            });
+            state->release();
+            break;
+        case Task::Op::Lock:
+        {
+            auto lock = cache->lock(task.key, task.sort(), task.origin);
+            auto v = View::copy(1);
+            v.mutate()[0] = task.get<ControlFlowInfo>().set(!lock.is_ready(), task.size);
+            state->push(std::move(v), ParserInfo
+            {
+                .operand_idx = task.operand_idx,
+                .operator_idx = task.operator_idx
+            });
+            break;
+        }
+        case Task::Op::Unlock:
+            cache->unlock(task.key, task.sort(), task.origin);
+            state->release();
+            break;
+        case Task::Op::Exists:
+        {
+            const auto result = cache->exists(task.key, task.sort());
+            auto v = View::copy(1);
+            v.mutate()[0] = task.get<ControlFlowInfo>().set(result, task.size);
+            state->push(std::move(v), ParserInfo
+            {
+                .operand_idx = task.operand_idx,
+                .operator_idx = task.operator_idx
+            });
+            state->release();
+            break;
+        }
+        case Task::Op::MultiFetch:
+        {
+            // Owned by the parser state
+            const auto* batch = &task.get<Batch>();
+            // Key index | field | value, for every key of this core
+            thread_local std::vector<unsigned char> buffer{};
+            buffer.clear();
+            for (decltype(auto) it : batch->keys)
+            {
+                cache->read(it.key, View::view(it.sort), batch->fields, [&](std::size_t field, View data)
+                {
+                    const auto off = buffer.size();
+                    buffer.resize(off + sizeof(std::uint32_t) + sizeof(std::uint8_t) + data.size());
+                    byte::swrite<std::uint32_t>(buffer, off, it.index);
+                    buffer[off + sizeof(std::uint32_t)] = static_cast<std::uint8_t>(field);
+                    if (!data.empty())
+                        std::memcpy(buffer.data() + off + sizeof(std::uint32_t) + sizeof(std::uint8_t), data.data().data(), data.size());
+                });
+            }
+            if (!buffer.empty())
+            {
+                state->push(View::copy(std::span<const unsigned char>(buffer)), ParserInfo
+                {
+                    .operand_idx = task.operand_idx,
+                    .operator_idx = 0
+                });
+            }
+            state->release();
+            break;
+        }
+        case Task::Op::MultiWrite:
+        {
+            const auto* batch = &task.get<Batch>();
+            for (decltype(auto) it : batch->keys)
+            {
+                cache->write(
+                    WriteType::Field,
+                    it.key, View::view(it.partition), View::view(it.sort),
+                    it.data, task.origin
+                );
+            }
+            _acknowledge_write(core, *state);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    void Mount::_query_parse(std::span<const unsigned char> packet, ParserState& state) noexcept
     {
-        thread_local std::aligned_storage_t<32, alignof(ParserState::fragment)> pool;
-        std::pmr::monotonic_buffer_resource resource(&pool, sizeof(pool));
-        ParserState state(&resource, std::move(store));
         ParserInfo inf{};
 
         RDB_TRACE(mnt, "Received query ", packet.size(), "b")
@@ -312,18 +877,116 @@ namespace rdb
                 inf
             );
         }
+    }
+
+    bool Mount::query_sync(std::span<const unsigned char> packet, QueryEngine::ReadChainStore::ptr store) noexcept
+    {
+        thread_local std::aligned_storage_t<32, alignof(ParserState::fragment)> pool;
+        thread_local std::vector<std::unique_ptr<Batch>> batches{};
+        std::pmr::monotonic_buffer_resource resource(&pool, sizeof(pool));
+        ParserState state(&resource, std::move(store));
+        // Batches are reused by the queries of the thread
+        state.batches.swap(batches);
+
+        _query_parse(packet, state);
         state.wait();
-        for (decltype(auto) it : state.response)
+        state.dispatch();
+        state.reset_batches();
+        state.batches.swap(batches);
+
+        return true;
+    }
+    Mount::AsyncParserState* Mount::_query_async_prepare(std::span<const unsigned char> packet,
+            QueryEngine::ReadChainStore::ptr store) noexcept
+    {
+        std::unique_ptr<AsyncParserState> state{ nullptr };
         {
-            if (!it.second.empty())
+            std::lock_guard lock(_async_mtx);
+            if (!_async_pool.empty())
             {
-                state.store->handlers[
-                    it.first.operand_idx - 1
-                ](it.first.operator_idx, it.second);
+                state = std::move(_async_pool.back());
+                _async_pool.pop_back();
             }
         }
+        if (state == nullptr)
+        {
+            state = std::make_unique<AsyncParserState>(this);
+            state->complete = [](ParserState* ptr)
+            {
+                auto* state = static_cast<AsyncParserState*>(ptr);
+                state->mount->_query_async_complete(state, true);
+            };
+        }
+        state->packet.assign(packet.begin(), packet.end());
+        state->store = std::move(store);
+        return state.release();
+    }
+    void Mount::_query_async_launch(AsyncParserState* state, std::function<void(bool)> callback) noexcept
+    {
+        state->callback = std::move(callback);
 
-        return true;
+        // The parser holds a reference so the query can't complete before it is fully launched
+        state->held = 1;
+        state->acquire();
+        _query_parse(state->packet, *state);
+        state->release();
+    }
+    void Mount::_query_async_complete(AsyncParserState* state, bool offload) noexcept
+    {
+        // Completions run user code (read handlers and callbacks), a busy core hands them over
+        if (offload && _core_mount == this && _shared.cfg->mnt.offload_depth)
+        {
+            if (_threads[_core_id].load.depth.load(std::memory_order::relaxed) >= _shared.cfg->mnt.offload_depth)
+            {
+                if (const auto target = _idlest_core(_core_id); target != _core_id)
+                {
+                    _threads[target].launch(Task{
+                        .op = Task::Op::Complete,
+                        .state = state
+                    });
+                    return;
+                }
+            }
+        }
+
+        auto callback = std::move(state->callback);
+        state->dispatch();
+        _query_async_recycle(state);
+        if (callback != nullptr)
+            callback(true);
+    }
+    void Mount::_query_async_recycle(AsyncParserState* state) noexcept
+    {
+        std::unique_ptr<AsyncParserState> ptr(state);
+        ptr->response.clear();
+        ptr->store = nullptr;
+        ptr->operand = 0;
+        ptr->held = 0;
+        ptr->wrote = false;
+        ptr->callback = nullptr;
+        ptr->reset_batches();
+
+        std::lock_guard lock(_async_mtx);
+        if (_async_pool.size() < _shared.cfg->mnt.async_pool)
+            _async_pool.push_back(std::move(ptr));
+    }
+    void Mount::query_async(std::span<const unsigned char> packet, QueryEngine::ReadChainStore::ptr store,
+                            std::function<void(bool)> callback) noexcept
+    {
+        _query_async_launch(
+            _query_async_prepare(packet, std::move(store)),
+            std::move(callback)
+        );
+    }
+    std::future<bool> Mount::query_async(std::span<const unsigned char> packet, QueryEngine::ReadChainStore::ptr store) noexcept
+    {
+        auto promise = std::make_shared<std::promise<bool>>();
+        auto future = promise->get_future();
+        query_async(packet, std::move(store), [promise = std::move(promise)](bool result)
+        {
+            promise->set_value(result);
+        });
+        return future;
     }
 
     std::tuple<std::size_t, schema_type, const RuntimeSchemaReflection::RTSI*> Mount::_query_parse_op_rtsi(
@@ -421,15 +1084,18 @@ namespace rdb
         );
         off += data.size();
 
+        state.wrote = true;
         state.acquire();
-        core.launch(schema, [=, ctx = MemoryCache::origin(), &state, this](MemoryCache* cache)
-        {
-            cache->write(
-                WriteType::Table,
-                key, pkey, nullptr,
-                data, ctx
-            );
-            state.release();
+        core.launch(Task{
+            .schema = schema,
+            .op = Task::Op::Create,
+            .size = std::uint32_t(data.size()),
+            .key = key,
+            .state = &state,
+            .origin = MemoryCache::origin(),
+            .keys = pkey.data().data(),
+            .partition_size = std::uint32_t(pkey.size()),
+            .payload = data.data().data()
         });
 
         return off;
@@ -446,11 +1112,17 @@ namespace rdb
 
         auto& core = _threads[_vcpu(key)];
 
+        state.wrote = true;
         state.acquire();
-        core.launch(schema, [=, ctx = MemoryCache::origin(), &state, this](MemoryCache* cache)
-        {
-            cache->remove(key, sort, ctx);
-            state.release();
+        core.launch(Task{
+            .schema = schema,
+            .op = Task::Op::Remove,
+            .key = key,
+            .state = &state,
+            .origin = MemoryCache::origin(),
+            .keys = pkey.data().data(),
+            .partition_size = std::uint32_t(pkey.size()),
+            .sort_size = std::uint32_t(sort.size())
         });
 
         return off;
@@ -468,14 +1140,13 @@ namespace rdb
         auto& core = _threads[_vcpu(key)];
         const auto count = byte::sread<std::uint32_t>(packet, off);
         state.acquire();
-        core.launch(schema, [=, &state, this](MemoryCache* cache)
-        {
-            state.push(cache->page(key, count), ParserInfo
-            {
-                .operand_idx = info.operand_idx,
-                .operator_idx = 0
-            });
-            state.release();
+        core.launch(Task{
+            .schema = schema,
+            .op = Task::Op::Page,
+            .operand_idx = info.operand_idx,
+            .size = count,
+            .key = key,
+            .state = &state
         });
 
         return off;
@@ -493,14 +1164,16 @@ namespace rdb
         auto& core = _threads[_vcpu(key)];
         const auto count = byte::sread<std::uint32_t>(packet, off);
         state.acquire();
-        core.launch(schema, [=, &state, this](MemoryCache* cache)
-        {
-            state.push(cache->page_from(key, sort, count), ParserInfo
-            {
-                .operand_idx = info.operand_idx,
-                .operator_idx = 0
-            });
-            state.release();
+        core.launch(Task{
+            .schema = schema,
+            .op = Task::Op::PageFrom,
+            .operand_idx = info.operand_idx,
+            .size = count,
+            .key = key,
+            .state = &state,
+            .keys = pkey.data().data(),
+            .partition_size = std::uint32_t(pkey.size()),
+            .sort_size = std::uint32_t(sort.size())
         });
 
         return off;
@@ -541,19 +1214,17 @@ namespace rdb
         cfi.set_chain(byte::sread<std::uint32_t>(packet, off));
 
         const auto total = cfi.get_chain() + sizeof(std::uint32_t);
-        [[ likely ]] if (const auto op = packet[off++]; op < _op_parse_table.size())
+        [[ likely ]] if (const auto func = _op_parse(packet[off++]); func != nullptr)
         {
-            const auto func = _op_parse_table[op];
             off += (this->*func)(packet.subspan(off), state, cfi, info);
         }
         if (cfi.get())
         {
             while (off != total)
             {
-                const auto op = packet[off++];
-                if (op < _op_parse_table.size())
+                const auto func = _op_parse(packet[off++]);
+                if (func != nullptr)
                 {
-                    const auto func = _op_parse_table[op];
                     off += (this->*func)(packet.subspan(off), state, cfi, info);
                 }
                 else
@@ -576,10 +1247,9 @@ namespace rdb
         const auto qid = _log_query(packet.subspan(off, cfi.get_chain()));
         while (off != total)
         {
-            const auto op = packet[off++];
-            if (op < _op_parse_table.size())
+            const auto func = _op_parse(packet[off++]);
+            if (func != nullptr)
             {
-                const auto func = _op_parse_table[op];
                 off += (this->*func)(packet.subspan(off), state, cfi, info);
             }
             else
@@ -606,16 +1276,19 @@ namespace rdb
         auto& core = _threads[_vcpu(key)];
         const auto op_idx = info.operator_idx++;
 
-        core.launch(schema, [&, ctx = MemoryCache::origin(), order = cfi.order(), this](MemoryCache* cache)
-        {
-            auto lock = cache->lock(key, sort, ctx);
-            auto v = View::copy(1);
-            v.mutate()[0] = cfi.set(!lock.is_ready(), order);
-            state.push(std::move(v), ParserInfo
-            {
-                .operand_idx = info.operand_idx,
-                .operator_idx = op_idx
-            });
+        core.launch(Task{
+            .schema = schema,
+            .op = Task::Op::Lock,
+            .operand_idx = info.operand_idx,
+            .operator_idx = op_idx,
+            .size = std::uint32_t(cfi.order()),
+            .key = key,
+            .state = &state,
+            .origin = MemoryCache::origin(),
+            .keys = pkey.data().data(),
+            .partition_size = std::uint32_t(pkey.size()),
+            .sort_size = std::uint32_t(sort.size()),
+            .payload = &cfi
         });
 
         const auto total = cfi.get_chain() + sizeof(std::uint32_t);
@@ -623,10 +1296,9 @@ namespace rdb
         {
             while (off != total)
             {
-                const auto op = packet[off++];
-                if (op < _op_parse_table.size())
+                const auto func = _op_parse(packet[off++]);
+                if (func != nullptr)
                 {
-                    const auto func = _op_parse_table[op];
                     off += (this->*func)(packet.subspan(off), state, cfi, info);
                 }
                 else
@@ -634,10 +1306,15 @@ namespace rdb
             }
         }
         state.acquire();
-        core.launch(schema, [=, ctx = MemoryCache::origin(), &state, this](MemoryCache* cache)
-        {
-            cache->unlock(key, sort, ctx);
-            state.release();
+        core.launch(Task{
+            .schema = schema,
+            .op = Task::Op::Unlock,
+            .key = key,
+            .state = &state,
+            .origin = MemoryCache::origin(),
+            .keys = pkey.data().data(),
+            .partition_size = std::uint32_t(pkey.size()),
+            .sort_size = std::uint32_t(sort.size())
         });
 
         return total;
@@ -649,14 +1326,120 @@ namespace rdb
         return 0;
     }
 
+    std::size_t Mount::_query_parse_op_multi_fetch(std::span<const unsigned char> packet, ParserState& state,
+            ControlFlowInfo& cfi, ParserInfo info) noexcept
+    {
+        std::size_t off = 0;
+
+        const auto [ off1, schema, inf ] = _query_parse_op_rtsi(packet, state, info); off += off1;
+        if (inf == nullptr) return off1;
+
+        MemoryCache::field_bitmap fields{};
+        const auto field_count = packet[off++];
+        for (std::size_t i = 0; i < field_count; i++)
+            fields.set(packet[off++]);
+
+        // Batches are taken from the state (recycled along with asynchronous states)
+        thread_local batch_groups groups{};
+        groups.assign(_threads.size(), nullptr);
+        off += _query_parse_batch(packet.subspan(off), *inf, false, groups, state, info);
+
+        for (std::size_t i = 0; i < groups.size(); i++)
+        {
+            if (groups[i] == nullptr)
+                continue;
+            groups[i]->fields = fields;
+            state.acquire();
+            _threads[i].launch(Task{
+                .schema = schema,
+                .op = Task::Op::MultiFetch,
+                .operand_idx = info.operand_idx,
+                .state = &state,
+                .payload = groups[i]
+            });
+        }
+
+        return off;
+    }
+    std::size_t Mount::_query_parse_op_multi_write(std::span<const unsigned char> packet, ParserState& state,
+            ControlFlowInfo& cfi, ParserInfo info) noexcept
+    {
+        std::size_t off = 0;
+
+        const auto [ off1, schema, inf ] = _query_parse_op_rtsi(packet, state, info); off += off1;
+        if (inf == nullptr) return off1;
+
+        thread_local batch_groups groups{};
+        groups.assign(_threads.size(), nullptr);
+        off += _query_parse_batch(packet.subspan(off), *inf, true, groups, state, info);
+
+        for (std::size_t i = 0; i < groups.size(); i++)
+        {
+            if (groups[i] == nullptr)
+                continue;
+            state.wrote = true;
+            state.acquire();
+            _threads[i].launch(Task{
+                .schema = schema,
+                .op = Task::Op::MultiWrite,
+                .state = &state,
+                .origin = MemoryCache::origin(),
+                .payload = groups[i]
+            });
+        }
+
+        return off;
+    }
+    std::size_t Mount::_query_parse_batch(std::span<const unsigned char> packet, const RuntimeSchemaReflection::RTSI& inf,
+            bool writes, batch_groups& groups, ParserState& state, ParserInfo info) noexcept
+    {
+        std::size_t off = 0;
+
+        const auto count = byte::sread<std::uint32_t>(packet, off);
+        for (std::uint32_t i = 0; i < count; i++)
+        {
+            const auto [ off1, pkey, key ] = _query_parse_op_pkey(packet.subspan(off), inf, state, info); off += off1;
+            const auto [ off2, sort ] = _query_parse_op_skey(packet.subspan(off), inf, state, info); off += off2;
+
+            BatchKey entry{
+                .index = i,
+                .key = key,
+                .partition = pkey.data(),
+                .sort = sort.data()
+            };
+            if (writes)
+            {
+                const auto len = byte::sread<std::uint32_t>(packet, off);
+                entry.data = packet.subspan(off, len + sizeof(std::uint8_t));
+                off += len + sizeof(std::uint8_t);
+            }
+            auto& group = groups[_vcpu(key)];
+            if (group == nullptr)
+                group = &state.batch();
+            group->keys.push_back(entry);
+        }
+
+        return off;
+    }
+
+    Mount::op_parse_func Mount::_op_parse(unsigned char op) noexcept
+    {
+        if (op < _op_parse_table.size())
+            return _op_parse_table[op];
+        switch (cmd::qOp(op))
+        {
+        case cmd::qOp::MultiFetch: return &Mount::_query_parse_op_multi_fetch;
+        case cmd::qOp::MultiWrite: return &Mount::_query_parse_op_multi_write;
+        default: return nullptr;
+        }
+    }
     std::size_t Mount::_query_parse_operand(std::span<const unsigned char> packet, ParserState& state,
                                             ParserInfo info) noexcept
     {
         std::size_t off = 0;
-        [[ likely ]] if (const auto op = packet[off++]; op < _op_parse_table.size())
+        [[ likely ]] if (const auto func = _op_parse(packet[off++]); func != nullptr)
         {
             ControlFlowInfo cfi;
-            const auto func = _op_parse_table[op];
             return off + (this->*func)(packet.subspan(off), state, cfi, info);
         }
         return ~0ull;
@@ -667,85 +1450,73 @@ namespace rdb
         auto& core = _threads[_vcpu(key)];
         std::size_t off = 0;
         const auto op = cmd::qOp(packet[off++]);
+        // The sort key immediately follows the partition key in the packet
+        const auto task = [&](Task::Op op)
+        {
+            return Task{
+                .schema = schema,
+                .op = op,
+                .operand_idx = info.operand_idx,
+                .key = key,
+                .state = &state,
+                .origin = MemoryCache::origin(),
+                .keys = partition.data().data(),
+                .partition_size = std::uint32_t(partition.size()),
+                .sort_size = std::uint32_t(sort.size())
+            };
+        };
         if (op == cmd::qOp::Reset)
         {
+            state.wrote = true;
             state.acquire();
-            core.launch(schema, [=, ctx = MemoryCache::origin(), &state, this](MemoryCache* cache)
-            {
-                cache->reset(key, partition, sort, ctx);
-                state.release();
-            });
+            core.launch(task(Task::Op::Reset));
         }
         else if (op == cmd::qOp::Write)
         {
             const auto len = byte::sread<std::uint32_t>(packet.data(), off);
+            auto t = task(Task::Op::Write);
+            t.size = len + sizeof(std::uint8_t);
+            t.payload = packet.data() + off;
+            state.wrote = true;
             state.acquire();
-            core.launch(schema, [=, ctx = MemoryCache::origin(), &state, this](MemoryCache* cache)
-            {
-                cache->write(
-                    WriteType::Field,
-                    key, partition, sort,
-                    packet.subspan(
-                        off,
-                        len + sizeof(std::uint8_t)
-                    ),
-                    ctx
-                );
-                state.release();
-            });
+            core.launch(t);
             off += len + sizeof(std::uint8_t);
         }
         else if (op == cmd::qOp::Read)
         {
-            MemoryCache::field_bitmap fields{};
-            std::array<unsigned short, std::numeric_limits<unsigned char>::max()> field_operator_map{};
-            off--;
+            // The core rebuilds the field map from the read operators
+            auto t = task(Task::Op::Read);
+            t.operator_idx = info.operator_idx;
+            t.payload = packet.data() + --off;
             do
             {
-                off++;
-                const auto field = packet[off++];
-                fields.set(field);
-                field_operator_map[field] = info.operator_idx++;
+                off += 2;
+                info.operator_idx++;
             }
             while (
                 off < packet.size() &&
                 packet[off] == char(cmd::qOp::Read)
             );
+            t.size = off - (static_cast<const unsigned char*>(t.payload) - packet.data());
 
-            state.acquire();
-            core.launch(schema, [=, &state, this](MemoryCache* cache)
+            if (state.wrote || !_dispatch_shared(core, t, false))
             {
-                std::size_t idx = 0;
-                cache->read(key, sort, fields, [&](std::size_t field, View data)
-                {
-                    state.push(View::copy(data), ParserInfo
-                    {
-                        .operand_idx = info.operand_idx,
-                        .operator_idx = field_operator_map[field]
-                    });
-                });
-                state.release();
-            });
+                state.acquire();
+                if (state.wrote)
+                    core.launch(t);
+                else
+                    _launch_read(core, t);
+            }
         }
         else if (op == cmd::qOp::WProc)
         {
             const auto len = byte::sread<std::uint32_t>(packet.data(), off);
+            auto t = task(Task::Op::WProc);
+            t.size = len + sizeof(proc_opcode) + sizeof(std::uint8_t);
+            t.payload = packet.data() + off;
+            state.wrote = true;
             state.acquire();
-            core.launch(schema, [=, ctx = MemoryCache::origin(), &state, this](MemoryCache* cache)
-            {
-                cache->write(
-                    WriteType::WProc,
-                    key, partition, sort,
-                    packet.subspan(
-                        off,
-                        len +
-                        sizeof(proc_opcode) +
-                        sizeof(std::uint8_t)
-                    ),
-                    ctx
-                );
-                state.release();
-            });
+            core.launch(t);
             off += len + sizeof(proc_opcode) + sizeof(std::uint8_t);
         }
         else if (op == cmd::qOp::RProc)
@@ -767,19 +1538,27 @@ namespace rdb
         if (op == cmd::qOp::FilterExists)
         {
             const auto op_idx = info.operator_idx++;
-            state.acquire();
-            core.launch(schema, [=, order = cfi.order(), &cfi, &state, this](MemoryCache* cache)
+            const auto t = Task{
+                .schema = schema,
+                .op = Task::Op::Exists,
+                .operand_idx = info.operand_idx,
+                .operator_idx = op_idx,
+                .size = std::uint32_t(cfi.order()),
+                .key = key,
+                .state = &state,
+                .keys = partition.data().data(),
+                .partition_size = std::uint32_t(partition.size()),
+                .sort_size = std::uint32_t(sort.size()),
+                .payload = &cfi
+            };
+            if (state.wrote || !_dispatch_shared(core, t, false))
             {
-                const auto result = cache->exists(key, sort);
-                auto v = View::copy(1);
-                v.mutate()[0] = cfi.set(result, order);
-                state.push(std::move(v), ParserInfo
-                {
-                    .operand_idx = info.operand_idx,
-                    .operator_idx = op_idx
-                });
-                state.release();
-            });
+                state.acquire();
+                if (state.wrote)
+                    core.launch(t);
+                else
+                    _launch_read(core, t);
+            }
         }
         else if (op == cmd::qOp::Invert)
         {
@@ -4,11 +4,14 @@
 #include <condition_variable>
 #include <memory_resource>
 #include <functional>
+#include <limits>
+#include <array>
 #include <memory>
 #include <vector>
 #include <rdb_root_config.hpp>
 #include <rdb_task_ring.hpp>
 #include <rdb_memory.hpp>
+#include <rdb_log_tail.hpp>
 #include <rdb_dsl.hpp>
 
 namespace rdb
@@ -19,6 +22,13 @@ namespace rdb
     {
     public:
         using ptr = std::shared_ptr<Mount>;
+        struct CoreLoad
+        {
+            // Tasks queued or running
+            std::size_t depth{ 0 };
+            std::size_t executed{ 0 };
+            std::chrono::nanoseconds latency{ 0 };
+        };
         enum class Status
         {
             Warning,
@@ -27,13 +37,99 @@ namespace rdb
             Stopped
         };
     private:
-        struct Thread
+        struct ParserState;
+        // Fixed size core task dispatched by its op, the arguments point into the packet (which outlives the query)
+        struct alignas(64) Task
+        {
+            enum class Op : unsigned char
+            {
+                Stop,
+                Call,
+                Create,
+                Remove,
+                Reset,
+                Write,
+                WProc,
+                Read,
+                Page,
+                PageFrom,
+                Lock,
+                Unlock,
+                Exists,
+                MultiFetch,
+                MultiWrite,
+                // Completion of an asynchronous query handed over by a busy core
+                Complete,
+                // Wakes a less loaded core up to steal a read of the core given as the size
+                Steal
+            };
+
+            schema_type schema{ 0 };
+            Op op{ Op::Stop };
+            unsigned short operand_idx{ 0 };
+            unsigned short operator_idx{ 0 };
+            // Payload size, page count or control flow order
+            std::uint32_t size{ 0 };
+            key_type key{ 0 };
+            ParserState* state{ nullptr };
+            MemoryCache::Origin origin{};
+            // Partition key immediately followed by the sort key
+            const unsigned char* keys{ nullptr };
+            std::uint32_t partition_size{ 0 };
+            std::uint32_t sort_size{ 0 };
+            // Data, read operators, control flow info, batch or closure (depending on the op)
+            const void* payload{ nullptr };
+
+            View partition() const noexcept
+            {
+                return View::view(std::span(keys, partition_size));
+            }
+            View sort() const noexcept
+            {
+                return View::view(std::span(keys + partition_size, sort_size));
+            }
+            std::span<const unsigned char> data() const noexcept
+            {
+                return std::span(static_cast<const unsigned char*>(payload), size);
+            }
+            template<typename Type>
+            Type& get() const noexcept
+            {
+                return *static_cast<Type*>(const_cast<void*>(payload));
+            }
+        };
+        static_assert(sizeof(Task) == 64, "Core tasks should fit in a cache line");
+
+        // Updated by the owning core, read by anyone picking a core
+        struct Load
+        {
+            std::atomic<std::size_t> depth{ 0 };
+            std::atomic<std::size_t> executed{ 0 };
+            // Moving average of the sampled task latency (ns)
+            std::atomic<std::uint64_t> latency{ 0 };
+
+            Load() = default;
+            Load(Load&&) noexcept {}
+        };
+        // Memory caches of a core published for concurrent reads, updated by the owning core
+        struct Caches
         {
-            using task = std::pair<
-                         schema_type, std::function<void(MemoryCache*)>
-                         >;
+            util::SharedSpinlock lock{};
+            ct::hash_map<schema_type, MemoryCache*> map{};
 
-            ct::TaskRing<task, 128> queue{};
+            Caches() = default;
+            Caches(Caches&&) noexcept {}
+        };
+        struct Thread
+        {
+            ct::TaskRing<Task, 128> queue{};
+            // Reads of queries that wrote nothing, run by the owner or stolen by other cores
+            ct::TaskRing<Task, 128> reads{};
+            Load load{};
+            Caches caches{};
+            // Writes acknowledged once their log records are synced (group commit)
+            std::vector<ParserState*> commit_group{};
+            std::chrono::steady_clock::time_point commit_group_begin{};
 
             bool stop{ false };
             std::thread thread{};
@@ -42,12 +138,20 @@ namespace rdb
             Thread(Thread&&) = default;
             Thread(const Thread&) = delete;
 
+            void launch(const Task& task) noexcept
+            {
+                load.depth.fetch_add(1, std::memory_order::relaxed);
+                queue.enqueue(task);
+            }
+            // Arbitrary closures are boxed, queries never go through here
             void launch(schema_type schema, std::function<void(MemoryCache*)> func) noexcept
             {
-                queue.enqueue(
-                    std::move(schema),
-                    std::move(func)
-                );
+                load.depth.fetch_add(1, std::memory_order::relaxed);
+                queue.enqueue(Task{
+                    .schema = schema,
+                    .op = Task::Op::Call,
+                    .payload = new std::function<void(MemoryCache*)>(std::move(func))
+                });
             }
         };
         struct ControlFlowInfo
@@ -87,6 +191,11 @@ namespace rdb
                 _order_ctr.notify_all();
                 return result;
             }
+            // Whether every earlier order was already set
+            bool ready(std::size_t order) const noexcept
+            {
+                return _order_ctr.load() == order;
+            }
             bool get() const noexcept
             {
                 util::nano_wait_for(_order_ctr, _order_max);
@@ -121,6 +230,22 @@ namespace rdb
             unsigned short operand_idx{ 0 };
             unsigned short operator_idx{ 0 };
         };
+        struct BatchKey
+        {
+            std::uint32_t index{ 0 };
+            key_type key{ 0 };
+            std::span<const unsigned char> partition{};
+            std::span<const unsigned char> sort{};
+            // Field write ([field][data]), empty for reads
+            std::span<const unsigned char> data{};
+        };
+        struct Batch
+        {
+            MemoryCache::field_bitmap fields{};
+            std::vector<BatchKey> keys{};
+        };
+        // Batch of every core (null until a key of the core is found)
+        using batch_groups = std::vector<Batch*>;
         struct ParserState
         {
             using fragment = std::pair<ParserInfo, View>;
@@ -130,6 +255,15 @@ namespace rdb
             std::size_t operand{ 0 };
             std::pmr::vector<fragment> response{};
             QueryEngine::ReadChainStore::ptr store{};
+            // References held by the parser itself, barriers wait for everything else
+            std::size_t held{ 0 };
+            // Writes were queued, later reads of the query have to follow them through the owner core
+            bool wrote{ false };
+            // Set for asynchronous queries, invoked by whoever drops the last reference
+            void(*complete)(ParserState*){ nullptr };
+            // Batches handed to the cores, they keep their buffers while the state is recycled
+            std::vector<std::unique_ptr<Batch>> batches{};
+            std::size_t batch_count{ 0 };
 
             ParserState(
                 std::pmr::memory_resource* res,
@@ -147,7 +281,7 @@ namespace rdb
             }
             void wait() const noexcept
             {
-                util::nano_wait_for(ref, 0ul);
+                util::nano_wait_for(ref, held);
             }
             void acquire() noexcept
             {
@@ -155,9 +289,51 @@ namespace rdb
             }
             void release() noexcept
             {
-                if (--ref == 0) ref.notify_all();
+                const auto r = --ref;
+                if (r == 0 && complete != nullptr)
+                    complete(this);
+                else if (r <= held)
+                    ref.notify_all();
+            }
+            Batch& batch() noexcept
+            {
+                if (batch_count == batches.size())
+                    batches.push_back(std::make_unique<Batch>());
+                return *batches[batch_count++];
+            }
+            void reset_batches() noexcept
+            {
+                for (std::size_t i = 0; i < batch_count; i++)
+                    batches[i]->keys.clear();
+                batch_count = 0;
+            }
+            void dispatch() noexcept
+            {
+                for (decltype(auto) it : response)
+                {
+                    if (!it.second.empty())
+                    {
+                        store->handlers[
+                            it.first.operand_idx - 1
+                        ](it.first.operator_idx, it.second);
+                    }
+                }
             }
         };
+        struct AsyncParserState : ParserState
+        {
+            Mount* mount{ nullptr };
+            // The packet is referenced by the core tasks so it has to outlive the call
+            std::vector<unsigned char> packet{};
+            std::function<void(bool)> callback{};
+
+            explicit AsyncParserState(Mount* ptr)
+                : ParserState(std::pmr::get_default_resource(), nullptr), mount(ptr) {}
+        };
+
+        using field_operator_map = std::array<unsigned short, std::numeric_limits<unsigned char>::max() + 1>;
+
+
         struct QueryLogShard
         {
             std::size_t offset{ 0 };
@@ -183,6 +359,11 @@ namespace rdb
         std::size_t _shard_id{ 0 };
         std::unordered_map<std::size_t, QueryLogShard> _log_shards{};
 
+        // Asynchronous queries (states are recycled along with their buffers)
+
+        std::mutex _async_mtx;
+        std::vector<std::unique_ptr<AsyncParserState>> _async_pool{};
+
         // Other stuff
 
         std::vector<Thread> _threads{};
@@ -195,6 +376,30 @@ namespace rdb
 
         std::size_t _vcpu(key_type key) const noexcept;
 
+        void _acknowledge_write(Thread& core, ParserState& state) noexcept;
+        // Read operators of a read task as a field bitmap and the operator of every field
+        static void _read_fields(const Task& task, MemoryCache::field_bitmap& fields, field_operator_map& map) noexcept;
+        void _dispatch(Thread& core, MemoryCache* cache, const Task& task) noexcept;
+        // Serves a read or an existence check from the query thread (or from a core that stole it), false if the owner core has to
+        bool _dispatch_shared(Thread& core, const Task& task, bool stolen) noexcept;
+        // Launches a read of a query that wrote nothing, left for another core to steal if the owner is busy
+        void _launch_read(Thread& core, const Task& task) noexcept;
+        // Runs a read stolen from the core, handed back if only the owner can run it
+        void _run_stolen(Thread& core, const Task& task) noexcept;
+        void _query_parse(std::span<const unsigned char> packet, ParserState& state) noexcept;
+        // Copies the packet, the query is only parsed and launched once the state is launched
+        AsyncParserState* _query_async_prepare(std::span<const unsigned char> packet, QueryEngine::ReadChainStore::ptr store) noexcept;
+        void _query_async_launch(AsyncParserState* state, std::function<void(bool)> callback) noexcept;
+        void _query_async_recycle(AsyncParserState* state) noexcept;
+        void _query_async_complete(AsyncParserState* state, bool offload) noexcept;
+
+        // The core of the calling thread (if it is one of ours)
+        static inline thread_local const Mount* _core_mount{ nullptr };
+        static inline thread_local std::size_t _core_id{ 0 };
+
+        // The core with the shortest queue (and latency), if it is less loaded than the given one
+        std::size_t _idlest_core(std::size_t core) const noexcept;
+
         std::tuple<std::size_t, schema_type, const RuntimeSchemaReflection::RTSI*> _query_parse_op_rtsi(
             std::span<const unsigned char> packet, ParserState& state, ParserInfo info) noexcept;
         std::tuple<std::size_t, View, key_type> _query_parse_op_pkey(std::span<const unsigned char> packet,
@@ -212,13 +417,23 @@ namespace rdb
         std::size_t _query_parse_op_atomic(std::span<const unsigned char> packet, ParserState& state, ControlFlowInfo& cfi, ParserInfo info) noexcept;
         std::size_t _query_parse_op_lock(std::span<const unsigned char> packet, ParserState& state, ControlFlowInfo& cfi, ParserInfo info) noexcept;
         std::size_t _query_parse_op_barrier(std::span<const unsigned char> packet, ParserState& state, ControlFlowInfo& cfi, ParserInfo info) noexcept;
+        std::size_t _query_parse_op_multi_fetch(std::span<const unsigned char> packet, ParserState& state, ControlFlowInfo& cfi, ParserInfo info) noexcept;
+        std::size_t _query_parse_op_multi_write(std::span<const unsigned char> packet, ParserState& state, ControlFlowInfo& cfi, ParserInfo info) noexcept;
 
+        std::size_t _query_parse_batch(std::span<const unsigned char> packet, const RuntimeSchemaReflection::RTSI& inf,
+                bool writes, batch_groups& groups, ParserState& state, ParserInfo info) noexcept;
         std::size_t _query_parse_operand(std::span<const unsigned char> packet, ParserState& state, ParserInfo info) noexcept;
         std::size_t _query_parse_schema_operator(std::span<const unsigned char> packet, key_type key, View partition, View sort,
                 schema_type schema, ParserState& state, ControlFlowInfo& cfi, ParserInfo& info) noexcept;
         std::size_t _query_parse_predicate_operator(std::span<const unsigned char> packet, key_type key, View partition,
                 View sort, schema_type schema, ParserState& state, ControlFlowInfo& cfi, ParserInfo& info) noexcept;
 
+        using op_parse_func = std::size_t(Mount::*)(std::span<const unsigned char>, ParserState&, ControlFlowInfo&, ParserInfo);
+
+        // Parser of an operand, null for anything else
+        static op_parse_func _op_parse(unsigned char op) noexcept;
+
+        // Sequential operands (the batches are appended after the last operator to keep older packets valid)
         static inline const std::array _op_parse_table
         {
             &Mount::_query_parse_op_fetch,
@@ -258,12 +473,26 @@ namespace rdb
         EventStore::ptr events() const noexcept;
 
         std::size_t cores() const noexcept;
+        CoreLoad load(std::size_t core) const noexcept;
         rs::RuntimeLogs::ptr logs() const noexcept;
 
         void start();
         void stop() noexcept;
         void wait() noexcept;
         bool query_sync(std::span<const unsigned char> packet, QueryEngine::ReadChainStore::ptr store) noexcept;
+        // Returns once the packet is parsed, the callback (and read handlers) run on the core that completes the query
+        // Control flow operators (conditions, locks, barriers) still wait for their dependencies while parsing
+        void query_async(std::span<const unsigned char> packet, QueryEngine::ReadChainStore::ptr store,
+                         std::function<void(bool)> callback) noexcept;
+        std::future<bool> query_async(std::span<const unsigned char> packet, QueryEngine::ReadChainStore::ptr store) noexcept;
+
+        // Reads the writes of a schema on a core as they are logged (from the cursor onwards)
+        LogTail tail(schema_type schema, LogTail::Cursor cursor = {}) const noexcept;
+        template<typename Schema>
+        LogTail tail(LogTail::Cursor cursor = {}) const noexcept
+        {
+            return tail(Schema::ucode, cursor);
+        }
 
         template<typename Func>
         void run(schema_type schema, Func&& task) noexcept
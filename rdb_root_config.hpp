@@ -6,6 +6,7 @@
 #include <rdb_memunits.hpp>
 #include <rdb_writetype.hpp>
 #include <filesystem>
+#include <chrono>
 #include <functional>
 #include <shared_mutex>
 #include <mutex>
@@ -35,7 +36,7 @@ namespace rdb
         // A read failed
         ReadFailure,
 
-        // The memory usage of a memory cache instance changed (estimated)
+        // The write stall state of a memory cache instance changed or a memtable was queued for a flush (with its memory usage)
         MemoryPressure,
         // Pressure in the disk cache changed
         DiskCachePressure,
@@ -45,6 +46,22 @@ namespace rdb
         FlushStart,
         // A flush has ended
         FlushEnd,
+        // A block failed checksum verification
+        ChecksumFailure,
+        // A log shard was replayed by a memory cache
+        ReplayProgress,
+        // The logs of a core were synced for a group of writes, which are acknowledged right after
+        GroupCommit,
+    };
+
+    enum class WriteStall
+    {
+        // Writes are admitted immediately
+        None,
+        // Writes are delayed proportionally to the pressure above the soft threshold
+        Slowdown,
+        // Writes are held by their core until a pending flush is committed
+        Stop,
     };
 
     namespace impl
@@ -61,16 +78,22 @@ namespace rdb
             event_callback<void, ReadType, std::span<const unsigned char>>,
             event_callback<void, WriteType, std::span<const unsigned char>>,
             event_callback<void, ReadType, std::span<const unsigned char>>,
-            // Est. memory usage | field count
-            event_callback<void, std::size_t, std::size_t>,
-            // Est. memory usage
-            event_callback<void, std::size_t>,
+            // Memory usage (including pending flushes) | partition count | write stall state
+            event_callback<void, std::size_t, std::size_t, WriteStall>,
+            // Est. memory usage | hits | misses
+            event_callback<void, std::size_t, std::size_t, std::size_t>,
             // Data handles | indexer handles | bloom handles
             event_callback<void, std::size_t, std::size_t, std::size_t>,
             // Est. memory to be flushed | fields flushed
             event_callback<void, std::size_t, std::size_t>,
             // Data size | indexer size | bloom size | success
-            event_callback<void, std::size_t, std::size_t, std::size_t, bool>
+            event_callback<void, std::size_t, std::size_t, std::size_t, bool>,
+            // Flush | offset of the stored block data
+            event_callback<void, std::size_t, std::size_t>,
+            // Core | replayed bytes | total bytes
+            event_callback<void, std::size_t, std::size_t, std::size_t>,
+            // Core | writes in the group
+            event_callback<void, std::size_t, std::size_t>
             >;
     }
 
@@ -160,6 +183,14 @@ namespace rdb
             bool numa{ true };
             // Optimizes for chosen qualities when it comes to CPU usage
             CPUProfile cpu_profile{ CPUProfile::OptimizeUsage };
+            // Number of asynchronous query states kept for reuse
+            std::size_t async_pool{ 1024 };
+            // Queue depth at which a core hands query completions (read handlers and callbacks) to the least loaded core (zero disables it)
+            // Callbacks then run on arbitrary cores, so this is opt-in
+            std::size_t offload_depth{ 0 };
+            // Queue depth at which a core leaves reads of queries that wrote nothing for less loaded cores to steal
+            // Stolen reads go through the memtables and the flushed segments but not the caches of the owner (requires cache.concurrent_reads, zero disables it)
+            std::size_t steal_depth{ 16 };
             // Runtime logs config
             rs::RuntimeLogs::Config logs{};
         } mnt;
@@ -167,8 +198,21 @@ namespace rdb
         {
             // The size of a single log shard (bytes)
             std::size_t log_shard_size{ 1024 * 1024 * 4 };
+            // Records at least this large are compressed if they reach the compression ratio of the cache (zero disables it)
+            std::size_t compression_threshold{ 1024 };
+            // Number of flushed log shards kept in the archive for log tails (zero removes them once flushed)
+            std::size_t tail_retention{ 0 };
+            // Number of log shards decoded ahead of the replay
+            std::size_t replay_workers{ 4 };
+            // Number of zeroed and allocated log shards kept ready per memory cache (zero disables the pool), zeroed by one worker per mount
+            std::size_t log_pool_size{ 2 };
             // The amount of data required for a flush of the WAL logs
             std::size_t flush_pressure{ 0 };
+            // Whether writes are acknowledged only after their log records are synced
+            // Records appended by all writes drained in one core loop iteration share a single sync (flush_pressure is ignored)
+            bool group_commit{ false };
+            // Maximum time a write waits for its group to be synced
+            std::chrono::microseconds group_commit_latency{ 500 };
             // Whether to log each write
             bool enable{ true };
         } logs;
@@ -180,6 +224,15 @@ namespace rdb
                 LRU,
                 LFU,
             };
+            enum class Verify
+            {
+                // Checksums are only verified by the scrubber
+                Off,
+                // One in verify_sample_ratio disk block reads is verified
+                Sample,
+                // Every disk block read is verified
+                Always,
+            };
 
             // The block size during a flush
             std::size_t block_size{ mem::KiB(64) };
@@ -191,6 +244,24 @@ namespace rdb
             std::size_t sort_sparse_index_ratio{ 16 };
             // Amount of data in the memory cache that triggers a flush (bytes)
             std::size_t flush_pressure{ mem::MiB(256) };
+            // Memory of the memtables of every memory cache of the mount (including pending flushes) at which the largest ones are flushed (bytes) (zero disables it)
+            std::size_t write_buffer{ 0 };
+            // Memory caches without tasks for this long are flushed and unloaded (zero disables it)
+            std::chrono::seconds idle_unload{ 0 };
+            // Extra capacity given to a slot that outgrows its capacity (relative to the new size)
+            float slot_growth{ 0.5f };
+            // Number of threads compressing the blocks of a flush while it is written (zero compresses on the flush thread)
+            std::size_t flush_workers{ 2 };
+            // Number of pending flushes at which writes are slowed down
+            std::size_t stall_soft_flushes{ 3 };
+            // Number of pending flushes at which writes wait for a flush to be committed (zero disables stalls)
+            std::size_t stall_hard_flushes{ 6 };
+            // Memory held by the memory cache and its pending flushes at which writes are slowed down (bytes)
+            std::size_t stall_soft_pressure{ mem::MiB(768) };
+            // Memory held by the memory cache and its pending flushes at which writes wait (bytes) (zero disables it)
+            std::size_t stall_hard_pressure{ mem::GiB(1) };
+            // Delay of a write right below a hard threshold, it grows linearly from the soft threshold (writes held at it are retried as often)
+            std::chrono::microseconds stall_max_delay{ 1000 };
             // Automatic compaction fold ratio determines how many flushes fold into a single flush
             std::size_t compaction_fold_ratio{ 8 };
             // How many flushes are allowed before forced compaction
@@ -209,19 +280,37 @@ namespace rdb
             float intra_partition_bloom_fp_rate{ 0.01f };
             // Query cache type (trigerred when a disk read is performed)
             Type cache_type{ Type::ALC };
-            // Maximum allowed memory usage of the cache (bytes) (only considers data stored, not the total memory used by structures)
+            // Maximum allowed memory usage of the cache of a core, shared by its schemas (bytes) (only considers data stored, not the total memory used by structures)
             std::size_t max_cache_volume{ mem::MiB(512) };
-            // Maximum allowed memory usage for the page cache (bytes)
+            // Maximum allowed memory usage for the page cache of a core, shared by its schemas (bytes)
             std::size_t max_page_cache_volume{ mem::MiB(64) };
+            // Maximum memory of the segment index key fingerprints (bytes), flushes past it are only fenced by their key range
+            std::size_t max_segment_index_volume{ mem::MiB(16) };
             // Whether page requests should be cached
             bool cache_page{ false };
+            // Whether queries read the memory cache from their own thread (misses still go through the owner core)
+            bool concurrent_reads{ false };
+            // Block checksum verification on disk reads (blocks in the disk cache were verified when inserted)
+            Verify verify_checksums{ Verify::Off };
+            // Sampling ratio of checksum verification
+            std::size_t verify_sample_ratio{ 64 };
+            // How often the background scrubber verifies every flush (zero disables it)
+            std::chrono::seconds scrub_interval{ 0 };
         } cache;
     };
+    class WriteBuffer;
+    class LogTailRegistry;
+    class LogShardWorker;
+
     struct Shared
     {
         rs::RuntimeLogs::ptr logs;
         EventStore::ptr events;
         std::shared_ptr<Config> cfg;
+        std::shared_ptr<WriteBuffer> write_buffer;
+        std::shared_ptr<LogTailRegistry> tails;
+        // Zeroes the log shards of every memory cache (each log pool runs its own worker without it)
+        std::shared_ptr<LogShardWorker> shard_worker;
     };
 }
 